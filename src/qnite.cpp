@@ -5,15 +5,18 @@
 #include "qthread.h"
 #include "QMetaMethod"
 
+#include "qnitemultisource.h"
+#include "qniteprojection.h"
 #include "qniteuser.h"
 
-QNiTE::QNiTE(QObject *parent) : QObject(parent)
+QNiTE::QNiTE(QObject *parent) : QObject(parent), m_userPool(this)
 {
     m_initialized = false;
 
-    m_device = 0;
-    m_rgbStream = 0;
-    m_userTracker = 0;
+    m_source = 0;
+
+    m_colorFps = m_depthFps = 0;
+    m_colorPixelFormat = RGB888;
 
     m_userCount = m_skeletonCount = 0;
     m_frameIndex = 0;
@@ -22,7 +25,45 @@ QNiTE::QNiTE(QObject *parent) : QObject(parent)
 
     m_rgbStreamEnabled = true;
 
-    m_shutdown = false;
+    m_latencyStats = new QNiTELatencyStats(this);
+    m_userModel = new QNiTEUserModel(this);
+    m_streamServer = new QNiTESkeletonServer(this);
+
+    m_framePolicy = LatestWins;
+    m_frameQueueSize = 4;
+    configureFrameQueues();
+
+    m_snapshot = QNiTETrackerSnapshotPointer(new QNiTETrackerSnapshot());
+
+    m_predictionTime = 0;
+
+    // moved to its thread by initialize()
+    m_worker = new QNiTETrackerWorker(&m_trackerFrames, &m_snapshots);
+    connect(m_worker, &QNiTETrackerWorker::snapshotReady, this, &QNiTE::processNewFrame, Qt::QueuedConnection);
+
+    // an automatic prediction time follows the measured latency
+    connect(m_latencyStats, &QNiTELatencyStats::updated, this, [this]() {
+        if (m_predictionTime < 0)
+            updateJointFilter();
+    });
+
+    m_batchedNotifications = false;
+    m_applyingFrame = false;
+    m_changes = 0;
+
+    m_shutdown.storeRelease(0);
+}
+
+void QNiTE::setFrameSource(QNiTEFrameSource * source)
+{
+    if(m_initialized)
+    {
+        qDebug("[QNiTE::setFrameSource] Already initialized, ignoring.");
+        return;
+    }
+
+    delete m_source;
+    m_source = source;
 }
 
 void QNiTE::initialize()
@@ -30,46 +71,75 @@ void QNiTE::initialize()
     if(m_initialized) return;
 
     qDebug("[QNiTE] Initializing...");
-    openni::Status rc = openni::OpenNI::initialize();
-    if (rc != openni::STATUS_OK)
-    {
-        printf("Failed to initialize OpenNI\n%s\n", openni::OpenNI::getExtendedError());
-        exit(-1);
-    }
 
-    m_device = new openni::Device();
-    rc = m_device->open(0);
-    if (rc != openni::STATUS_OK)
+    if(!m_source && !m_deviceUris.isEmpty())
     {
-        printf("Failed to open device\n%s\n", openni::OpenNI::getExtendedError());
-        exit(-2);
-    }
-    m_device->setDepthColorSyncEnabled(true);
+        QNiTEMultiSource * source = new QNiTEMultiSource();
 
-    m_rgbStream = new openni::VideoStream();
-    openni::Status rcRGB = m_rgbStream->create(*m_device, openni::SENSOR_COLOR);
-    if (rcRGB != openni::STATUS_OK)
-    {
-        printf("Failed to initialize RGB camera\n%s\n", openni::OpenNI::getExtendedError());
-        exit(-1);
+        for(int i = 0; i < m_deviceUris.size(); ++i)
+            source->addSensor(m_deviceUris[i], i < m_deviceTransforms.size() ? m_deviceTransforms[i].value<QMatrix4x4>() : QMatrix4x4());
+
+        m_source = source;
     }
 
-    m_rgbStream->addNewFrameListener(this);
+    if(!m_source)
+        m_source = QNiTEFrameSource::create(m_sourceUri);
+
+    // a default QSize is -1 x -1
+    QNiTEVideoMode colorMode;
+    colorMode.width = qMax(0, m_colorResolution.width());
+    colorMode.height = qMax(0, m_colorResolution.height());
+    colorMode.fps = m_colorFps;
+    colorMode.pixelFormat = QNiTEColorFrame::PixelFormat(m_colorPixelFormat);
 
-    if(m_rgbStreamEnabled)
-        m_rgbStream->start();
+    QNiTEVideoMode depthMode;
+    depthMode.width = qMax(0, m_depthResolution.width());
+    depthMode.height = qMax(0, m_depthResolution.height());
+    depthMode.fps = m_depthFps;
 
-    nite::NiTE::initialize();
+    m_source->setListener(this);
+    m_source->setColorEnabled(m_rgbStreamEnabled);
+    m_source->setColorVideoMode(colorMode);
+    m_source->setDepthVideoMode(depthMode);
 
-    m_userTracker = new nite::UserTracker();
-    if (m_userTracker->create(m_device) != nite::STATUS_OK)
+    if(!m_source->open())
     {
-        qDebug("Failed to init user tracker");
+        qDebug("[QNiTE] Failed to open frame source: %s", qPrintable(m_source->errorString()));
+        return;
+    }
+
+    m_worker->setIntrinsics(m_source->depthIntrinsics());
+    m_userPool.setMaxSize(m_source->maxUsers());
+
+    // a capture opened before the source existed may be too small for it; nothing is recorded yet
+    if(m_capture.isOpen() && m_capture.maxUsers() < m_source->maxUsers())
+    {
+        m_capture.close();
+        m_capture.setMaxUsers(m_source->maxUsers());
+
+        if(!m_capture.open(m_captureFile))
+        {
+            qDebug("[QNiTE::initialize] Could not reopen %s: %s", qPrintable(m_captureFile), qPrintable(m_capture.errorString()));
+            setCaptureFile(QString());
+        }
     }
 
-    m_userTracker->addNewFrameListener(this);
+    // the same for the shared memory segment; readers see the old one closed and reopen
+    if(m_publisher.isOpen() && m_publisher.maxUsers() < m_source->maxUsers())
+    {
+        m_publisher.close();
+        m_publisher.setMaxUsers(m_source->maxUsers());
 
+        if(!m_publisher.open(m_sharedMemoryName))
+        {
+            qDebug("[QNiTE::initialize] Could not recreate %s: %s", qPrintable(m_sharedMemoryName), qPrintable(m_publisher.errorString()));
+            setSharedMemoryName(QString());
+        }
+    }
 
+    m_workerThread.setObjectName("QNiTE Tracker Worker");
+    m_worker->moveToThread(&m_workerThread);
+    m_workerThread.start();
 
     setInitialized(true);
 
@@ -78,147 +148,429 @@ void QNiTE::initialize()
 
 void QNiTE::processNewFrame()
 {
-    lockFrameRef();
-
-    if(!m_frameRef.isValid())
-    {
-        qDebug("[QNiTE::processNewFrame] Frame is not valid.");
-        unlockFrameRef();
+    if(!m_snapshots.acquire())
         return;
-    }
 
-    setFrameIndex(m_frameRef.getFrameIndex());
+    // the worker did the heavy lifting; what is left is applying the snapshot to the QObjects
+    m_snapshot = m_snapshots.front();
+    m_trackerTiming = m_snapshot->frame.timing;
+    m_trackerTiming.processStart = qniteTimestampNs();
 
-    const nite::Array<nite::UserData>& users = m_frameRef.getUsers();
-    setUserCount(users.getSize());
-    int skeletons = 0;
+    const QNiTETrackerFrame & frame = m_snapshot->frame;
+
+    m_userPool.tick();
+
+    m_applyingFrame = true;
+    m_changes = 0;
+
+    setFrameIndex(frame.frameIndex);
+
+    const QVector<QNiTEUserData> & users = m_snapshot->users;
+    const QVector<int> & userChanges = m_snapshot->userChanges;
+    setUserCount(users.size());
 
     for (int i = 0; i < m_userCount; ++i)
     {
-        const nite::UserData& user = users[i];
+        const QNiTEUserData & user = users[i];
         QNiTEUser * userWrapper = 0;
 
-        if (user.isLost())
+        if (user.isLost)
         {
-            if(m_users.contains(user.getId()))
+            userWrapper = getUser(user.id);
+
+            if(userWrapper)
             {
-                emit userLost(user.getId());
-                m_users.remove(user.getId());
-                delete userWrapper;
+                m_changes |= UsersChange;
+                m_userModel->removeUser(userWrapper);
+                emit userLost(user.id);
+
+                // QML may still hold it, so it goes back to the pool rather than away
+                m_userPool.release(userWrapper);
                 userWrapper = 0;
             }
         }
         else
         {
+            int changes = userChanges[i];
+            userWrapper = getUser(user.id);
 
-            if(user.getSkeleton().getState() == nite::SKELETON_TRACKED)
+            if(!userWrapper)
             {
-                skeletons++;
+                // the worker may have seen this id before, as a lost user; a fresh object needs everything
+                changes = QNiTEUser::AllChanges;
+
+                // more users than the source said it tracks; the pool logs it
+                userWrapper = m_userPool.acquire(user.id);
+                if(!userWrapper)
+                    continue;
+
+                userWrapper->setBatchedNotifications(m_batchedNotifications);
+                m_userModel->insertUser(userWrapper);
+                m_changes |= UsersChange;
+                emit userFound(user.id);
             }
 
-            userWrapper = getUser(user.getId());
+            userWrapper->update(user, changes);
 
-            if(user.isNew())
-                m_userTracker->startSkeletonTracking(user.getId());
+            if(m_batchedNotifications)
+                m_deferredUsers.append(userWrapper);
 
-            if(!userWrapper)
+            if(userWrapper->changes())
             {
-                userWrapper = new QNiTEUser(user.getId(), this);
-                m_users.insert(user.getId(), userWrapper);
-                m_userTracker->startSkeletonTracking(user.getId());
-                emit userFound(user.getId());
+                m_changes |= UsersChange;
+                m_userModel->userUpdated(userWrapper);
             }
-
-            userWrapper->update(user);
         }
 
     }
 
-    setSkeletonCount(skeletons);
+    setSkeletonCount(m_snapshot->skeletonCount);
 
-    const nite::Plane & ground = m_frameRef.getFloor();
+    setGroundNormal(frame.floorNormal);
+    setGroundPoint(frame.floorPoint);
+    setGroundConfidence(frame.floorConfidence);
 
-    setGroundNormal(QVector3D(ground.normal.x, ground.normal.y, ground.normal.z));
-    setGroundPoint(QVector3D(ground.point.x, ground.point.y, ground.point.z));
-    setGroundConfidence(m_frameRef.getFloorConfidence());
+    if(m_capture.isOpen() && !m_capture.append(frame))
+    {
+        qDebug("[QNiTE::processNewFrame] Skeleton capture stopped: %s", qPrintable(m_capture.errorString()));
+        setCaptureFile(QString());
+    }
 
-    m_frameRef.release();
+    m_publisher.publish(frame);
+    m_streamServer->publish(frame);
 
-    unlockFrameRef();
+    m_applyingFrame = false;
 
+    m_trackerTiming.processEnd = qniteTimestampNs();
+
+    emitDeferredChanges();
+    emit frameCommitted(m_changes);
     emit newTrackerFrame();
+
+    m_trackerTiming.delivered = qniteTimestampNs();
+    m_latencyStats->recordDelivery(m_trackerTiming);
+
+    emit frameCountersChanged();
+}
+
+void QNiTE::emitDeferredChanges()
+{
+    if(!m_batchedNotifications)
+        return;
+
+    // the frame is fully applied by now, so handlers see all of it whatever they read
+    for (int i = 0; i < m_deferredUsers.size(); ++i)
+        m_deferredUsers[i]->emitDeferredChanges();
+    m_deferredUsers.clear();
+
+    if(m_changes & UserCountChange)
+        emit userCountChanged(m_userCount);
+    if(m_changes & FrameIndexChange)
+        emit frameIndexChanged(m_frameIndex);
+    if(m_changes & SkeletonCountChange)
+        emit skeletonCountChanged(m_skeletonCount);
+    if(m_changes & GroundPointChange)
+        emit groundPointChanged(m_groundPoint);
+    if(m_changes & GroundNormalChange)
+        emit groundNormalChanged(m_groundNormal);
+    if(m_changes & GroundConfidenceChange)
+        emit groundConfidenceChanged(m_groundConfidence);
 }
 
 void QNiTE::processNewRGBFrame()
 {
+    if(!m_rgbFrames.acquire())
+        return;
+
+    m_colorImages.setFrame(m_rgbFrames.front());
     emit newRGBFrame();
 }
 
+void QNiTE::setBatchedNotifications(bool arg)
+{
+    if (m_batchedNotifications == arg)
+        return;
+
+    m_batchedNotifications = arg;
+
+    for (int i = 0; i < m_userModel->rowCount(); ++i)
+        m_userModel->userAt(i)->setBatchedNotifications(arg);
+
+    emit batchedNotificationsChanged(arg);
+}
+
+void QNiTE::setFramePolicy(FramePolicy arg)
+{
+    if (m_framePolicy == arg)
+        return;
+
+    if(m_initialized)
+    {
+        qDebug("[QNiTE::setFramePolicy] Already initialized, ignoring.");
+        return;
+    }
+
+    m_framePolicy = arg;
+    configureFrameQueues();
+    emit framePolicyChanged(arg);
+}
+
+void QNiTE::setFrameQueueSize(int arg)
+{
+    arg = qMax(1, arg);
+
+    if (m_frameQueueSize == arg)
+        return;
+
+    if(m_initialized)
+    {
+        qDebug("[QNiTE::setFrameQueueSize] Already initialized, ignoring.");
+        return;
+    }
+
+    m_frameQueueSize = arg;
+    configureFrameQueues();
+    emit frameQueueSizeChanged(arg);
+}
+
+void QNiTE::configureFrameQueues()
+{
+    m_trackerFrames.configure(QNiTEFrameQueue<QNiTETrackerFrame>::Policy(m_framePolicy), m_frameQueueSize);
+
+    // snapshots must not be lost, their user changes are relative to each other;
+    // a full queue stalls the worker, and the policy then applies to the frames
+    const int snapshots = m_framePolicy == LatestWins ? 1 : m_frameQueueSize;
+    m_snapshots.configure(QNiTEFrameQueue<QNiTETrackerSnapshotPointer>::BlockProducer, snapshots);
+}
+
+QVariantMap QNiTE::jointFilterParameters() const
+{
+    QVariantMap parameters;
+    parameters["minCutoff"] = m_jointFilter.minCutoff;
+    parameters["beta"] = m_jointFilter.beta;
+    parameters["derivativeCutoff"] = m_jointFilter.derivativeCutoff;
+    parameters["processNoise"] = m_jointFilter.processNoise;
+    parameters["measurementNoise"] = m_jointFilter.measurementNoise;
+    return parameters;
+}
+
+void QNiTE::setJointFilter(JointFilter arg)
+{
+    if (jointFilter() == arg)
+        return;
+
+    m_jointFilter.type = QNiTEJointFilterSettings::Type(arg);
+    updateJointFilter();
+    emit jointFilterChanged(arg);
+}
+
+void QNiTE::setJointFilterParameters(QVariantMap arg)
+{
+    const QVariantMap before = jointFilterParameters();
+
+    m_jointFilter.minCutoff = qMax(0.001f, arg.value("minCutoff", m_jointFilter.minCutoff).toFloat());
+    m_jointFilter.beta = qMax(0.0f, arg.value("beta", m_jointFilter.beta).toFloat());
+    m_jointFilter.derivativeCutoff = qMax(0.001f, arg.value("derivativeCutoff", m_jointFilter.derivativeCutoff).toFloat());
+    m_jointFilter.processNoise = qMax(0.0f, arg.value("processNoise", m_jointFilter.processNoise).toFloat());
+    m_jointFilter.measurementNoise = qMax(0.001f, arg.value("measurementNoise", m_jointFilter.measurementNoise).toFloat());
+
+    const QVariantMap after = jointFilterParameters();
+    if (after == before)
+        return;
+
+    updateJointFilter();
+    emit jointFilterParametersChanged(after);
+}
+
+void QNiTE::setPredictionTime(qreal arg)
+{
+    if (m_predictionTime == arg)
+        return;
+
+    m_predictionTime = arg;
+    updateJointFilter();
+    emit predictionTimeChanged(arg);
+}
+
+void QNiTE::updateJointFilter()
+{
+    QNiTEJointFilterSettings settings = m_jointFilter;
+
+    if (m_predictionTime >= 0)
+    {
+        settings.predictionMs = m_predictionTime;
+    }
+    else
+    {
+        // from the sensor capturing a frame to the swap showing it
+        settings.predictionMs = m_latencyStats->sensor().value("p50").toFloat()
+                + m_latencyStats->total().value("p50").toFloat();
+    }
+
+    m_worker->setJointFilter(settings);
+}
+
+void QNiTE::resetFrameCounters()
+{
+    m_trackerFrames.resetCounters();
+    m_snapshots.resetCounters();
+    emit frameCountersChanged();
+}
+
+void QNiTE::setCaptureFile(QString arg)
+{
+    if (m_captureFile == arg)
+        return;
+
+    m_capture.close();
+    m_capture.setMaxUsers(m_source ? m_source->maxUsers() : QNITE_MAX_USERS);
+
+    if(!arg.isEmpty() && !m_capture.open(arg))
+    {
+        qDebug("[QNiTE::setCaptureFile] Could not open %s: %s", qPrintable(arg), qPrintable(m_capture.errorString()));
+        arg = QString();
+    }
+
+    if (m_captureFile == arg)
+        return;
+
+    m_captureFile = arg;
+    emit captureFileChanged(arg);
+}
+
+void QNiTE::setSharedMemoryName(QString arg)
+{
+    if (m_sharedMemoryName == arg)
+        return;
+
+    m_publisher.close();
+    m_publisher.setMaxUsers(m_source ? m_source->maxUsers() : QNITE_MAX_USERS);
+
+    if(!arg.isEmpty() && !m_publisher.open(arg))
+    {
+        qDebug("[QNiTE::setSharedMemoryName] Could not create %s: %s", qPrintable(arg), qPrintable(m_publisher.errorString()));
+        arg = QString();
+    }
+
+    if (m_sharedMemoryName == arg)
+        return;
+
+    m_sharedMemoryName = arg;
+    emit sharedMemoryNameChanged(arg);
+}
+
+void QNiTE::setStreamName(QString arg)
+{
+    if (m_streamName == arg)
+        return;
+
+    m_streamServer->close();
+
+    if(!arg.isEmpty() && !m_streamServer->listen(arg))
+    {
+        qDebug("[QNiTE::setStreamName] Could not listen on %s: %s", qPrintable(arg), qPrintable(m_streamServer->errorString()));
+        arg = QString();
+    }
+
+    if (m_streamName == arg)
+        return;
+
+    m_streamName = arg;
+    emit streamNameChanged(arg);
+}
+
+QSharedPointer<const QNiTERegistrationTable> QNiTE::registrationTable(int depthWidth, int depthHeight, int colorWidth, int colorHeight)
+{
+    QMutexLocker locker(&m_registrationMutex);
+
+    if(!m_source)
+        return QSharedPointer<const QNiTERegistrationTable>();
+
+    // video modes rarely change, so one table is enough
+    if(!m_registration || !m_registration->matches(depthWidth, depthHeight, colorWidth, colorHeight))
+        m_registration = QNiTERegistrationTable::build(*m_source, depthWidth, depthHeight, colorWidth, colorHeight);
+
+    return m_registration;
+}
+
 QVector3D QNiTE::toScreenSpace(QVector3D point)
 {
-    float x, y;
-    m_userTracker->convertJointCoordinatesToDepth(point.x(), point.y(), point.z(), &x, &y);
-    return QVector3D(x, y, point.z());
+    if(!m_source)
+        return QVector3D();
+
+    // cached intrinsics where there are some, a call into the source otherwise
+    const QNiTEDepthIntrinsics & intrinsics = m_snapshot->intrinsics;
+    QPointF p = intrinsics.isValid() ? qniteProjectToDepth(intrinsics, point) : m_source->toDepthSpace(point);
+    return QVector3D(p.x(), p.y(), point.z());
 }
 
 QNiTE::~QNiTE()
 {
     qDebug("[QNiTE] Cleaning house...");
 
-    lockFrameRef();
-    lockRGBFrameRef();
+    m_shutdown.storeRelease(1);
+
+    // a source or worker blocked on a full queue has to get out before it can be stopped
+    m_trackerFrames.abort();
+    m_snapshots.abort();
 
-    if(m_userTracker) m_userTracker->removeNewFrameListener(this);
-    if(m_rgbStream) m_rgbStream->removeNewFrameListener(this);
+    if(m_source)
+        m_source->close();
 
-    m_shutdown = true;
+    m_workerThread.quit();
+    m_workerThread.wait();
+    delete m_worker;
 
-    nite::NiTE::shutdown();
-    openni::OpenNI::shutdown();
+    // drop frames before the source that owns their buffers goes away
+    m_trackerFrames.reset();
+    m_snapshots.reset();
+    m_snapshot.clear();
+    m_rgbFrames.reset();
+    m_colorImages.clear();
 
-    unlockFrameRef();
-    unlockRGBFrameRef();
+    delete m_source;
 }
 
-// user tracker frame
-void QNiTE::onNewFrame(nite::UserTracker & tracker)
+// user tracker frame, on the source's thread
+void QNiTE::onNewTrackerFrame(QNiTEFrameSource & source)
 {
-    Q_UNUSED(tracker)
-
-    lockFrameRef();
+    const qint64 entered = qniteTimestampNs();
 
-    if(m_shutdown) return;
+    if(m_shutdown.loadAcquire()) return;
 
-    if(m_frameRef.isValid())
-        qDebug("[QNiTE::onNewFrame] Overwriting unprocessed user tracker frame");
+    QNiTETrackerFrame & frame = m_trackerFrames.back();
 
-    nite::Status rc = m_userTracker->readFrame(&m_frameRef);
-    if (rc != nite::STATUS_OK)
+    if (!source.readTrackerFrame(&frame))
     {
-        qDebug("[QNiTE::onNewFrame] Getting tracker frame failed");
+        qDebug("[QNiTE::onNewTrackerFrame] Getting tracker frame failed");
         return;
     }
 
-    unlockFrameRef();
+    // the slot is recycled, drop the stages of the frame it held before
+    frame.timing = QNiTEFrameTiming();
+    frame.timing.sensorTimestamp = frame.timestamp;
+    frame.timing.callbackEntry = entered;
 
-    QMetaObject::invokeMethod(this, "processNewFrame", Qt::QueuedConnection);
+    // may drop or coalesce a pending frame, or block, depending on framePolicy;
+    // either way it is counted
+    m_trackerFrames.publish();
+
+    QMetaObject::invokeMethod(m_worker, "process", Qt::QueuedConnection);
 
 }
 
-// rgb frame
-void QNiTE::onNewFrame(openni::VideoStream & stream)
+// rgb frame, on the source's thread
+void QNiTE::onNewColorFrame(QNiTEFrameSource & source)
 {
+    if(m_shutdown.loadAcquire()) return;
 
-    lockRGBFrameRef();
-
-    openni::Status rc = m_rgbStream->readFrame(&m_rgbFrameRef);
-    if (rc != openni::STATUS_OK)
+    if (!source.readColorFrame(&m_rgbFrames.back()))
     {
-        printf("getting rgb frame failed on core\n");
+        qDebug("[QNiTE::onNewColorFrame] Getting rgb frame failed");
         return;
     }
 
-    unlockRGBFrameRef();
+    m_rgbFrames.publish();
 
     QMetaObject::invokeMethod(this, "processNewRGBFrame", Qt::QueuedConnection);
 }
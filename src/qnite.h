@@ -1,23 +1,44 @@
 #ifndef QNITE_H
 #define QNITE_H
 
-#include <OpenNI.h>
-#include <NiTE.h>
-
 #include <QObject>
+#include <QSize>
+#include <QStringList>
+#include <QVariantList>
 #include <QVector3D>
-#include <QMutex>
-#include <QMap>
+#include <QAtomicInt>
 #include <QElapsedTimer>
-
-#define MAX_DEPTH 10000
+#include <QMutex>
+#include <QThread>
+
+#include "qnitecolorimagecache.h"
+#include "qnitedepthhistogram.h"
+#include "qniteframequeue.h"
+#include "qniteframesource.h"
+#include "qnitelatency.h"
+#include "qniteregistration.h"
+#include "qniteskeletoncapture.h"
+#include "qniteskeletonpublisher.h"
+#include "qniteskeletonserver.h"
+#include "qnitetrackerworker.h"
+#include "qniteusermodel.h"
+#include "qniteuserpool.h"
+#include "qnitetriplebuffer.h"
 
 class QNiTEUser;
 
-class QNiTE : public QObject, public nite::UserTracker::NewFrameListener, public openni::VideoStream::NewFrameListener
+class QNiTE : public QObject, public QNiTEFrameSource::Listener
 {
     Q_OBJECT
     Q_PROPERTY(bool initialized READ initialized WRITE setInitialized NOTIFY initializedChanged)
+    Q_PROPERTY(QString sourceUri READ sourceUri WRITE setSourceUri NOTIFY sourceUriChanged)
+    Q_PROPERTY(QStringList deviceUris READ deviceUris WRITE setDeviceUris NOTIFY deviceUrisChanged)
+    Q_PROPERTY(QVariantList deviceTransforms READ deviceTransforms WRITE setDeviceTransforms NOTIFY deviceTransformsChanged)
+    Q_PROPERTY(QSize colorResolution READ colorResolution WRITE setColorResolution NOTIFY colorResolutionChanged)
+    Q_PROPERTY(int colorFps READ colorFps WRITE setColorFps NOTIFY colorFpsChanged)
+    Q_PROPERTY(ColorPixelFormat colorPixelFormat READ colorPixelFormat WRITE setColorPixelFormat NOTIFY colorPixelFormatChanged)
+    Q_PROPERTY(QSize depthResolution READ depthResolution WRITE setDepthResolution NOTIFY depthResolutionChanged)
+    Q_PROPERTY(int depthFps READ depthFps WRITE setDepthFps NOTIFY depthFpsChanged)
     Q_PROPERTY(int userCount READ userCount WRITE setUserCount NOTIFY userCountChanged)
     Q_PROPERTY(int frameIndex READ frameIndex WRITE setFrameIndex NOTIFY frameIndexChanged)
     Q_PROPERTY(int skeletonCount READ skeletonCount WRITE setSkeletonCount NOTIFY skeletonCountChanged)
@@ -25,8 +46,59 @@ class QNiTE : public QObject, public nite::UserTracker::NewFrameListener, public
     Q_PROPERTY(QVector3D groundNormal READ groundNormal WRITE setGroundNormal NOTIFY groundNormalChanged)
     Q_PROPERTY(qreal groundConfidence READ groundConfidence WRITE setGroundConfidence NOTIFY groundConfidenceChanged)
     Q_PROPERTY(bool rgbStreamEnabled READ rgbStreamEnabled WRITE setRgbStreamEnabled NOTIFY rgbStreamEnabledChanged)
+    Q_PROPERTY(QString captureFile READ captureFile WRITE setCaptureFile NOTIFY captureFileChanged)
+    Q_PROPERTY(QString sharedMemoryName READ sharedMemoryName WRITE setSharedMemoryName NOTIFY sharedMemoryNameChanged)
+    Q_PROPERTY(QString streamName READ streamName WRITE setStreamName NOTIFY streamNameChanged)
+    Q_PROPERTY(QNiTELatencyStats* latencyStats READ latencyStats CONSTANT)
+    Q_PROPERTY(QNiTEUserModel* userModel READ userModel CONSTANT)
+    Q_PROPERTY(bool batchedNotifications READ batchedNotifications WRITE setBatchedNotifications NOTIFY batchedNotificationsChanged)
+    Q_PROPERTY(FramePolicy framePolicy READ framePolicy WRITE setFramePolicy NOTIFY framePolicyChanged)
+    Q_PROPERTY(int frameQueueSize READ frameQueueSize WRITE setFrameQueueSize NOTIFY frameQueueSizeChanged)
+    Q_PROPERTY(int framesReceived READ framesReceived NOTIFY frameCountersChanged)
+    Q_PROPERTY(int framesProcessed READ framesProcessed NOTIFY frameCountersChanged)
+    Q_PROPERTY(int framesDropped READ framesDropped NOTIFY frameCountersChanged)
+    Q_PROPERTY(int framesCoalesced READ framesCoalesced NOTIFY frameCountersChanged)
+    Q_PROPERTY(JointFilter jointFilter READ jointFilter WRITE setJointFilter NOTIFY jointFilterChanged)
+    Q_PROPERTY(QVariantMap jointFilterParameters READ jointFilterParameters WRITE setJointFilterParameters NOTIFY jointFilterParametersChanged)
+    Q_PROPERTY(qreal predictionTime READ predictionTime WRITE setPredictionTime NOTIFY predictionTimeChanged)
+    Q_ENUMS(Change FramePolicy JointFilter ColorPixelFormat)
 
 public:
+    // tracker state changed by a frame, as reported by frameCommitted()
+    enum Change {
+        UserCountChange = 0x1,
+        FrameIndexChange = 0x2,
+        SkeletonCountChange = 0x4,
+        GroundPointChange = 0x8,
+        GroundNormalChange = 0x10,
+        GroundConfidenceChange = 0x20,
+        UsersChange = 0x40 // a user was found, lost, or has changes() of its own
+    };
+
+    // what happens to tracker frames while the GUI thread falls behind;
+    // same values as QNiTEFrameQueue::Policy
+    enum FramePolicy {
+        LatestWins,     // keep only the newest frame, for the lowest latency
+        BoundedQueue,   // keep up to frameQueueSize frames, dropping the oldest
+        BlockProducer   // keep up to frameQueueSize frames, then stall the source (offline processing)
+    };
+
+    // smoothing of joint positions, done on the tracker worker thread; same values
+    // as QNiTEJointFilterSettings::Type
+    enum JointFilter {
+        NoJointFilter,
+        OneEuroJointFilter,
+        KalmanJointFilter
+    };
+
+    // what the color camera sends; same values as QNiTEColorFrame::PixelFormat
+    enum ColorPixelFormat {
+        RGB888,
+        YUV422,     // UYVY
+        YUYV,
+        Gray8
+    };
+
     explicit QNiTE(QObject *parent = 0);
     ~QNiTE();
 
@@ -35,8 +107,56 @@ public:
         return m_initialized;
     }
 
-    virtual void onNewFrame(nite::UserTracker&);
-    virtual void onNewFrame(openni::VideoStream&);
+    virtual void onNewTrackerFrame(QNiTEFrameSource & source);
+    virtual void onNewColorFrame(QNiTEFrameSource & source);
+
+    QString sourceUri() const
+    {
+        return m_sourceUri;
+    }
+
+    QStringList deviceUris() const
+    {
+        return m_deviceUris;
+    }
+
+    QVariantList deviceTransforms() const
+    {
+        return m_deviceTransforms;
+    }
+
+    QSize colorResolution() const
+    {
+        return m_colorResolution;
+    }
+
+    int colorFps() const
+    {
+        return m_colorFps;
+    }
+
+    ColorPixelFormat colorPixelFormat() const
+    {
+        return m_colorPixelFormat;
+    }
+
+    QSize depthResolution() const
+    {
+        return m_depthResolution;
+    }
+
+    int depthFps() const
+    {
+        return m_depthFps;
+    }
+
+    // takes ownership; must be called before initialize()
+    void setFrameSource(QNiTEFrameSource * source);
+
+    QNiTEFrameSource * frameSource() const
+    {
+        return m_source;
+    }
 
 
     int userCount() const
@@ -74,12 +194,131 @@ public:
         return m_groundConfidence;
     }
 
+    QString captureFile() const
+    {
+        return m_captureFile;
+    }
+
+    QString sharedMemoryName() const
+    {
+        return m_sharedMemoryName;
+    }
+
+    QString streamName() const
+    {
+        return m_streamName;
+    }
+
+    // to tune keyframes and backlog, or read the counters
+    QNiTESkeletonServer * streamServer() const
+    {
+        return m_streamServer;
+    }
+
+    QNiTELatencyStats * latencyStats() const
+    {
+        return m_latencyStats;
+    }
+
+    // tracked users, ordered by id, for Repeater/Instantiator delegates
+    QNiTEUserModel * userModel() const
+    {
+        return m_userModel;
+    }
+
+    bool batchedNotifications() const
+    {
+        return m_batchedNotifications;
+    }
+
+    FramePolicy framePolicy() const
+    {
+        return m_framePolicy;
+    }
+
+    int frameQueueSize() const
+    {
+        return m_frameQueueSize;
+    }
+
+    JointFilter jointFilter() const
+    {
+        return JointFilter(m_jointFilter.type);
+    }
+
+    // minCutoff, beta, derivativeCutoff (One-Euro), processNoise, measurementNoise (Kalman)
+    QVariantMap jointFilterParameters() const;
+
+    // ms to extrapolate joints ahead; 0 is off, negative follows latencyStats to the expected display time
+    qreal predictionTime() const
+    {
+        return m_predictionTime;
+    }
+
+    // tracker frame accounting since construction or resetFrameCounters()
+    int framesReceived() const
+    {
+        return int(m_trackerFrames.counters().received);
+    }
+
+    int framesProcessed() const
+    {
+        return int(m_snapshots.counters().processed);
+    }
+
+    int framesDropped() const
+    {
+        return int(m_trackerFrames.counters().dropped);
+    }
+
+    int framesCoalesced() const
+    {
+        return int(m_trackerFrames.counters().coalesced);
+    }
+
+    // the latest color frame in RGB32, scaled down to size once per frame however
+    // many renderers ask for it; see QNiTEColorImageCache. Any thread
+    QImage colorImage(const QSize & size = QSize())
+    {
+        return m_colorImages.image(size);
+    }
+
+    // has the tracker worker turn every frame's depth into a point cloud with settings,
+    // from the next frame on and until removePointCloud(); returns the id its cloud has
+    // in trackerSnapshot()->pointCloud(). Every renderer adds its own. Any thread
+    int addPointCloud(const QNiTEPointCloudSettings & settings)
+    {
+        return m_worker->addPointCloud(settings);
+    }
+
+    void setPointCloud(int id, const QNiTEPointCloudSettings & settings)
+    {
+        m_worker->setPointCloud(id, settings);
+    }
+
+    void removePointCloud(int id)
+    {
+        m_worker->removePointCloud(id);
+    }
+
+    // how depth frames of that size land on color frames of that size, built on the
+    // first call for every pair of video modes and shared afterwards; any thread
+    QSharedPointer<const QNiTERegistrationTable> registrationTable(int depthWidth, int depthHeight, int colorWidth, int colorHeight);
+
 signals:
 
     void newTrackerFrame();
     void newRGBFrame();
 
     void initializedChanged(bool arg);
+    void sourceUriChanged(QString arg);
+    void deviceUrisChanged(QStringList arg);
+    void deviceTransformsChanged(QVariantList arg);
+    void colorResolutionChanged(QSize arg);
+    void colorFpsChanged(int arg);
+    void colorPixelFormatChanged(ColorPixelFormat arg);
+    void depthResolutionChanged(QSize arg);
+    void depthFpsChanged(int arg);
     void userCountChanged(int arg);
     void frameIndexChanged(int arg);
 
@@ -96,9 +335,111 @@ signals:
 
     void groundConfidenceChanged(qreal arg);
 
+    void captureFileChanged(QString arg);
+
+    void sharedMemoryNameChanged(QString arg);
+
+    void streamNameChanged(QString arg);
+
+    void batchedNotificationsChanged(bool arg);
+
+    void framePolicyChanged(FramePolicy arg);
+    void frameQueueSizeChanged(int arg);
+
+    void jointFilterChanged(JointFilter arg);
+    void jointFilterParametersChanged(QVariantMap arg);
+    void predictionTimeChanged(qreal arg);
+
+    // after every processed tracker frame, and on resetFrameCounters()
+    void frameCountersChanged();
+
+    // once per tracker frame, after it has been fully applied; changes is a mask of Change
+    void frameCommitted(int changes);
+
 public slots:
 
     void initialize();
+
+    void setSourceUri(QString arg)
+    {
+        if (m_sourceUri == arg)
+            return;
+
+        m_sourceUri = arg;
+        emit sourceUriChanged(arg);
+    }
+
+    // several sensors merged into one user space, see QNiTEMultiSource; the first one
+    // is the primary. Takes over from sourceUri, and must be set before initialize()
+    void setDeviceUris(QStringList arg)
+    {
+        if (m_deviceUris == arg)
+            return;
+
+        m_deviceUris = arg;
+        emit deviceUrisChanged(arg);
+    }
+
+    // a matrix4x4 per device URI, from its camera space into world space (mm);
+    // missing ones are the identity
+    void setDeviceTransforms(QVariantList arg)
+    {
+        if (m_deviceTransforms == arg)
+            return;
+
+        m_deviceTransforms = arg;
+        emit deviceTransformsChanged(arg);
+    }
+
+    // Video modes asked of the sensor; the video mode properties must be set before
+    // initialize(), and an empty size or fps 0 keeps the sensor's default. Modes the
+    // sensor does not have are reported and left at the default.
+    void setColorResolution(QSize arg)
+    {
+        if (m_colorResolution == arg)
+            return;
+
+        m_colorResolution = arg;
+        emit colorResolutionChanged(arg);
+    }
+
+    void setColorFps(int arg)
+    {
+        if (m_colorFps == arg)
+            return;
+
+        m_colorFps = arg;
+        emit colorFpsChanged(arg);
+    }
+
+    // anything but RGB888 saves USB bandwidth, and is converted to RGB for display
+    void setColorPixelFormat(ColorPixelFormat arg)
+    {
+        if (m_colorPixelFormat == arg)
+            return;
+
+        m_colorPixelFormat = arg;
+        emit colorPixelFormatChanged(arg);
+    }
+
+    void setDepthResolution(QSize arg)
+    {
+        if (m_depthResolution == arg)
+            return;
+
+        m_depthResolution = arg;
+        emit depthResolutionChanged(arg);
+    }
+
+    void setDepthFps(int arg)
+    {
+        if (m_depthFps == arg)
+            return;
+
+        m_depthFps = arg;
+        emit depthFpsChanged(arg);
+    }
+
     void setInitialized(bool arg)
     {
         if (m_initialized == arg)
@@ -114,7 +455,8 @@ public slots:
             return;
 
         m_userCount = arg;
-        emit userCountChanged(arg);
+        if (!deferChange(UserCountChange))
+            emit userCountChanged(arg);
     }
 
     void setFrameIndex(int arg)
@@ -123,33 +465,32 @@ public slots:
             return;
 
         m_frameIndex = arg;
-        emit frameIndexChanged(arg);
+        if (!deferChange(FrameIndexChange))
+            emit frameIndexChanged(arg);
     }
 
 
-    nite::UserTrackerFrameRef * getFrameRef()
-    {
-        return &m_frameRef;
-    }
-
-    void lockFrameRef()
+    // latest applied frames; only valid on the GUI thread (or during scene graph sync).
+    // The tracker frame's users are unfiltered, the snapshot's are what users show
+    const QNiTETrackerFrame & trackerFrame() const
     {
-        m_frameRefMutex.lock();
+        return m_snapshot->frame;
     }
 
-    void unlockFrameRef()
+    QNiTETrackerSnapshotPointer trackerSnapshot() const
     {
-        m_frameRefMutex.unlock();
+        return m_snapshot;
     }
 
-    void lockRGBFrameRef()
+    // the pipeline stages the latest applied tracker frame went through
+    const QNiTEFrameTiming & trackerTiming() const
     {
-        m_rgbFrameRefMutex.lock();
+        return m_trackerTiming;
     }
 
-    void unlockRGBFrameRef()
+    const QNiTEColorFrame & rgbFrame() const
     {
-        m_rgbFrameRefMutex.unlock();
+        return m_rgbFrames.front();
     }
 
     void processNewFrame();
@@ -157,6 +498,7 @@ public slots:
     void processNewRGBFrame();
 
 
+    // depth image pixels, z kept in mm; QNiTEUser::projectedJoints has whole skeletons ready
     QVector3D toScreenSpace(QVector3D point);
 
     void setRgbStreamEnabled(bool arg)
@@ -167,10 +509,8 @@ public slots:
         m_rgbStreamEnabled = arg;
         emit rgbStreamEnabledChanged(arg);
 
-        if(arg)
-            m_rgbStream->start();
-        else
-            m_rgbStream->stop();
+        if(m_source)
+            m_source->setColorEnabled(arg);
     }
 
     void setSkeletonCount(int arg)
@@ -179,7 +519,8 @@ public slots:
             return;
 
         m_skeletonCount = arg;
-        emit skeletonCountChanged(arg);
+        if (!deferChange(SkeletonCountChange))
+            emit skeletonCountChanged(arg);
     }
 
     void utilTrimEngineComponentCache();
@@ -188,12 +529,12 @@ public slots:
 
     QNiTEUser * getUser(int id)
     {
-        return m_users.value(id, 0);
+        return m_userModel->userById(id);
     }
 
     QNiTEUser * getUserByIndex(int index)
     {
-        return m_users.values().value(index);
+        return m_userModel->userAt(index);
     }
 
     void setGroundPoint(QVector3D arg)
@@ -202,7 +543,8 @@ public slots:
             return;
 
         m_groundPoint = arg;
-        emit groundPointChanged(arg);
+        if (!deferChange(GroundPointChange))
+            emit groundPointChanged(arg);
     }
 
     void setGroundNormal(QVector3D arg)
@@ -211,7 +553,8 @@ public slots:
             return;
 
         m_groundNormal = arg;
-        emit groundNormalChanged(arg);
+        if (!deferChange(GroundNormalChange))
+            emit groundNormalChanged(arg);
     }
 
     void setGroundConfidence(qreal arg)
@@ -220,21 +563,90 @@ public slots:
             return;
 
         m_groundConfidence = arg;
-        emit groundConfidenceChanged(arg);
+        if (!deferChange(GroundConfidenceChange))
+            emit groundConfidenceChanged(arg);
     }
 
+    // per-property signals of tracker state and users are held back while a frame is
+    // applied, and emitted once each right before frameCommitted()
+    void setBatchedNotifications(bool arg);
+
+    // records every processed tracker frame to a skeleton capture file; empty stops
+    void setCaptureFile(QString arg);
+
+    // publishes every processed tracker frame to a POSIX shared memory segment for
+    // other processes, see QNiTESkeletonSubscriber; empty stops
+    void setSharedMemoryName(QString arg);
+
+    // serves every processed tracker frame as a delta-encoded skeleton stream on a
+    // local socket of that name, see QNiTESkeletonDecoder; empty stops
+    void setStreamName(QString arg);
+
+    // both must be set before initialize()
+    void setFramePolicy(FramePolicy arg);
+    void setFrameQueueSize(int arg);
+
+    void resetFrameCounters();
+
+    void setJointFilter(JointFilter arg);
+
+    // keys left out keep their value
+    void setJointFilterParameters(QVariantMap arg);
+
+    void setPredictionTime(qreal arg);
+
 private:
+    // sets both tracker queues up for framePolicy and frameQueueSize
+    void configureFrameQueues();
+
+    // hands the joint filter settings, and the prediction time in effect, to the worker
+    void updateJointFilter();
+
+    // records a change made while applying a frame; true if its signal is to be held back
+    bool deferChange(Change change)
+    {
+        if (!m_applyingFrame)
+            return false;
+
+        m_changes |= change;
+        return m_batchedNotifications;
+    }
+
+    // in batched mode, the signals held back while applying the frame, once each
+    void emitDeferredChanges();
+
     friend class QNiTETrackerRenderer;
     friend class QNiTEColorRenderer;
 
-    openni::Device * m_device;
-    openni::VideoStream * m_rgbStream;
-    openni::VideoFrameRef m_rgbFrameRef;
-    QMutex m_rgbFrameRefMutex;
+    QString m_sourceUri;
+    QStringList m_deviceUris;
+    QVariantList m_deviceTransforms;
+    QNiTEFrameSource * m_source;
+
+    QSize m_colorResolution;
+    int m_colorFps;
+    ColorPixelFormat m_colorPixelFormat;
+    QSize m_depthResolution;
+    int m_depthFps;
+
+    QNiTETripleBuffer<QNiTEColorFrame> m_rgbFrames;
+    QNiTEColorImageCache m_colorImages;
+
+    // source thread -> worker thread, under framePolicy
+    QNiTEFrameQueue<QNiTETrackerFrame> m_trackerFrames;
+
+    // worker thread -> GUI thread, never drops
+    QNiTEFrameQueue<QNiTETrackerSnapshotPointer> m_snapshots;
+
+    QThread m_workerThread;
+    QNiTETrackerWorker * m_worker;
+
+    QNiTETrackerSnapshotPointer m_snapshot;
+
+    QMutex m_registrationMutex;
+    QSharedPointer<const QNiTERegistrationTable> m_registration;
+    QNiTEFrameTiming m_trackerTiming;
 
-    nite::UserTracker * m_userTracker;
-    nite::UserTrackerFrameRef m_frameRef;
-    QMutex m_frameRefMutex;
     bool m_initialized;
 
     int m_userCount;
@@ -242,13 +654,36 @@ private:
     bool m_rgbStreamEnabled;
     int m_skeletonCount;
 
-    QMap<int, QNiTEUser *> m_users;
+    QNiTEUserPool m_userPool;
 
-    bool m_shutdown;
+    QAtomicInt m_shutdown;
     QVector3D m_groundPoint;
     QVector3D m_groundNormal;
     qreal m_groundConfidence;
 
+    QString m_captureFile;
+    QNiTESkeletonWriter m_capture;
+
+    QString m_sharedMemoryName;
+    QNiTESkeletonPublisher m_publisher;
+
+    QString m_streamName;
+    QNiTESkeletonServer * m_streamServer;
+
+    QNiTELatencyStats * m_latencyStats;
+    QNiTEUserModel * m_userModel;
+
+    FramePolicy m_framePolicy;
+    int m_frameQueueSize;
+
+    QNiTEJointFilterSettings m_jointFilter;
+    qreal m_predictionTime;
+
+    bool m_batchedNotifications;
+    bool m_applyingFrame;
+    int m_changes;
+    QVector<QNiTEUser *> m_deferredUsers; // updated while applying the frame, in batched mode
+
     QElapsedTimer m_timer;
 };
 
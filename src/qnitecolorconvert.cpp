@@ -0,0 +1,248 @@
+#include "qnitecolorconvert.h"
+
+#include "qnitecpu.h"
+
+static inline quint32 clampChannel(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// BT.601 studio range, 8 bit fixed point; the SSE2 kernel does the same sums
+static inline quint32 yuvToRgb32(int y, int u, int v)
+{
+    const int c = 298 * (y - 16);
+    const int d = u - 128;
+    const int e = v - 128;
+
+    const quint32 r = clampChannel((c + 409 * e + 128) >> 8);
+    const quint32 g = clampChannel((c - 100 * d - 208 * e + 128) >> 8);
+    const quint32 b = clampChannel((c + 516 * d + 128) >> 8);
+
+    return 0xff000000u | (r << 16) | (g << 8) | b;
+}
+
+static void rgb888Scalar(const uchar * in, quint32 * out, int count)
+{
+    for (int i = 0; i < count; ++i, in += 3)
+        out[i] = 0xff000000u | (quint32(in[0]) << 16) | (quint32(in[1]) << 8) | in[2];
+}
+
+static void gray8Scalar(const uchar * in, quint32 * out, int count)
+{
+    for (int i = 0; i < count; ++i)
+        out[i] = 0xff000000u | (quint32(in[i]) * 0x010101u);
+}
+
+// byte offsets of Y0, U, Y1 and V within a pixel pair
+template <int Y0, int U, int Y1, int V>
+static void yuvScalar(const uchar * in, quint32 * out, int count)
+{
+    int i = 0;
+    for (; i + 2 <= count; i += 2, in += 4)
+    {
+        out[i] = yuvToRgb32(in[Y0], in[U], in[V]);
+        out[i + 1] = yuvToRgb32(in[Y1], in[U], in[V]);
+    }
+
+    // a last pixel without a pair has no V of its own
+    if (i < count)
+        out[i] = yuvToRgb32(in[Y0], in[U], 128);
+}
+
+static void yuyvScalar(const uchar * in, quint32 * out, int count)
+{
+    yuvScalar<0, 1, 2, 3>(in, out, count);
+}
+
+static void yuv422Scalar(const uchar * in, quint32 * out, int count)
+{
+    yuvScalar<1, 0, 3, 2>(in, out, count);
+}
+
+#ifdef QNITE_X86_SIMD
+
+__attribute__((target("ssse3")))
+static void rgb888SSSE3(const uchar * in, quint32 * out, int count)
+{
+    // R G B of four pixels to B G R of the same, alpha filled in below
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+    // every load takes 16 bytes to use 12, so stop while the next 4 are still whole pixels
+    int i = 0;
+    for (; i + 6 <= count; i += 4)
+    {
+        const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 3 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+
+    rgb888Scalar(in + 3 * i, out + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void gray8SSE2(const uchar * in, quint32 * out, int count)
+{
+    const __m128i alpha = _mm_set1_epi8(char(0xff));
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        const __m128i gg = _mm_unpacklo_epi8(gray, gray);
+        const __m128i ga = _mm_unpacklo_epi8(gray, alpha);
+        const __m128i ggHigh = _mm_unpackhi_epi8(gray, gray);
+        const __m128i gaHigh = _mm_unpackhi_epi8(gray, alpha);
+
+        __m128i * o = reinterpret_cast<__m128i *>(out + i);
+        _mm_storeu_si128(o, _mm_unpacklo_epi16(gg, ga));
+        _mm_storeu_si128(o + 1, _mm_unpackhi_epi16(gg, ga));
+        _mm_storeu_si128(o + 2, _mm_unpacklo_epi16(ggHigh, gaHigh));
+        _mm_storeu_si128(o + 3, _mm_unpackhi_epi16(ggHigh, gaHigh));
+    }
+
+    gray8Scalar(in + i, out + i, count - i);
+}
+
+// a for the first of every pair of 16 bit lanes, b for the second
+__attribute__((target("sse2")))
+static inline __m128i coefficientPairs(short a, short b)
+{
+    return _mm_setr_epi16(a, b, a, b, a, b, a, b);
+}
+
+// one channel of four pixels: (a * ka + b * kb + bias) >> 8, from interleaved 16 bit pairs
+__attribute__((target("sse2")))
+static inline __m128i channelOf4(__m128i ab, __m128i coefficients, __m128i bias)
+{
+    return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ab, coefficients), bias), 8);
+}
+
+/*
+ * Eight pixels from 16 bit lanes holding each pixel's Y - 16, and its pair's U - 128
+ * and V - 128. _mm_madd_epi16 keeps the sums in 32 bits, where 298 * 239 fits.
+ */
+__attribute__((target("sse2")))
+static inline void yuvToRgb32x8(__m128i c, __m128i d, __m128i e, quint32 * out)
+{
+    const __m128i ce = coefficientPairs(298, 409);
+    const __m128i cdG = coefficientPairs(298, -100);
+    const __m128i cdB = coefficientPairs(298, 516);
+    const __m128i eOne = coefficientPairs(-208, 128); // the rounding rides along as 128 * 1
+    const __m128i rounding = _mm_set1_epi32(128);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+
+    __m128i r[2], g[2], b[2];
+    for (int half = 0; half < 2; ++half)
+    {
+        const __m128i cePairs = half ? _mm_unpackhi_epi16(c, e) : _mm_unpacklo_epi16(c, e);
+        const __m128i cdPairs = half ? _mm_unpackhi_epi16(c, d) : _mm_unpacklo_epi16(c, d);
+        const __m128i e1Pairs = half ? _mm_unpackhi_epi16(e, one) : _mm_unpacklo_epi16(e, one);
+
+        r[half] = channelOf4(cePairs, ce, rounding);
+        g[half] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cdPairs, cdG), _mm_madd_epi16(e1Pairs, eOne)), 8);
+        b[half] = channelOf4(cdPairs, cdB, rounding);
+    }
+
+    // saturating packs clamp to 0..255 like the scalar code
+    const __m128i r8 = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), zero);
+    const __m128i g8 = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), zero);
+    const __m128i b8 = _mm_packus_epi16(_mm_packs_epi32(b[0], b[1]), zero);
+
+    const __m128i bg = _mm_unpacklo_epi8(b8, g8);
+    const __m128i ra = _mm_unpacklo_epi8(r8, _mm_set1_epi8(char(0xff)));
+
+    __m128i * o = reinterpret_cast<__m128i *>(out);
+    _mm_storeu_si128(o, _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128(o + 1, _mm_unpackhi_epi16(bg, ra));
+}
+
+// lumaHigh: Y sits in the high byte of every 16 bit lane (UYVY) rather than the low one (YUYV)
+template <bool LumaHigh>
+__attribute__((target("sse2")))
+static void yuvSSE2(const uchar * in, quint32 * out, int count)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    const __m128i lowWords = _mm_set1_epi32(0x0000ffff);
+    const __m128i sixteen = _mm_set1_epi16(16);
+    const __m128i offset = _mm_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i));
+
+        const __m128i y = LumaHigh ? _mm_srli_epi16(pixels, 8) : _mm_and_si128(pixels, lowBytes);
+        const __m128i uv = LumaHigh ? _mm_and_si128(pixels, lowBytes) : _mm_srli_epi16(pixels, 8);
+
+        // U and V of each pair into both of its pixels' lanes
+        const __m128i u = _mm_and_si128(uv, lowWords);
+        const __m128i v = _mm_srli_epi32(uv, 16);
+
+        yuvToRgb32x8(_mm_sub_epi16(y, sixteen),
+                     _mm_sub_epi16(_mm_or_si128(u, _mm_slli_epi32(u, 16)), offset),
+                     _mm_sub_epi16(_mm_or_si128(v, _mm_slli_epi32(v, 16)), offset),
+                     out + i);
+    }
+
+    if (LumaHigh)
+        yuv422Scalar(in + 2 * i, out + i, count - i);
+    else
+        yuyvScalar(in + 2 * i, out + i, count - i);
+}
+
+#endif // QNITE_X86_SIMD
+
+typedef void (*ConvertFunction)(const uchar *, quint32 *, int);
+
+struct ConvertKernels
+{
+    ConvertFunction rgb888;
+    ConvertFunction yuv422;
+    ConvertFunction yuyv;
+    ConvertFunction gray8;
+    const char * name;
+    int features;
+};
+
+static const ConvertKernels s_convertKernels[] = {
+#ifdef QNITE_X86_SIMD
+    { rgb888SSSE3, yuvSSE2<true>, yuvSSE2<false>, gray8SSE2, "ssse3", QNiTECpuSSE2 | QNiTECpuSSSE3 },
+    { rgb888Scalar, yuvSSE2<true>, yuvSSE2<false>, gray8SSE2, "sse2", QNiTECpuSSE2 },
+#endif
+    { rgb888Scalar, yuv422Scalar, yuyvScalar, gray8Scalar, "scalar", 0 }
+};
+
+static ConvertFunction convertFunction(QNiTEColorFrame::PixelFormat format)
+{
+    const ConvertKernels & kernels = qniteSelectKernel(s_convertKernels);
+
+    switch (format)
+    {
+    case QNiTEColorFrame::YUV422: return kernels.yuv422;
+    case QNiTEColorFrame::YUYV: return kernels.yuyv;
+    case QNiTEColorFrame::Gray8: return kernels.gray8;
+    default: return kernels.rgb888;
+    }
+}
+
+void qniteConvertColorRow(QNiTEColorFrame::PixelFormat format, const uchar * in, quint32 * out, int count)
+{
+    convertFunction(format)(in, out, count);
+}
+
+void qniteConvertColorFrame(const QNiTEColorFrame & frame, quint32 * out, int stride)
+{
+    const ConvertFunction convert = convertFunction(frame.pixelFormat);
+
+    const uchar * in = frame.data;
+    uchar * row = reinterpret_cast<uchar *>(out);
+
+    for (int y = 0; y < frame.height; ++y, in += frame.stride, row += stride)
+        convert(in, reinterpret_cast<quint32 *>(row), frame.width);
+}
+
+const char * qniteColorConvertImplementation()
+{
+    return qniteSelectKernel(s_convertKernels).name;
+}
@@ -0,0 +1,25 @@
+#ifndef QNITECOLORCONVERT_H
+#define QNITECOLORCONVERT_H
+
+#include "qniteframe.h"
+
+/*
+ * Turns color frames in any QNiTEColorFrame::PixelFormat into opaque RGB32
+ * (0xffRRGGBB, B G R A in memory), which the scene graph uploads as it is.
+ *
+ * YUV is taken as BT.601 with studio range, like OpenNI's own conversions, in 8
+ * bit fixed point. RGB888 is reordered with SSSE3 and YUV and gray are expanded with
+ * SSE2 where the CPU has them (see qnitecpu.h); tests/auto/colorconvert holds them
+ * to the scalar output.
+ */
+
+// one row of count pixels; in YUV rows an odd last pixel has no V of its own, and gets a neutral one
+void qniteConvertColorRow(QNiTEColorFrame::PixelFormat format, const uchar * in, quint32 * out, int count);
+
+// the whole frame into out, stride in bytes
+void qniteConvertColorFrame(const QNiTEColorFrame & frame, quint32 * out, int stride);
+
+// which of "ssse3", "sse2" and "scalar" qniteConvertColorFrame() runs
+const char * qniteColorConvertImplementation();
+
+#endif // QNITECOLORCONVERT_H
@@ -0,0 +1,76 @@
+#include "qnitecolorimagecache.h"
+
+#include "qnitecolorconvert.h"
+
+QNiTEColorImageCache::QNiTEColorImageCache()
+{
+    m_frameSerial = 0;
+    m_imageFrame = 0;
+}
+
+void QNiTEColorImageCache::setFrame(const QNiTEColorFrame & frame)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_frame = frame;
+    ++m_frameSerial;
+
+    // keep the buffers of sizes still in use, to write the new frame into
+    QHash<quint64, Scaled>::iterator i = m_scaled.begin();
+    while (i != m_scaled.end())
+    {
+        if (i->frame + 1 < m_frameSerial)
+            i = m_scaled.erase(i);
+        else
+            ++i;
+    }
+}
+
+void QNiTEColorImageCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_frame = QNiTEColorFrame();
+    m_frameSerial = 0;
+
+    m_image = QImage();
+    m_imageFrame = 0;
+    m_scaled.clear();
+}
+
+QImage QNiTEColorImageCache::image(const QSize & size)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_frameSerial || !m_frame.isValid())
+        return QImage();
+
+    if (m_imageFrame != m_frameSerial)
+    {
+        if (m_image.width() != m_frame.width || m_image.height() != m_frame.height)
+            m_image = QImage(m_frame.width, m_frame.height, QImage::Format_RGB32);
+
+        // bits() detaches if anyone still holds the previous frame
+        qniteConvertColorFrame(m_frame, reinterpret_cast<quint32 *>(m_image.bits()), m_image.bytesPerLine());
+        m_imageFrame = m_frameSerial;
+    }
+
+    // the scene graph scales up just as well
+    if (size.isEmpty() || (size.width() >= m_frame.width && size.height() >= m_frame.height))
+        return m_image;
+
+    const int width = qMin(size.width(), m_frame.width), height = qMin(size.height(), m_frame.height);
+    Scaled & scaled = m_scaled[(quint64(width) << 32) | quint64(height)];
+
+    if (scaled.frame != m_frameSerial)
+    {
+        if (scaled.image.isNull())
+            scaled.image = QImage(width, height, QImage::Format_RGB32);
+
+        m_scaler.scale(reinterpret_cast<const quint32 *>(m_image.constBits()), m_image.width(), m_image.height(), m_image.bytesPerLine(),
+                       reinterpret_cast<quint32 *>(scaled.image.bits()), width, height, scaled.image.bytesPerLine());
+        scaled.frame = m_frameSerial;
+    }
+
+    return scaled.image;
+}
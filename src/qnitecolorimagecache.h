@@ -0,0 +1,55 @@
+#ifndef QNITECOLORIMAGECACHE_H
+#define QNITECOLORIMAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+
+#include "qniteframe.h"
+#include "qniteimagescaler.h"
+
+/*
+ * The latest color frame as RGB32 images, shared by everything that draws it.
+ *
+ * The frame is converted the first time an image of it is asked for, and scaled
+ * down once per frame for every size asked for, so any number of renderers of
+ * the same size cost one conversion and one scale. Sizes nobody asked for during
+ * the previous frame are dropped when a new one comes in. Images stay valid for
+ * as long as their holders keep them; the cache writes the next frame into the
+ * same memory only once they have let go, and into a copy otherwise.
+ */
+class QNiTEColorImageCache
+{
+public:
+    QNiTEColorImageCache();
+
+    void setFrame(const QNiTEColorFrame & frame);
+    void clear();
+
+    // scaled to size, or the whole frame if size is empty or not smaller than it;
+    // a null image before the first frame. Any thread
+    QImage image(const QSize & size);
+
+private:
+    struct Scaled
+    {
+        Scaled() : frame(0) {}
+
+        QImage image;
+        quint64 frame; // the frame image holds
+    };
+
+    QMutex m_mutex;
+
+    QNiTEColorFrame m_frame;
+    quint64 m_frameSerial; // 0 while there is no frame
+
+    QImage m_image;
+    quint64 m_imageFrame;
+
+    QHash<quint64, Scaled> m_scaled; // by width << 32 | height
+    QNiTEImageScaler m_scaler;
+};
+
+#endif // QNITECOLORIMAGECACHE_H
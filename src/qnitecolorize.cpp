@@ -0,0 +1,160 @@
+#include "qnitecolorize.h"
+
+#include "qnitecpu.h"
+
+// channel masks applied to the gray value: background, then users by id % 3
+static const quint32 s_palette[4] = {
+    0x00ffffff, // background
+    0x00ff0000, // id % 3 == 0
+    0x0000ff00, // id % 3 == 1
+    0x000000ff  // id % 3 == 2
+};
+
+static const quint32 s_opaque = 0xff000000;
+
+static inline quint32 paletteMask(qint16 label)
+{
+    return label == 0 ? s_palette[0] : s_palette[1 + quint16(label) % 3];
+}
+
+static void colorizeScalar(const quint16 * depth, const qint16 * labels, const quint8 * lut, quint32 * out, int count)
+{
+    for (int i = 0; i < count; ++i)
+        out[i] = s_opaque | ((lut[depth[i]] * 0x010101u) & paletteMask(labels[i]));
+}
+
+#ifdef QNITE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void colorizeSSE2(const quint16 * depth, const qint16 * labels, const quint8 * lut, quint32 * out, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i three = _mm_set1_epi16(3);
+    const __m128i divideBy3 = _mm_set1_epi16((short)0xaaab);
+    const __m128i opaque = _mm_set1_epi32(s_opaque);
+    const __m128i background = _mm_set1_epi32(s_palette[0]);
+    const __m128i palette0 = _mm_set1_epi32(s_palette[1]);
+    const __m128i palette1 = _mm_set1_epi32(s_palette[2]);
+    const __m128i palette2 = _mm_set1_epi32(s_palette[3]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // no gather on SSE2, the LUT reads stay scalar
+        const quint16 * d = depth + i;
+        __m128i gray = _mm_setr_epi16(lut[d[0]], lut[d[1]], lut[d[2]], lut[d[3]],
+                                      lut[d[4]], lut[d[5]], lut[d[6]], lut[d[7]]);
+
+        // label % 3 without a division: floor(l / 3) == (l * 0xaaab) >> 17 for 16 bit l
+        __m128i label = _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + i));
+        __m128i quotient = _mm_srli_epi16(_mm_mulhi_epu16(label, divideBy3), 1);
+        __m128i remainder = _mm_sub_epi16(label, _mm_mullo_epi16(quotient, three));
+
+        __m128i isBackground = _mm_cmpeq_epi16(label, zero);
+        __m128i is0 = _mm_cmpeq_epi16(remainder, zero);
+        __m128i is1 = _mm_cmpeq_epi16(remainder, one);
+        __m128i is2 = _mm_cmpeq_epi16(remainder, two);
+
+        for (int half = 0; half < 2; ++half)
+        {
+            __m128i g, bg, m0, m1, m2;
+            if (half == 0)
+            {
+                g = _mm_unpacklo_epi16(gray, zero);
+                bg = _mm_unpacklo_epi16(isBackground, isBackground);
+                m0 = _mm_unpacklo_epi16(is0, is0);
+                m1 = _mm_unpacklo_epi16(is1, is1);
+                m2 = _mm_unpacklo_epi16(is2, is2);
+            }
+            else
+            {
+                g = _mm_unpackhi_epi16(gray, zero);
+                bg = _mm_unpackhi_epi16(isBackground, isBackground);
+                m0 = _mm_unpackhi_epi16(is0, is0);
+                m1 = _mm_unpackhi_epi16(is1, is1);
+                m2 = _mm_unpackhi_epi16(is2, is2);
+            }
+
+            g = _mm_or_si128(g, _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(g, 16)));
+
+            __m128i user = _mm_or_si128(_mm_and_si128(m0, palette0),
+                                        _mm_or_si128(_mm_and_si128(m1, palette1), _mm_and_si128(m2, palette2)));
+            __m128i mask = _mm_or_si128(_mm_and_si128(bg, background), _mm_andnot_si128(bg, user));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + half * 4),
+                             _mm_or_si128(opaque, _mm_and_si128(g, mask)));
+        }
+    }
+
+    colorizeScalar(depth + i, labels + i, lut, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void colorizeAVX2(const quint16 * depth, const qint16 * labels, const quint8 * lut, quint32 * out, int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i divideBy3 = _mm256_set1_epi32(0xaaab);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256i opaque = _mm256_set1_epi32(s_opaque);
+    const __m256i background = _mm256_set1_epi32(s_palette[0]);
+    const __m256i palette0 = _mm256_set1_epi32(s_palette[1]);
+    const __m256i palette1 = _mm256_set1_epi32(s_palette[2]);
+    const __m256i palette2 = _mm256_set1_epi32(s_palette[3]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // 32 bit gathers read 3 bytes past the entry, hence the padded LUT
+        __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(depth + i)));
+        __m256i g = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(lut), index, 1), byteMask);
+        g = _mm256_or_si256(g, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(g, 16)));
+
+        __m256i label = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + i)));
+        __m256i quotient = _mm256_srli_epi32(_mm256_mullo_epi32(label, divideBy3), 17);
+        __m256i remainder = _mm256_sub_epi32(label, _mm256_mullo_epi32(quotient, three));
+
+        __m256i bg = _mm256_cmpeq_epi32(label, zero);
+        __m256i user = _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi32(remainder, zero), palette0),
+                                       _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi32(remainder, one), palette1),
+                                                       _mm256_and_si256(_mm256_cmpeq_epi32(remainder, two), palette2)));
+        __m256i mask = _mm256_or_si256(_mm256_and_si256(bg, background), _mm256_andnot_si256(bg, user));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_or_si256(opaque, _mm256_and_si256(g, mask)));
+    }
+
+    colorizeScalar(depth + i, labels + i, lut, out + i, count - i);
+}
+
+#endif // QNITE_X86_SIMD
+
+typedef void (*ColorizeFunction)(const quint16 *, const qint16 *, const quint8 *, quint32 *, int);
+
+struct ColorizeKernel
+{
+    ColorizeFunction function;
+    const char * name;
+    int features;
+};
+
+static const ColorizeKernel s_colorizeKernels[] = {
+#ifdef QNITE_X86_SIMD
+    { colorizeAVX2, "avx2", QNiTECpuAVX2 },
+    { colorizeSSE2, "sse2", QNiTECpuSSE2 },
+#endif
+    { colorizeScalar, "scalar", 0 }
+};
+
+void qniteColorizeDepth(const quint16 * depth, const qint16 * labels, const quint8 * lut, quint32 * out, int count)
+{
+    qniteSelectKernel(s_colorizeKernels).function(depth, labels, lut, out, count);
+}
+
+const char * qniteColorizeImplementation()
+{
+    return qniteSelectKernel(s_colorizeKernels).name;
+}
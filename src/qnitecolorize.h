@@ -0,0 +1,24 @@
+#ifndef QNITECOLORIZE_H
+#define QNITECOLORIZE_H
+
+#include <QtGlobal>
+
+// depth LUT covers every 16 bit depth value, plus padding for 32 bit gathers
+#define QNITE_DEPTH_LUT_SIZE (65536 + 4)
+
+/*
+ * Maps one row of depth pixels and NiTE user labels to opaque RGB32 (0xffRRGGBB).
+ *
+ * The intensity comes from an 8 bit depth LUT of QNITE_DEPTH_LUT_SIZE entries,
+ * whose first entry must be zero so that invalid depth comes out black. Background
+ * pixels (label 0) are gray, users cycle through red, green and blue by id.
+ *
+ * AVX2 and SSE2 variants are used where the CPU has them (see qnitecpu.h), and
+ * tests/auto/colorize holds them to the original float loop byte for byte.
+ */
+void qniteColorizeDepth(const quint16 * depth, const qint16 * labels, const quint8 * lut, quint32 * out, int count);
+
+// which of "avx2", "sse2" and "scalar" qniteColorizeDepth() runs
+const char * qniteColorizeImplementation();
+
+#endif // QNITECOLORIZE_H
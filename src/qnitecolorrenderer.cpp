@@ -1,12 +1,17 @@
 #include "qnitecolorrenderer.h"
 #include "qnite.h"
-#include <QPainter>
-#include <QImage>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
 
-QNiTEColorRenderer::QNiTEColorRenderer(QQuickItem *parent) : QQuickPaintedItem(parent)
+QNiTEColorRenderer::QNiTEColorRenderer(QQuickItem *parent) : QQuickItem(parent)
 {
+    m_kinect = 0;
+    m_qnite = 0;
+
     m_initialized = false;
+    m_frameDirty = false;
 
+    setFlag(ItemHasContents, true);
 }
 
 QNiTEColorRenderer::~QNiTEColorRenderer()
@@ -14,25 +19,65 @@ QNiTEColorRenderer::~QNiTEColorRenderer()
 
 }
 
-void QNiTEColorRenderer::paint(QPainter * painter)
+QSGNode * QNiTEColorRenderer::updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *)
 {
-    if(!m_initialized) return;
+    QSGSimpleTextureNode * node = static_cast<QSGSimpleTextureNode *>(oldNode);
 
-    m_qnite->lockRGBFrameRef();
-    openni::VideoFrameRef & frame = m_qnite->m_rgbFrameRef;
+    if(!m_initialized)
+    {
+        delete node;
+        return 0;
+    }
 
-    if(!frame.isValid())
+    if(m_frameDirty)
     {
-        m_qnite->unlockRGBFrameRef();
-        return;
+        m_frameDirty = false;
+
+        // scaled down to what is on screen, and shared with every other renderer
+        // of the same QNiTE and size
+        const QSize size = (boundingRect().size() * window()->devicePixelRatio()).toSize();
+        const QImage frameImage = m_qnite->colorImage(size);
+
+        if(!frameImage.isNull())
+        {
+            if(!node)
+            {
+                node = new QSGSimpleTextureNode();
+                node->setOwnsTexture(true);
+                node->setFiltering(QSGTexture::Linear);
+            }
+
+            node->setTexture(window()->createTextureFromImage(frameImage));
+        }
     }
 
-    QImage frameImage((const uchar *)frame.getData(), frame.getWidth(), frame.getHeight(), QImage::Format_RGB888);
+    if(node)
+        node->setRect(boundingRect());
+
+    return node;
+}
+
+// the texture is scaled to the item, so a new size needs a new one even without a new frame
+void QNiTEColorRenderer::geometryChanged(const QRectF & newGeometry, const QRectF & oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
 
+    if(newGeometry.size() != oldGeometry.size())
+    {
+        m_frameDirty = true;
+        update();
+    }
+}
 
-    painter->drawImage(QRect(0, 0, width(), height()), frameImage);
+void QNiTEColorRenderer::itemChange(ItemChange change, const ItemChangeData & value)
+{
+    QQuickItem::itemChange(change, value);
 
-    m_qnite->unlockRGBFrameRef();
+    if(change == ItemDevicePixelRatioHasChanged || (change == ItemSceneChange && value.window))
+    {
+        m_frameDirty = true;
+        update();
+    }
 }
 
 void QNiTEColorRenderer::initialize()
@@ -49,6 +94,6 @@ void QNiTEColorRenderer::initialize()
 
 void QNiTEColorRenderer::onNewFrame()
 {
+    m_frameDirty = true;
     update();
 }
-
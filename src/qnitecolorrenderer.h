@@ -1,14 +1,11 @@
 #ifndef QNITECOLORRENDERER_H
 #define QNITECOLORRENDERER_H
 
-#include <QQuickPaintedItem>
-
-#include <OpenNI.h>
-#include <NiTE.h>
+#include <QQuickItem>
 
 class QNiTE;
 
-class QNiTEColorRenderer : public QQuickPaintedItem
+class QNiTEColorRenderer : public QQuickItem
 {
     Q_OBJECT
     Q_PROPERTY(QObject* kinect READ kinect WRITE setKinect NOTIFY kinectChanged)
@@ -18,8 +15,6 @@ public:
     QNiTEColorRenderer(QQuickItem * parent = 0);
     ~QNiTEColorRenderer();
 
-    virtual void paint( QPainter * );
-
     QObject* kinect() const
     {
         return m_kinect;
@@ -51,11 +46,17 @@ void initialize();
 
 void onNewFrame();
 
+protected:
+virtual QSGNode * updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *);
+virtual void geometryChanged(const QRectF & newGeometry, const QRectF & oldGeometry);
+virtual void itemChange(ItemChange change, const ItemChangeData & value);
+
 private:
 QObject* m_kinect;
 QNiTE *m_qnite;
 
 bool m_initialized;
+bool m_frameDirty;
 
 
 };
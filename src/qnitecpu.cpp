@@ -0,0 +1,39 @@
+#include "qnitecpu.h"
+
+#include <QAtomicInt>
+
+static QAtomicInt s_featureMask(QNiTECpuAllFeatures);
+
+static int detectCpuFeatures()
+{
+    int features = 0;
+
+#ifdef QNITE_X86_SIMD
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2"))
+        features |= QNiTECpuSSE2;
+    if (__builtin_cpu_supports("ssse3"))
+        features |= QNiTECpuSSSE3;
+    if (__builtin_cpu_supports("avx2"))
+        features |= QNiTECpuAVX2;
+#endif
+
+    return features;
+}
+
+int qniteCpuFeatures()
+{
+    static const int detected = detectCpuFeatures();
+    return detected & s_featureMask.loadAcquire();
+}
+
+int qniteCpuFeatureMask()
+{
+    return s_featureMask.loadAcquire();
+}
+
+void qniteSetCpuFeatureMask(int mask)
+{
+    s_featureMask.storeRelease(mask & QNiTECpuAllFeatures);
+}
@@ -0,0 +1,54 @@
+#ifndef QNITECPU_H
+#define QNITECPU_H
+
+#include <QtGlobal>
+
+/*
+ * Runtime CPU dispatch for the SIMD kernels.
+ *
+ * Kernel files put their x86 variants under QNITE_X86_SIMD, each compiled for its
+ * instruction set with __attribute__((target(...))), and list all of them in a
+ * table of structs with a name and the QNiTECpuFeatures they need. Tables go best
+ * first and end with the scalar variant, which needs nothing; qniteSelectKernel()
+ * returns the first one this CPU runs.
+ *
+ * qniteSetCpuFeatureMask() hides features from the selection, which is how the
+ * tests run every variant on one machine and compare it with the scalar one.
+ */
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define QNITE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+enum QNiTECpuFeature
+{
+    QNiTECpuSSE2 = 0x1,
+    QNiTECpuSSSE3 = 0x2,
+    QNiTECpuAVX2 = 0x4,
+
+    QNiTECpuAllFeatures = QNiTECpuSSE2 | QNiTECpuSSSE3 | QNiTECpuAVX2
+};
+
+// the features this CPU has, detected once, less those the mask hides
+int qniteCpuFeatures();
+
+// QNiTECpuAllFeatures unless changed; 0 leaves every kernel scalar
+int qniteCpuFeatureMask();
+void qniteSetCpuFeatureMask(int mask);
+
+template <typename Kernel, int Count>
+inline const Kernel & qniteSelectKernel(const Kernel (&kernels)[Count])
+{
+    const int features = qniteCpuFeatures();
+
+    for (int i = 0; i < Count - 1; ++i)
+    {
+        if ((kernels[i].features & features) == kernels[i].features)
+            return kernels[i];
+    }
+
+    return kernels[Count - 1];
+}
+
+#endif // QNITECPU_H
@@ -0,0 +1,91 @@
+#include "qnitedepthhistogram.h"
+
+#include <string.h>
+
+QNiTEDepthHistogram::QNiTEDepthHistogram()
+{
+    m_subsample = 1;
+    m_refreshInterval = 1;
+    m_blend = 256;
+
+    m_valid = false;
+    m_framesSinceRefresh = 0;
+
+    memset(m_counts, 0, sizeof(m_counts));
+    memset(m_blended, 0, sizeof(m_blended));
+    memset(m_lut, 0, sizeof(m_lut));
+}
+
+void QNiTEDepthHistogram::setSubsample(int step)
+{
+    m_subsample = qMax(1, step);
+}
+
+void QNiTEDepthHistogram::setRefreshInterval(int frames)
+{
+    m_refreshInterval = qMax(0, frames);
+}
+
+void QNiTEDepthHistogram::setBlend(qreal weight)
+{
+    m_blend = qBound(1, qRound(weight * 256), 256);
+}
+
+void QNiTEDepthHistogram::invalidate()
+{
+    m_valid = false;
+}
+
+bool QNiTEDepthHistogram::update(const quint16 * depth, int width, int height, int strideInBytes)
+{
+    if (m_valid)
+    {
+        if (m_refreshInterval == 0 || ++m_framesSinceRefresh < m_refreshInterval)
+            return false;
+    }
+
+    m_framesSinceRefresh = 0;
+
+    memset(m_counts, 0, sizeof(m_counts));
+
+    const int rowStep = (strideInBytes / sizeof(quint16)) * m_subsample;
+    quint32 points = 0;
+
+    for (int y = 0; y < height; y += m_subsample, depth += rowStep)
+    {
+        for (int x = 0; x < width; x += m_subsample)
+        {
+            const quint16 d = depth[x];
+            if (d != 0 && d < MAX_DEPTH)
+            {
+                m_counts[d]++;
+                points++;
+            }
+        }
+    }
+
+    if (!points)
+        return false;
+
+    // prefix sum and normalization in a single pass: 256 * (1 - cumulative / points)
+    const bool blending = m_valid && m_blend < 256;
+    quint64 cumulative = 0;
+
+    for (int i = 1; i < MAX_DEPTH; ++i)
+    {
+        cumulative += m_counts[i];
+
+        // depths below the first sampled one would map to 256 when subsampling
+        quint32 fresh = qMin<quint64>(255, ((points - cumulative) << 8) / points) << 8;
+
+        if (blending)
+            m_blended[i] = (m_blended[i] * (256 - m_blend) + fresh * m_blend) >> 8;
+        else
+            m_blended[i] = fresh;
+
+        m_lut[i] = m_blended[i] >> 8;
+    }
+
+    m_valid = true;
+    return true;
+}
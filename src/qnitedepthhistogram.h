@@ -0,0 +1,71 @@
+#ifndef QNITEDEPTHHISTOGRAM_H
+#define QNITEDEPTHHISTOGRAM_H
+
+#include <QtGlobal>
+
+#include "qnitecolorize.h"
+
+// depths from here on are left out of the histogram
+#define MAX_DEPTH 10000
+
+/*
+ * Cumulative depth histogram used to spread depth over the 8 bit intensity range.
+ *
+ * Counts are integer, the frame can be subsampled every Nth row and column, and
+ * the histogram is only rebuilt every refreshInterval frames (0 rebuilds it once
+ * and keeps it). A blend weight below 1 mixes each rebuilt histogram into the
+ * previous one instead of replacing it, so intensities drift smoothly.
+ *
+ * The result is an 8 bit LUT laid out for qniteColorizeDepth().
+ */
+class QNiTEDepthHistogram
+{
+public:
+    QNiTEDepthHistogram();
+
+    int subsample() const
+    {
+        return m_subsample;
+    }
+
+    int refreshInterval() const
+    {
+        return m_refreshInterval;
+    }
+
+    qreal blend() const
+    {
+        return m_blend / 256.0;
+    }
+
+    void setSubsample(int step);
+    void setRefreshInterval(int frames);
+    void setBlend(qreal weight);
+
+    // forces a full rebuild on the next update
+    void invalidate();
+
+    // returns true if the LUT was rebuilt from this frame
+    bool update(const quint16 * depth, int width, int height, int strideInBytes);
+
+    const quint8 * lut() const
+    {
+        return m_lut;
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTEDepthHistogram)
+
+    int m_subsample;
+    int m_refreshInterval;
+    int m_blend; // 0..256
+
+    bool m_valid;
+    int m_framesSinceRefresh;
+
+    quint32 m_counts[MAX_DEPTH];
+    quint16 m_blended[MAX_DEPTH]; // 8.8 fixed point intensities
+    quint8 m_lut[QNITE_DEPTH_LUT_SIZE];
+};
+
+#endif // QNITEDEPTHHISTOGRAM_H
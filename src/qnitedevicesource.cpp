@@ -0,0 +1,392 @@
+#include "qnitedevicesource.h"
+
+// OpenNI and NiTE are process-wide; every open source holds a reference
+static int s_runtimeUsers = 0;
+
+static bool acquireRuntime(QString * error)
+{
+    if (s_runtimeUsers == 0)
+    {
+        if (openni::OpenNI::initialize() != openni::STATUS_OK)
+        {
+            *error = QString("Failed to initialize OpenNI: %1").arg(openni::OpenNI::getExtendedError());
+            return false;
+        }
+
+        if (nite::NiTE::initialize() != nite::STATUS_OK)
+        {
+            *error = QString("Failed to initialize NiTE");
+            openni::OpenNI::shutdown();
+            return false;
+        }
+    }
+
+    s_runtimeUsers++;
+    return true;
+}
+
+static void releaseRuntime()
+{
+    if (--s_runtimeUsers == 0)
+    {
+        nite::NiTE::shutdown();
+        openni::OpenNI::shutdown();
+    }
+}
+
+class QNiTEDeviceTrackerStorage : public QNiTEFrameStorage
+{
+public:
+    nite::UserTrackerFrameRef trackerFrame;
+    openni::VideoFrameRef depthFrame;
+};
+
+class QNiTEDeviceColorStorage : public QNiTEFrameStorage
+{
+public:
+    openni::VideoFrameRef frame;
+};
+
+static inline QVector3D toVector(const nite::Point3f & p)
+{
+    return QVector3D(p.x, p.y, p.z);
+}
+
+static openni::PixelFormat toOpenNI(QNiTEColorFrame::PixelFormat format)
+{
+    switch (format)
+    {
+    case QNiTEColorFrame::YUV422: return openni::PIXEL_FORMAT_YUV422;
+    case QNiTEColorFrame::YUYV: return openni::PIXEL_FORMAT_YUYV;
+    case QNiTEColorFrame::Gray8: return openni::PIXEL_FORMAT_GRAY8;
+    default: return openni::PIXEL_FORMAT_RGB888;
+    }
+}
+
+static bool fromOpenNI(openni::PixelFormat format, QNiTEColorFrame::PixelFormat * out)
+{
+    switch (format)
+    {
+    case openni::PIXEL_FORMAT_RGB888: *out = QNiTEColorFrame::RGB888; return true;
+    case openni::PIXEL_FORMAT_YUV422: *out = QNiTEColorFrame::YUV422; return true;
+    case openni::PIXEL_FORMAT_YUYV: *out = QNiTEColorFrame::YUYV; return true;
+    case openni::PIXEL_FORMAT_GRAY8: *out = QNiTEColorFrame::Gray8; return true;
+    default: return false;
+    }
+}
+
+// switches stream to the first supported mode matching what was asked; NiTE only tracks 1 mm depth
+static void applyVideoMode(openni::VideoStream * stream, const QNiTEVideoMode & wanted, bool color)
+{
+    if (!wanted.width && !wanted.height && !wanted.fps && (!color || wanted.pixelFormat == QNiTEColorFrame::RGB888))
+        return;
+
+    const openni::PixelFormat format = color ? toOpenNI(wanted.pixelFormat) : openni::PIXEL_FORMAT_DEPTH_1_MM;
+    const openni::Array<openni::VideoMode> & modes = stream->getSensorInfo().getSupportedVideoModes();
+
+    for (int i = 0; i < modes.getSize(); ++i)
+    {
+        const openni::VideoMode & mode = modes[i];
+
+        if ((wanted.width && mode.getResolutionX() != wanted.width) ||
+            (wanted.height && mode.getResolutionY() != wanted.height) ||
+            (wanted.fps && mode.getFps() != wanted.fps) ||
+            mode.getPixelFormat() != format)
+            continue;
+
+        if (stream->setVideoMode(mode) != openni::STATUS_OK)
+            qDebug("[QNiTEDeviceSource] Failed to set video mode: %s", openni::OpenNI::getExtendedError());
+        return;
+    }
+
+    qDebug("[QNiTEDeviceSource] No %s mode of %dx%d at %d fps, keeping the default",
+           color ? "color" : "depth", wanted.width, wanted.height, wanted.fps);
+}
+
+QNiTEDeviceSource::QNiTEDeviceSource(const QString & uri)
+{
+    m_uri = uri;
+
+    m_device = 0;
+    m_rgbStream = 0;
+    m_depthStream = 0;
+    m_userTracker = 0;
+
+    m_colorEnabled = true;
+    m_runtimeInitialized = false;
+}
+
+QNiTEDeviceSource::~QNiTEDeviceSource()
+{
+    close();
+}
+
+bool QNiTEDeviceSource::open()
+{
+    if (m_device) return true;
+
+    if (!acquireRuntime(&m_errorString))
+        return false;
+
+    m_runtimeInitialized = true;
+
+    QByteArray uri = m_uri.toLocal8Bit();
+
+    m_device = new openni::Device();
+    openni::Status rc = m_device->open(m_uri.isEmpty() ? openni::ANY_DEVICE : uri.constData());
+    if (rc != openni::STATUS_OK)
+    {
+        m_errorString = QString("Failed to open device %1: %2").arg(m_uri, openni::OpenNI::getExtendedError());
+        close();
+        return false;
+    }
+
+    if (m_device->isFile())
+        m_device->getPlaybackControl()->setRepeatEnabled(true);
+    else
+        m_device->setDepthColorSyncEnabled(true);
+
+    // NiTE keeps its depth stream to itself; one of our own, never started, tells the field of view,
+    // and stays around for depthToColor()
+    m_depthStream = new openni::VideoStream();
+    if (m_depthStream->create(*m_device, openni::SENSOR_DEPTH) == openni::STATUS_OK)
+    {
+        // streams of a sensor share its mode, so NiTE's own stream picks this one up
+        applyVideoMode(m_depthStream, m_depthVideoMode, false);
+
+        m_depthIntrinsics.horizontalFov = m_depthStream->getHorizontalFieldOfView();
+        m_depthIntrinsics.verticalFov = m_depthStream->getVerticalFieldOfView();
+        m_depthIntrinsics.resolutionX = m_depthStream->getVideoMode().getResolutionX();
+        m_depthIntrinsics.resolutionY = m_depthStream->getVideoMode().getResolutionY();
+    }
+    else
+    {
+        delete m_depthStream;
+        m_depthStream = 0;
+    }
+
+    m_rgbStream = new openni::VideoStream();
+    if (m_rgbStream->create(*m_device, openni::SENSOR_COLOR) != openni::STATUS_OK)
+    {
+        // trackers work without color, so this is not fatal
+        qDebug("[QNiTEDeviceSource] Failed to initialize RGB camera: %s", openni::OpenNI::getExtendedError());
+        delete m_rgbStream;
+        m_rgbStream = 0;
+    }
+    else
+    {
+        applyVideoMode(m_rgbStream, m_colorVideoMode, true);
+
+        m_rgbStream->addNewFrameListener(this);
+
+        if (m_colorEnabled)
+            m_rgbStream->start();
+    }
+
+    m_userTracker = new nite::UserTracker();
+    if (m_userTracker->create(m_device) != nite::STATUS_OK)
+    {
+        m_errorString = QString("Failed to init user tracker");
+        close();
+        return false;
+    }
+
+    m_userTracker->addNewFrameListener(this);
+
+    return true;
+}
+
+void QNiTEDeviceSource::close()
+{
+    if (m_userTracker)
+    {
+        m_userTracker->removeNewFrameListener(this);
+        m_userTracker->destroy();
+        delete m_userTracker;
+        m_userTracker = 0;
+    }
+
+    if (m_rgbStream)
+    {
+        m_rgbStream->removeNewFrameListener(this);
+        m_rgbStream->stop();
+        m_rgbStream->destroy();
+        delete m_rgbStream;
+        m_rgbStream = 0;
+    }
+
+    if (m_depthStream)
+    {
+        m_depthStream->destroy();
+        delete m_depthStream;
+        m_depthStream = 0;
+    }
+
+    m_depthIntrinsics = QNiTEDepthIntrinsics();
+
+    if (m_device)
+    {
+        m_device->close();
+        delete m_device;
+        m_device = 0;
+    }
+
+    if (m_runtimeInitialized)
+    {
+        releaseRuntime();
+        m_runtimeInitialized = false;
+    }
+}
+
+void QNiTEDeviceSource::setColorEnabled(bool enabled)
+{
+    m_colorEnabled = enabled;
+
+    if (!m_rgbStream) return;
+
+    if (enabled)
+        m_rgbStream->start();
+    else
+        m_rgbStream->stop();
+}
+
+bool QNiTEDeviceSource::readTrackerFrame(QNiTETrackerFrame * frame)
+{
+    QSharedPointer<QNiTEDeviceTrackerStorage> storage(new QNiTEDeviceTrackerStorage());
+    nite::UserTrackerFrameRef & trackerFrame = storage->trackerFrame;
+
+    if (m_userTracker->readFrame(&trackerFrame) != nite::STATUS_OK || !trackerFrame.isValid())
+        return false;
+
+    storage->depthFrame = trackerFrame.getDepthFrame();
+    const openni::VideoFrameRef & depthFrame = storage->depthFrame;
+
+    frame->valid = true;
+    frame->frameIndex = trackerFrame.getFrameIndex();
+    frame->timestamp = trackerFrame.getTimestamp();
+
+    if (depthFrame.isValid())
+    {
+        frame->resolutionX = depthFrame.getVideoMode().getResolutionX();
+        frame->resolutionY = depthFrame.getVideoMode().getResolutionY();
+        frame->width = depthFrame.getWidth();
+        frame->height = depthFrame.getHeight();
+        frame->cropOriginX = depthFrame.getCropOriginX();
+        frame->cropOriginY = depthFrame.getCropOriginY();
+        frame->depthStride = depthFrame.getStrideInBytes();
+        frame->depth = (const quint16 *) depthFrame.getData();
+        frame->labels = trackerFrame.getUserMap().getPixels();
+    }
+    else
+    {
+        frame->resolutionX = frame->resolutionY = 0;
+        frame->width = frame->height = 0;
+        frame->cropOriginX = frame->cropOriginY = 0;
+        frame->depthStride = 0;
+        frame->depth = 0;
+        frame->labels = 0;
+    }
+
+    const nite::Array<nite::UserData>& users = trackerFrame.getUsers();
+    frame->users.resize(users.getSize());
+
+    for (int i = 0; i < users.getSize(); ++i)
+    {
+        const nite::UserData& user = users[i];
+        const nite::Skeleton& skeleton = user.getSkeleton();
+        QNiTEUserData & data = frame->users[i];
+
+        data.id = user.getId();
+        data.isNew = user.isNew();
+        data.isLost = user.isLost();
+        data.isVisible = user.isVisible();
+        data.skeletonTracked = skeleton.getState() == nite::SKELETON_TRACKED;
+
+        data.centerOfMass = toVector(user.getCenterOfMass());
+        data.boundingMin = toVector(user.getBoundingBox().min);
+        data.boundingMax = toVector(user.getBoundingBox().max);
+
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        {
+            const nite::SkeletonJoint & joint = skeleton.getJoint(static_cast<nite::JointType>(j));
+            data.joints[j].position = toVector(joint.getPosition());
+            data.joints[j].confidence = joint.getPositionConfidence();
+        }
+
+        if (user.isNew())
+            m_userTracker->startSkeletonTracking(user.getId());
+    }
+
+    const nite::Plane & ground = trackerFrame.getFloor();
+    frame->floorPoint = toVector(ground.point);
+    frame->floorNormal = toVector(ground.normal);
+    frame->floorConfidence = trackerFrame.getFloorConfidence();
+
+    frame->storage = storage;
+    return true;
+}
+
+bool QNiTEDeviceSource::readColorFrame(QNiTEColorFrame * frame)
+{
+    QSharedPointer<QNiTEDeviceColorStorage> storage(new QNiTEDeviceColorStorage());
+
+    if (m_rgbStream->readFrame(&storage->frame) != openni::STATUS_OK || !storage->frame.isValid())
+        return false;
+
+    const openni::VideoFrameRef & colorFrame = storage->frame;
+
+    if (!fromOpenNI(colorFrame.getVideoMode().getPixelFormat(), &frame->pixelFormat))
+        return false;
+
+    frame->valid = true;
+    frame->frameIndex = colorFrame.getFrameIndex();
+    frame->timestamp = colorFrame.getTimestamp();
+    frame->width = colorFrame.getWidth();
+    frame->height = colorFrame.getHeight();
+    frame->stride = colorFrame.getStrideInBytes();
+    frame->data = (const uchar *) colorFrame.getData();
+
+    frame->storage = storage;
+    return true;
+}
+
+QPointF QNiTEDeviceSource::toDepthSpace(const QVector3D & point) const
+{
+    if (!m_userTracker)
+        return QPointF();
+
+    float x = 0, y = 0;
+    m_userTracker->convertJointCoordinatesToDepth(point.x(), point.y(), point.z(), &x, &y);
+    return QPointF(x, y);
+}
+
+bool QNiTEDeviceSource::depthToColor(int x, int y, quint16 depth, QPointF * color) const
+{
+    if (!m_depthStream || !m_rgbStream)
+        return false;
+
+    int colorX = 0, colorY = 0;
+    if (openni::CoordinateConverter::convertDepthToColor(*m_depthStream, *m_rgbStream, x, y, depth, &colorX, &colorY) != openni::STATUS_OK)
+        return false;
+
+    *color = QPointF(colorX, colorY);
+    return true;
+}
+
+// user tracker frame
+void QNiTEDeviceSource::onNewFrame(nite::UserTracker & tracker)
+{
+    Q_UNUSED(tracker)
+
+    if (m_listener)
+        m_listener->onNewTrackerFrame(*this);
+}
+
+// rgb frame
+void QNiTEDeviceSource::onNewFrame(openni::VideoStream & stream)
+{
+    Q_UNUSED(stream)
+
+    if (m_listener)
+        m_listener->onNewColorFrame(*this);
+}
@@ -0,0 +1,43 @@
+#ifndef QNITEDEVICESOURCE_H
+#define QNITEDEVICESOURCE_H
+
+#include <OpenNI.h>
+#include <NiTE.h>
+
+#include "qniteframesource.h"
+
+// live OpenNI device, or a recorded .oni file played back through OpenNI
+class QNiTEDeviceSource : public QNiTEFrameSource, public nite::UserTracker::NewFrameListener, public openni::VideoStream::NewFrameListener
+{
+public:
+    // empty uri opens the first device
+    explicit QNiTEDeviceSource(const QString & uri = QString());
+    ~QNiTEDeviceSource();
+
+    virtual bool open();
+    virtual void close();
+
+    virtual void setColorEnabled(bool enabled);
+
+    virtual bool readTrackerFrame(QNiTETrackerFrame * frame);
+    virtual bool readColorFrame(QNiTEColorFrame * frame);
+
+    virtual QPointF toDepthSpace(const QVector3D & point) const;
+    virtual bool depthToColor(int x, int y, quint16 depth, QPointF * color) const;
+
+    virtual void onNewFrame(nite::UserTracker&);
+    virtual void onNewFrame(openni::VideoStream&);
+
+private:
+    QString m_uri;
+
+    openni::Device * m_device;
+    openni::VideoStream * m_rgbStream;
+    openni::VideoStream * m_depthStream; // never started, for its video mode
+    nite::UserTracker * m_userTracker;
+
+    bool m_colorEnabled;
+    bool m_runtimeInitialized;
+};
+
+#endif // QNITEDEVICESOURCE_H
@@ -0,0 +1,280 @@
+#ifndef QNITEFRAME_H
+#define QNITEFRAME_H
+
+#include <QExplicitlySharedDataPointer>
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QSharedData>
+#include <QSharedPointer>
+#include <QVarLengthArray>
+#include <QVector>
+#include <QVector3D>
+
+#define QNITE_JOINT_COUNT 15
+
+// the most users NiTE tracks at once on one sensor
+#define QNITE_MAX_USERS 15
+
+/*
+ * Frame data handed from a QNiTEFrameSource to QNiTE and the renderers.
+ *
+ * These types carry no NiTE/OpenNI handles. Pixel buffers are borrowed from
+ * whatever the source keeps in the frame's storage, so a copy of a frame keeps
+ * its buffers alive for as long as the copy exists.
+ */
+
+// keeps the buffers of a frame alive; sources subclass it with whatever they hold
+class QNiTEFrameStorage
+{
+public:
+    virtual ~QNiTEFrameStorage() {}
+};
+
+struct QNiTEJointData
+{
+    QNiTEJointData() : confidence(0) {}
+
+    QVector3D position; // world space, millimeters
+    float confidence;
+
+    QPointF projected; // depth image pixels; filled in by QNiTE's tracker worker in QNiTETrackerSnapshot::users
+};
+
+struct QNiTEUserData
+{
+    QNiTEUserData() : id(0), isNew(false), isLost(false), isVisible(false), skeletonTracked(false) {}
+
+    int id;
+    bool isNew;
+    bool isLost;
+    bool isVisible;
+    bool skeletonTracked;
+
+    QVector3D centerOfMass;
+    QVector3D boundingMin;
+    QVector3D boundingMax;
+
+    // indexed by QNiTEUser::Joint
+    QNiTEJointData joints[QNITE_JOINT_COUNT];
+};
+
+// what it takes to project world space points onto the depth image, see qniteprojection.h
+struct QNiTEDepthIntrinsics
+{
+    QNiTEDepthIntrinsics() : horizontalFov(0), verticalFov(0), resolutionX(0), resolutionY(0) {}
+
+    bool isValid() const
+    {
+        return horizontalFov > 0 && verticalFov > 0 && resolutionX > 0 && resolutionY > 0;
+    }
+
+    float horizontalFov; // radians
+    float verticalFov;   // radians
+    int resolutionX;
+    int resolutionY;
+};
+
+// when a tracker frame passed each pipeline stage, in qniteTimestampNs() nanoseconds; 0 if not reached
+struct QNiTEFrameTiming
+{
+    QNiTEFrameTiming() : sensorTimestamp(0), callbackEntry(0), processStart(0), processEnd(0), delivered(0), painted(0) {}
+
+    quint64 sensorTimestamp; // sensor clock, microseconds
+    qint64 callbackEntry;    // source callback entered, source thread
+    qint64 processStart;     // QNiTE::processNewFrame() picked the frame up
+    qint64 processEnd;       // users and floor updated, about to emit newTrackerFrame
+    qint64 delivered;        // newTrackerFrame returned from all direct (QML) handlers
+    qint64 painted;          // a renderer's frame showing it was swapped
+};
+
+struct QNiTETrackerFrame
+{
+    QNiTETrackerFrame() :
+        valid(false), frameIndex(0), timestamp(0),
+        resolutionX(0), resolutionY(0), width(0), height(0), cropOriginX(0), cropOriginY(0), depthStride(0),
+        depth(0), labels(0), floorConfidence(0)
+    {
+    }
+
+    bool isValid() const
+    {
+        return valid;
+    }
+
+    bool valid;
+    int frameIndex;
+    quint64 timestamp; // sensor clock, microseconds
+
+    // depth video mode, and the (possibly cropped) region actually delivered
+    int resolutionX;
+    int resolutionY;
+    int width;
+    int height;
+    int cropOriginX;
+    int cropOriginY;
+    int depthStride; // bytes
+
+    const quint16 * depth;
+    const qint16 * labels; // width * height user ids, tightly packed; may be null
+
+    QVector<QNiTEUserData> users;
+
+    QVector3D floorPoint;
+    QVector3D floorNormal;
+    float floorConfidence;
+
+    QNiTEFrameTiming timing;
+
+    QSharedPointer<QNiTEFrameStorage> storage;
+};
+
+// one point of a depth image in world space (mm), and the NiTE user it belongs to
+// (0 is background); see qnitepointcloud.h
+struct QNiTEPoint
+{
+    float x;
+    float y;
+    float z;
+    qint32 userId;
+};
+
+Q_STATIC_ASSERT(sizeof(QNiTEPoint) == 16);
+
+// a point cloud QNiTE's tracker worker generated; it keeps a few and reuses each
+// once no snapshot holds it anymore
+struct QNiTEPointCloudBuffer : public QSharedData
+{
+    QNiTEPointCloudBuffer() : count(0) {}
+
+    QVector<QNiTEPoint> points; // the first count are the cloud, the rest is spare room
+    int count;
+};
+
+// a horizontal span of one user's pixels, in depth image pixels
+struct QNiTEMaskRun
+{
+    quint16 y;
+    quint16 x;
+    quint16 length;
+};
+
+// one user's silhouette in a tracker frame, see qniteusermask.h
+struct QNiTEUserMask
+{
+    QNiTEUserMask() : userId(0), pixelCount(0), firstRun(0), runCount(0) {}
+
+    int userId;
+    int pixelCount;
+    QRect bounds; // tight, in depth image pixels
+
+    // the user's runs in QNiTETrackerSnapshot::maskRuns, ordered by row then column
+    int firstRun;
+    int runCount;
+};
+
+/*
+ * A tracker frame as QNiTE applies it on the GUI thread. QNiTETrackerWorker builds
+ * it off the GUI thread and nobody modifies it afterwards, so the GUI thread and
+ * the renderers share it by pointer.
+ */
+struct QNiTETrackerSnapshot
+{
+    QNiTETrackerSnapshot() : skeletonCount(0) {}
+
+    // as the source delivered it; captures, the publisher and the skeleton stream
+    // record these users, never filtered ones
+    QNiTETrackerFrame frame;
+
+    // frame.users after joint filtering and prediction, every joint projected; what
+    // QNiTEUser and the renderers show
+    QVector<QNiTEUserData> users;
+
+    int skeletonCount;
+
+    // what the joints' projected positions were computed with
+    QNiTEDepthIntrinsics intrinsics;
+
+    // parallel to users: the QNiTEUser::Change bits that differ from the same
+    // user in the previous snapshot, every bit for a user that was not in it
+    QVector<int> userChanges;
+
+    // the depth image as world space points, one cloud per QNiTE::addPointCloud() id;
+    // ids with equal settings share a buffer
+    struct PointCloud
+    {
+        int id;
+        QExplicitlySharedDataPointer<const QNiTEPointCloudBuffer> buffer;
+    };
+
+    QVarLengthArray<PointCloud, 4> pointClouds;
+
+    // null if id was not added yet when the frame was processed
+    const QNiTEPointCloudBuffer * pointCloud(int id) const
+    {
+        for (int i = 0; i < pointClouds.size(); ++i)
+        {
+            if (pointClouds[i].id == id)
+                return pointClouds[i].buffer.data();
+        }
+        return 0;
+    }
+
+    // every labelled user's silhouette, in no particular order, and all of their runs
+    QVector<QNiTEUserMask> userMasks;
+    QVector<QNiTEMaskRun> maskRuns;
+
+    // null if userId has no pixels in the frame
+    const QNiTEUserMask * userMask(int userId) const
+    {
+        for (int i = 0; i < userMasks.size(); ++i)
+        {
+            if (userMasks[i].userId == userId)
+                return &userMasks[i];
+        }
+        return 0;
+    }
+
+    const QNiTEMaskRun * runsOf(const QNiTEUserMask & mask) const
+    {
+        return maskRuns.constData() + mask.firstRun;
+    }
+};
+
+typedef QSharedPointer<const QNiTETrackerSnapshot> QNiTETrackerSnapshotPointer;
+
+struct QNiTEColorFrame
+{
+    // how the pixels are laid out; see qnitecolorconvert.h for turning them into RGB32
+    enum PixelFormat {
+        RGB888, // R, G, B
+        YUV422, // U, Y0, V, Y1 for every two pixels (UYVY), as OpenNI's PIXEL_FORMAT_YUV422
+        YUYV,   // Y0, U, Y1, V for every two pixels
+        Gray8
+    };
+
+    QNiTEColorFrame() :
+        valid(false), frameIndex(0), timestamp(0),
+        width(0), height(0), stride(0), pixelFormat(RGB888), data(0)
+    {
+    }
+
+    bool isValid() const
+    {
+        return valid;
+    }
+
+    bool valid;
+    int frameIndex;
+    quint64 timestamp; // sensor clock, microseconds
+
+    int width;
+    int height;
+    int stride; // bytes
+    PixelFormat pixelFormat;
+    const uchar * data;
+
+    QSharedPointer<QNiTEFrameStorage> storage;
+};
+
+#endif // QNITEFRAME_H
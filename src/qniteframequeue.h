@@ -0,0 +1,218 @@
+#ifndef QNITEFRAMEQUEUE_H
+#define QNITEFRAMEQUEUE_H
+
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "qnitetriplebuffer.h"
+
+/*
+ * Single-producer / single-consumer frame queue, with a policy for when the
+ * consumer falls behind:
+ *
+ *   LatestWins     one frame pending; a newer one replaces it (coalesced)
+ *   BoundedQueue   up to capacity frames pending; when full, the oldest is dropped
+ *   BlockProducer  up to capacity frames pending; when full, publish() waits
+ *
+ * Used like QNiTETripleBuffer: the producer fills back() and calls publish(), the
+ * consumer calls acquire() and reads front(). Frames are never copied. LatestWins
+ * is a QNiTETripleBuffer and never locks; the other policies lock to move slots
+ * around, and only for that. front() stays untouched by the producer until the
+ * consumer acquires again.
+ */
+template <typename T>
+class QNiTEFrameQueue
+{
+public:
+    enum Policy { LatestWins, BoundedQueue, BlockProducer };
+
+    struct Counters
+    {
+        Counters() : received(0), processed(0), dropped(0), coalesced(0) {}
+
+        quint64 received;
+        quint64 processed;
+        quint64 dropped;
+        quint64 coalesced;
+    };
+
+    explicit QNiTEFrameQueue(Policy policy = LatestWins, int capacity = 1) : m_aborted(false)
+    {
+        configure(policy, capacity);
+    }
+
+    // drops every slot and sets up new ones; only valid while the producer is stopped
+    void configure(Policy policy, int capacity)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_policy = policy;
+        m_capacity = policy == LatestWins ? 1 : qMax(1, capacity);
+        m_latest.reset();
+
+        // LatestWins keeps its frames in m_latest
+        m_slots = QVector<T>(policy == LatestWins ? 0 : m_capacity + 2);
+        m_front = 0;
+        m_back = 1;
+
+        m_pending.clear();
+        m_pending.reserve(m_capacity);
+        m_free.clear();
+        m_free.reserve(m_capacity + 2);
+        for (int i = 2; i < m_slots.size(); ++i)
+            m_free.append(i);
+    }
+
+    Policy policy() const
+    {
+        return m_policy;
+    }
+
+    int capacity() const
+    {
+        return m_capacity;
+    }
+
+    // producer side
+
+    T & back()
+    {
+        return m_policy == LatestWins ? m_latest.back() : m_slots[m_back];
+    }
+
+    // returns true if a pending frame was dropped or coalesced to make room
+    bool publish()
+    {
+        m_received.fetchAndAddRelaxed(1);
+
+        if (m_policy == LatestWins)
+        {
+            const bool coalesced = m_latest.publish();
+            if (coalesced)
+                m_coalesced.fetchAndAddRelaxed(1);
+            return coalesced;
+        }
+
+        QMutexLocker locker(&m_mutex);
+
+        if (m_policy == BlockProducer)
+        {
+            while (m_pending.size() >= m_capacity && !m_aborted)
+                m_notFull.wait(&m_mutex);
+        }
+
+        bool discarded = false;
+        if (m_pending.size() >= m_capacity)
+        {
+            m_free.append(m_pending.first());
+            m_pending.remove(0);
+
+            m_dropped.fetchAndAddRelaxed(1);
+            discarded = true;
+        }
+
+        m_pending.append(m_back);
+        m_back = m_free.last();
+        m_free.removeLast();
+
+        return discarded;
+    }
+
+    // wakes a producer blocked in publish(), and keeps it from blocking again
+    void abort()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_aborted = true;
+        m_notFull.wakeAll();
+    }
+
+    // consumer side
+
+    bool acquire()
+    {
+        if (m_policy == LatestWins)
+        {
+            if (!m_latest.acquire())
+                return false;
+
+            m_processed.fetchAndAddRelaxed(1);
+            return true;
+        }
+
+        QMutexLocker locker(&m_mutex);
+
+        if (m_pending.isEmpty())
+            return false;
+
+        m_free.append(m_front);
+        m_front = m_pending.first();
+        m_pending.remove(0);
+
+        m_processed.fetchAndAddRelaxed(1);
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    T & front()
+    {
+        return m_policy == LatestWins ? m_latest.front() : m_slots[m_front];
+    }
+
+    const T & front() const
+    {
+        return m_policy == LatestWins ? m_latest.front() : m_slots[m_front];
+    }
+
+    // each count on its own, so they may be a frame apart from one another
+    Counters counters() const
+    {
+        Counters counters;
+        counters.received = m_received.loadAcquire();
+        counters.processed = m_processed.loadAcquire();
+        counters.dropped = m_dropped.loadAcquire();
+        counters.coalesced = m_coalesced.loadAcquire();
+        return counters;
+    }
+
+    void resetCounters()
+    {
+        m_received.storeRelease(0);
+        m_processed.storeRelease(0);
+        m_dropped.storeRelease(0);
+        m_coalesced.storeRelease(0);
+    }
+
+    // drops every slot; only valid while the producer is stopped
+    void reset()
+    {
+        configure(m_policy, m_capacity);
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTEFrameQueue)
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_notFull;
+
+    Policy m_policy;
+    int m_capacity;
+    bool m_aborted;
+
+    QVector<T> m_slots;
+    int m_front;
+    int m_back;
+    QVector<int> m_pending; // oldest first
+    QVector<int> m_free;
+
+    QNiTETripleBuffer<T> m_latest;
+
+    QAtomicInteger<quint64> m_received;
+    QAtomicInteger<quint64> m_processed;
+    QAtomicInteger<quint64> m_dropped;
+    QAtomicInteger<quint64> m_coalesced;
+};
+
+#endif // QNITEFRAMEQUEUE_H
@@ -0,0 +1,22 @@
+#include "qniteframesource.h"
+
+#include <QUrl>
+#include <QUrlQuery>
+
+#include "qnitedevicesource.h"
+#include "qnitesyntheticsource.h"
+
+QNiTEFrameSource * QNiTEFrameSource::create(const QString & uri)
+{
+    if (uri.startsWith("synthetic:"))
+    {
+        QUrlQuery query(QUrl(uri).query());
+
+        int users = query.hasQueryItem("users") ? query.queryItemValue("users").toInt() : 2;
+        int fps = query.hasQueryItem("fps") ? query.queryItemValue("fps").toInt() : 30;
+
+        return new QNiTESyntheticSource(users, fps);
+    }
+
+    return new QNiTEDeviceSource(uri);
+}
@@ -0,0 +1,121 @@
+#ifndef QNITEFRAMESOURCE_H
+#define QNITEFRAMESOURCE_H
+
+#include <QPointF>
+#include <QString>
+#include <QVector3D>
+
+#include "qniteframe.h"
+
+// the video mode asked of a stream; zeros keep the sensor's default
+struct QNiTEVideoMode
+{
+    QNiTEVideoMode() : width(0), height(0), fps(0), pixelFormat(QNiTEColorFrame::RGB888) {}
+
+    int width;
+    int height;
+    int fps;
+    QNiTEColorFrame::PixelFormat pixelFormat; // color streams only
+};
+
+/*
+ * Where QNiTE gets its frames from.
+ *
+ * Modeled after the NiTE/OpenNI listener pattern: a source notifies its listener
+ * from its own thread, and the listener reads the frame from inside the callback.
+ *
+ * URIs understood by create():
+ *   ""                                  first OpenNI device
+ *   "synthetic://?users=N&fps=F"        deterministic generator, no hardware
+ *   anything else                       OpenNI device URI or recorded .oni file
+ */
+class QNiTEFrameSource
+{
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        virtual void onNewTrackerFrame(QNiTEFrameSource & source) = 0;
+        virtual void onNewColorFrame(QNiTEFrameSource & source) = 0;
+    };
+
+    QNiTEFrameSource() : m_listener(0) {}
+    virtual ~QNiTEFrameSource() {}
+
+    static QNiTEFrameSource * create(const QString & uri);
+
+    // must be set before open()
+    void setListener(Listener * listener)
+    {
+        m_listener = listener;
+    }
+
+    // both must be set before open(); sources without a matching mode keep their default one
+    virtual void setColorVideoMode(const QNiTEVideoMode & mode)
+    {
+        m_colorVideoMode = mode;
+    }
+
+    virtual void setDepthVideoMode(const QNiTEVideoMode & mode)
+    {
+        m_depthVideoMode = mode;
+    }
+
+    QNiTEVideoMode colorVideoMode() const
+    {
+        return m_colorVideoMode;
+    }
+
+    QNiTEVideoMode depthVideoMode() const
+    {
+        return m_depthVideoMode;
+    }
+
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+    // valid once open() succeeded
+    QNiTEDepthIntrinsics depthIntrinsics() const
+    {
+        return m_depthIntrinsics;
+    }
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    virtual void setColorEnabled(bool enabled) = 0;
+
+    // only valid from inside the matching listener callback
+    virtual bool readTrackerFrame(QNiTETrackerFrame * frame) = 0;
+    virtual bool readColorFrame(QNiTEColorFrame * frame) = 0;
+
+    // world space joint position (mm) to depth image coordinates
+    virtual QPointF toDepthSpace(const QVector3D & point) const = 0;
+
+    // color image pixel that depth image pixel (x, y) shows up on at that depth (mm);
+    // false if the source cannot tell. Slow, see QNiTERegistrationTable for whole frames
+    virtual bool depthToColor(int x, int y, quint16 depth, QPointF * color) const
+    {
+        Q_UNUSED(x) Q_UNUSED(y) Q_UNUSED(depth) Q_UNUSED(color)
+        return false;
+    }
+
+    // how many users a frame can hold at most
+    virtual int maxUsers() const
+    {
+        return QNITE_MAX_USERS;
+    }
+
+protected:
+    Listener * m_listener;
+    QString m_errorString;
+    QNiTEDepthIntrinsics m_depthIntrinsics;
+    QNiTEVideoMode m_colorVideoMode;
+    QNiTEVideoMode m_depthVideoMode;
+};
+
+#endif // QNITEFRAMESOURCE_H
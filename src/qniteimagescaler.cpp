@@ -0,0 +1,218 @@
+#include "qniteimagescaler.h"
+
+#include <algorithm>
+
+#include "qnitecpu.h"
+
+// sums[i] += row[i], for count bytes
+static void addRowScalar(const uchar * row, quint16 * sums, int count)
+{
+    for (int i = 0; i < count; ++i)
+        sums[i] += row[i];
+}
+
+// out = (a * (128 - weight) + b * weight + 64) >> 7, for count bytes
+static void blendRowsScalar(const uchar * a, const uchar * b, int weight, uchar * out, int count)
+{
+    for (int i = 0; i < count; ++i)
+        out[i] = uchar((a[i] * (128 - weight) + b[i] * weight + 64) >> 7);
+}
+
+#ifdef QNITE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void addRowSSE2(const uchar * row, quint16 * sums, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i * s = reinterpret_cast<__m128i *>(sums + i);
+
+        _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), _mm_unpacklo_epi8(bytes, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), _mm_unpackhi_epi8(bytes, zero)));
+    }
+
+    addRowScalar(row + i, sums + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void blendRowsSSE2(const uchar * a, const uchar * b, int weight, uchar * out, int count)
+{
+    // 255 * 128 + 64 still fits in 16 bits
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16(short(128 - weight));
+    const __m128i wb = _mm_set1_epi16(short(weight));
+    const __m128i rounding = _mm_set1_epi16(64);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+
+        const __m128i low = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                                                       _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb)), rounding), 7);
+        const __m128i high = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                                                        _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb)), rounding), 7);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(low, high));
+    }
+
+    blendRowsScalar(a + i, b + i, weight, out + i, count - i);
+}
+
+#endif // QNITE_X86_SIMD
+
+struct ScaleKernels
+{
+    void (*addRow)(const uchar *, quint16 *, int);
+    void (*blendRows)(const uchar *, const uchar *, int, uchar *, int);
+    const char * name;
+    int features;
+};
+
+static const ScaleKernels s_scaleKernels[] = {
+#ifdef QNITE_X86_SIMD
+    { addRowSSE2, blendRowsSSE2, "sse2", QNiTECpuSSE2 },
+#endif
+    { addRowScalar, blendRowsScalar, "scalar", 0 }
+};
+
+// the same blend as blendRows, two channels at a time in the halves of a word
+static inline quint32 blendPixels(quint32 a, quint32 b, quint32 weight)
+{
+    const quint32 rb = ((a & 0x00ff00ff) * (128 - weight) + (b & 0x00ff00ff) * weight + 0x00400040) >> 7;
+    const quint32 ga = (((a >> 8) & 0x00ff00ff) * (128 - weight) + ((b >> 8) & 0x00ff00ff) * weight + 0x00400040) >> 7;
+
+    return (rb & 0x00ff00ff) | ((ga & 0x00ff00ff) << 8);
+}
+
+// pixel centers of out mapped onto in, as source index << 7 | weight of the next one
+static inline qint32 samplePosition(int i, int inSize, int outSize)
+{
+    const qint64 center = ((2 * qint64(i) + 1) * inSize * 128) / (2 * outSize) - 64;
+    return qint32(qBound(qint64(0), center, qint64(inSize - 1) * 128));
+}
+
+QNiTEImageScaler::QNiTEImageScaler()
+{
+}
+
+void QNiTEImageScaler::scale(const quint32 * in, int inWidth, int inHeight, int inStride,
+                             quint32 * out, int outWidth, int outHeight, int outStride)
+{
+    if (inWidth <= 0 || inHeight <= 0 || outWidth <= 0 || outHeight <= 0)
+        return;
+
+    // row sums are 16 bit, so at most 257 rows of 255
+    const int factor = qMin(256, qMin(inWidth / outWidth, inHeight / outHeight));
+
+    if (factor < 2)
+    {
+        bilinear(in, inWidth, inHeight, inStride, out, outWidth, outHeight, outStride);
+        return;
+    }
+
+    const int boxedWidth = inWidth / factor, boxedHeight = inHeight / factor;
+
+    if (boxedWidth == outWidth && boxedHeight == outHeight)
+    {
+        box(in, inStride, out, outWidth, outHeight, outStride, factor);
+        return;
+    }
+
+    if (m_boxed.size() < boxedWidth * boxedHeight)
+        m_boxed.resize(boxedWidth * boxedHeight);
+
+    box(in, inStride, m_boxed.data(), boxedWidth, boxedHeight, boxedWidth * sizeof(quint32), factor);
+    bilinear(m_boxed.constData(), boxedWidth, boxedHeight, boxedWidth * sizeof(quint32), out, outWidth, outHeight, outStride);
+}
+
+void QNiTEImageScaler::box(const quint32 * in, int inStride, quint32 * out, int outWidth, int outHeight, int outStride, int factor)
+{
+    const ScaleKernels & kernels = qniteSelectKernel(s_scaleKernels);
+
+    const int channels = outWidth * factor * 4;
+    if (m_sums.size() < channels)
+        m_sums.resize(channels);
+
+    // a sum of up to 255 * 65536 times this still fits in 32 bits
+    const quint32 inverse = (65536 + factor * factor / 2) / (factor * factor);
+
+    for (int y = 0; y < outHeight; ++y)
+    {
+        quint16 * sums = m_sums.data();
+        std::fill(sums, sums + channels, quint16(0));
+
+        const uchar * row = reinterpret_cast<const uchar *>(in) + qint64(y) * factor * inStride;
+        for (int r = 0; r < factor; ++r, row += inStride)
+            kernels.addRow(row, sums, channels);
+
+        quint32 * target = reinterpret_cast<quint32 *>(reinterpret_cast<uchar *>(out) + qint64(y) * outStride);
+
+        for (int x = 0; x < outWidth; ++x, sums += factor * 4)
+        {
+            quint32 pixel = 0;
+
+            for (int c = 0; c < 4; ++c)
+            {
+                quint32 sum = 0;
+                for (int i = c; i < factor * 4; i += 4)
+                    sum += sums[i];
+
+                pixel |= qMin(255u, (sum * inverse + 32768) >> 16) << (8 * c);
+            }
+
+            target[x] = pixel;
+        }
+    }
+}
+
+void QNiTEImageScaler::bilinear(const quint32 * in, int inWidth, int inHeight, int inStride,
+                                quint32 * out, int outWidth, int outHeight, int outStride)
+{
+    const ScaleKernels & kernels = qniteSelectKernel(s_scaleKernels);
+
+    if (m_columns.size() < outWidth)
+        m_columns.resize(outWidth);
+    if (m_blended.size() < inWidth)
+        m_blended.resize(inWidth);
+
+    qint32 * columns = m_columns.data();
+    for (int x = 0; x < outWidth; ++x)
+        columns[x] = samplePosition(x, inWidth, outWidth);
+
+    const uchar * base = reinterpret_cast<const uchar *>(in);
+
+    for (int y = 0; y < outHeight; ++y)
+    {
+        const qint32 position = samplePosition(y, inHeight, outHeight);
+        const int sourceRow = position >> 7, rowWeight = position & 127;
+
+        const quint32 * row = reinterpret_cast<const quint32 *>(base + qint64(sourceRow) * inStride);
+
+        // the last row only ever gets weight 0, so never reads past the image
+        if (rowWeight)
+        {
+            kernels.blendRows(reinterpret_cast<const uchar *>(row), reinterpret_cast<const uchar *>(row) + inStride,
+                              rowWeight, reinterpret_cast<uchar *>(m_blended.data()), inWidth * 4);
+            row = m_blended.constData();
+        }
+
+        quint32 * target = reinterpret_cast<quint32 *>(reinterpret_cast<uchar *>(out) + qint64(y) * outStride);
+
+        for (int x = 0; x < outWidth; ++x)
+        {
+            const int column = columns[x] >> 7, weight = columns[x] & 127;
+            target[x] = weight ? blendPixels(row[column], row[column + 1], weight) : row[column];
+        }
+    }
+}
+
+const char * qniteImageScaleImplementation()
+{
+    return qniteSelectKernel(s_scaleKernels).name;
+}
@@ -0,0 +1,38 @@
+#ifndef QNITEIMAGESCALER_H
+#define QNITEIMAGESCALER_H
+
+#include <QVector>
+
+/*
+ * Scales 32 bit images (RGB32, or any four 8 bit channels) to any size.
+ *
+ * Shrinking by two or more first averages whole k x k blocks, which is all it
+ * takes when the target is an integer fraction of the source, like most
+ * thumbnails. Whatever is left over is bilinear, with 7 bit weights; columns and
+ * rows the blocks do not fit in are dropped. The row sums and blends use SSE2
+ * where available, and the buffers only grow and are reused.
+ */
+class QNiTEImageScaler
+{
+public:
+    QNiTEImageScaler();
+
+    // strides in bytes
+    void scale(const quint32 * in, int inWidth, int inHeight, int inStride,
+               quint32 * out, int outWidth, int outHeight, int outStride);
+
+private:
+    void box(const quint32 * in, int inStride, quint32 * out, int outWidth, int outHeight, int outStride, int factor);
+    void bilinear(const quint32 * in, int inWidth, int inHeight, int inStride,
+                  quint32 * out, int outWidth, int outHeight, int outStride);
+
+    QVector<quint16> m_sums;    // one row of channel sums
+    QVector<quint32> m_boxed;
+    QVector<quint32> m_blended; // one row
+    QVector<qint32> m_columns;  // per output column, source column << 7 | weight
+};
+
+// whether the row sums and blends run as "sse2" or "scalar"
+const char * qniteImageScaleImplementation();
+
+#endif // QNITEIMAGESCALER_H
@@ -0,0 +1,148 @@
+#include "qnitejointfilter.h"
+
+#include <QtMath>
+
+// longer gaps between frames than this restart the filters, in microseconds
+static const quint64 s_maxGap = 500000;
+
+// velocity variance a Kalman filter starts with, (mm/s)^2
+static const float s_initialVelocityVariance = 1000.0f * 1000.0f;
+
+// One-Euro's exponential smoothing factor for a cutoff frequency
+static inline float smoothingFactor(float cutoff, float dt)
+{
+    const float tau = 1.0f / (2.0f * float(M_PI) * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+QNiTEJointFilter::QNiTEJointFilter()
+{
+    reset();
+}
+
+void QNiTEJointFilter::reset()
+{
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        m_joints[j].started = false;
+
+    m_timestamp = 0;
+    m_type = QNiTEJointFilterSettings::None;
+}
+
+void QNiTEJointFilter::startAxis(Axis & axis, float measured, const QNiTEJointFilterSettings & settings)
+{
+    axis.position = measured;
+    axis.velocity = 0;
+
+    axis.p00 = settings.measurementNoise * settings.measurementNoise;
+    axis.p01 = 0;
+    axis.p11 = s_initialVelocityVariance;
+}
+
+void QNiTEJointFilter::kalman(Axis & axis, float measured, float dt, const QNiTEJointFilterSettings & settings)
+{
+    const float q = settings.processNoise * settings.processNoise;
+    const float r = settings.measurementNoise * settings.measurementNoise;
+    const float dt2 = dt * dt;
+
+    // predict, constant velocity with white noise acceleration
+    axis.position += axis.velocity * dt;
+
+    const float p00 = axis.p00 + 2 * dt * axis.p01 + dt2 * axis.p11 + q * dt2 * dt2 / 4;
+    const float p01 = axis.p01 + dt * axis.p11 + q * dt2 * dt / 2;
+    const float p11 = axis.p11 + q * dt2;
+
+    // correct with the measured position
+    const float k0 = p00 / (p00 + r);
+    const float k1 = p01 / (p00 + r);
+    const float residual = measured - axis.position;
+
+    axis.position += k0 * residual;
+    axis.velocity += k1 * residual;
+
+    axis.p00 = (1 - k0) * p00;
+    axis.p01 = (1 - k0) * p01;
+    axis.p11 = p11 - k1 * p01;
+}
+
+void QNiTEJointFilter::apply(const QNiTEJointFilterSettings & settings, quint64 timestamp, QNiTEJointData * joints)
+{
+    if (!settings.isActive())
+    {
+        reset();
+        return;
+    }
+
+    const bool restart = m_timestamp == 0 || timestamp <= m_timestamp || timestamp - m_timestamp > s_maxGap
+            || settings.type != m_type;
+
+    if (restart)
+    {
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+            m_joints[j].started = false;
+    }
+
+    const float dt = restart ? 0 : float(timestamp - m_timestamp) / 1000000.0f;
+    const float horizon = settings.predictionMs / 1000.0f;
+
+    m_timestamp = timestamp;
+    m_type = settings.type;
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        QNiTEJointData & data = joints[j];
+        Joint & joint = m_joints[j];
+
+        if (data.confidence <= 0)
+        {
+            joint.started = false;
+            continue;
+        }
+
+        const float measured[3] = { data.position.x(), data.position.y(), data.position.z() };
+
+        if (!joint.started)
+        {
+            for (int a = 0; a < 3; ++a)
+                startAxis(joint.axes[a], measured[a], settings);
+
+            joint.started = true;
+        }
+        else if (settings.type == QNiTEJointFilterSettings::OneEuro)
+        {
+            const float derivativeFactor = smoothingFactor(settings.derivativeCutoff, dt);
+            float speed = 0;
+
+            for (int a = 0; a < 3; ++a)
+            {
+                Axis & axis = joint.axes[a];
+                axis.velocity += derivativeFactor * ((measured[a] - axis.position) / dt - axis.velocity);
+                speed += axis.velocity * axis.velocity;
+            }
+
+            // one cutoff for the whole joint, so it does not lag more along one axis than another
+            const float factor = smoothingFactor(settings.minCutoff + settings.beta * qSqrt(speed), dt);
+
+            for (int a = 0; a < 3; ++a)
+                joint.axes[a].position += factor * (measured[a] - joint.axes[a].position);
+        }
+        else if (settings.type == QNiTEJointFilterSettings::Kalman)
+        {
+            for (int a = 0; a < 3; ++a)
+                kalman(joint.axes[a], measured[a], dt, settings);
+        }
+        else
+        {
+            // prediction only, from the raw motion since the last frame
+            for (int a = 0; a < 3; ++a)
+            {
+                joint.axes[a].velocity = (measured[a] - joint.axes[a].position) / dt;
+                joint.axes[a].position = measured[a];
+            }
+        }
+
+        data.position = QVector3D(joint.axes[0].position + joint.axes[0].velocity * horizon,
+                                  joint.axes[1].position + joint.axes[1].velocity * horizon,
+                                  joint.axes[2].position + joint.axes[2].velocity * horizon);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef QNITEJOINTFILTER_H
+#define QNITEJOINTFILTER_H
+
+#include <QtGlobal>
+
+#include "qniteframe.h"
+
+struct QNiTEJointFilterSettings
+{
+    enum Type { None, OneEuro, Kalman };
+
+    QNiTEJointFilterSettings() :
+        type(None), minCutoff(1.0f), beta(0.005f), derivativeCutoff(1.0f),
+        processNoise(2000.0f), measurementNoise(15.0f), predictionMs(0)
+    {
+    }
+
+    bool isActive() const
+    {
+        return type != None || predictionMs > 0;
+    }
+
+    Type type;
+
+    // One-Euro: cutoff (Hz) at rest, its increase per mm/s of speed, and the cutoff
+    // (Hz) the speed itself is smoothed with
+    float minCutoff;
+    float beta;
+    float derivativeCutoff;
+
+    // Kalman, constant velocity: acceleration noise (mm/s^2) and measurement noise (mm)
+    float processNoise;
+    float measurementNoise;
+
+    // extrapolates joints this far ahead along their velocity; 0 disables
+    float predictionMs;
+};
+
+/*
+ * Smooths and optionally extrapolates the joints of one user, frame after frame.
+ *
+ * Every coordinate of every joint is filtered on its own, using the time between
+ * frames from their sensor timestamps. Joints without confidence are passed
+ * through and start over once they come back; so does everything after a gap of
+ * more than half a second.
+ */
+class QNiTEJointFilter
+{
+public:
+    QNiTEJointFilter();
+
+    void reset();
+
+    // filters joints (QNITE_JOINT_COUNT of them) in place; timestamp in microseconds
+    void apply(const QNiTEJointFilterSettings & settings, quint64 timestamp, QNiTEJointData * joints);
+
+private:
+    // filtered position and velocity of one coordinate, and the Kalman covariance
+    struct Axis
+    {
+        float position;
+        float velocity;
+        float p00, p01, p11;
+    };
+
+    struct Joint
+    {
+        Axis axes[3];
+        bool started;
+    };
+
+    static void startAxis(Axis & axis, float measured, const QNiTEJointFilterSettings & settings);
+    static void kalman(Axis & axis, float measured, float dt, const QNiTEJointFilterSettings & settings);
+
+    Joint m_joints[QNITE_JOINT_COUNT];
+    quint64 m_timestamp;
+    QNiTEJointFilterSettings::Type m_type;
+};
+
+#endif // QNITEJOINTFILTER_H
@@ -0,0 +1,211 @@
+#include "qnitelatency.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QtMath>
+
+#include <limits>
+#include <string.h>
+
+// at most this often, so QML bindings on the stats stay cheap
+static const qint64 s_updateIntervalNs = 250 * 1000000LL;
+
+static const char * const s_percentileKeys[] = { "p50", "p95", "p99" };
+static const qreal s_percentiles[] = { 0.50, 0.95, 0.99 };
+
+qint64 qniteTimestampNs()
+{
+    static QElapsedTimer clock;
+    static bool started = (clock.start(), true);
+    Q_UNUSED(started);
+
+    // never 0, which marks a stage as not reached
+    return clock.nsecsElapsed() + 1;
+}
+
+QNiTELatencyHistogram::QNiTELatencyHistogram()
+{
+    clear();
+}
+
+void QNiTELatencyHistogram::clear()
+{
+    memset(m_bins, 0, sizeof(m_bins));
+    memset(m_ring, 0, sizeof(m_ring));
+    m_next = 0;
+    m_count = 0;
+}
+
+void QNiTELatencyHistogram::add(qint64 nanoseconds)
+{
+    if (m_count == Window)
+        --m_bins[m_ring[m_next]];
+    else
+        ++m_count;
+
+    const int bin = binOf(nanoseconds);
+    m_ring[m_next] = bin;
+    ++m_bins[bin];
+
+    m_next = (m_next + 1) % Window;
+}
+
+qreal QNiTELatencyHistogram::percentile(qreal fraction) const
+{
+    if (m_count == 0)
+        return 0;
+
+    const int rank = qBound(1, qCeil(fraction * m_count), m_count);
+
+    int seen = 0;
+    for (int bin = 0; bin < BinCount; ++bin)
+    {
+        seen += m_bins[bin];
+        if (seen >= rank)
+            return upperBoundOf(bin);
+    }
+
+    return upperBoundOf(BinCount - 1);
+}
+
+int QNiTELatencyHistogram::binOf(qint64 nanoseconds)
+{
+    const qint64 micros = qBound<qint64>(0, nanoseconds / 1000, (1 << 24) - 1);
+
+    if (micros < 16)
+        return int(micros);
+
+    int log2 = 4;
+    while ((micros >> (log2 + 1)) != 0)
+        ++log2;
+
+    // the three bits below the leading one pick one of eight bins in [2^log2, 2^(log2+1))
+    return 16 + (log2 - 4) * 8 + int((micros >> (log2 - 3)) & 7);
+}
+
+qreal QNiTELatencyHistogram::upperBoundOf(int bin)
+{
+    if (bin < 16)
+        return (bin + 1) / 1000.0;
+
+    const int log2 = 4 + (bin - 16) / 8;
+    const int sub = (bin - 16) % 8;
+
+    return qreal(qint64(9 + sub) << (log2 - 3)) / 1000.0;
+}
+
+QNiTELatencyStats::QNiTELatencyStats(QObject *parent) : QObject(parent)
+{
+    m_lastUpdate = 0;
+    m_updatePending.storeRelease(0);
+
+    reset();
+}
+
+QVariantMap QNiTELatencyStats::stage(Stage stage) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    const QNiTELatencyHistogram & histogram = m_stages[stage];
+
+    QVariantMap map;
+    for (int i = 0; i < 3; ++i)
+        map.insert(s_percentileKeys[i], histogram.percentile(s_percentiles[i]));
+    map.insert("count", histogram.count());
+
+    return map;
+}
+
+void QNiTELatencyStats::recordDelivery(const QNiTEFrameTiming & timing)
+{
+    if (!timing.callbackEntry || !timing.processStart || !timing.processEnd || !timing.delivered)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+
+    if (timing.sensorTimestamp)
+    {
+        // a recording looping or a restarted device starts the sensor clock over
+        if (timing.sensorTimestamp < m_lastSensorTimestamp)
+        {
+            m_offsetBaseline = m_offsetWindowMin = std::numeric_limits<qint64>::max();
+            m_offsetSamples = 0;
+        }
+        m_lastSensorTimestamp = timing.sensorTimestamp;
+
+        // the fastest frame of the current or previous window is taken as zero; windows
+        // keep drift between the sensor and host clocks from accumulating
+        const qint64 offset = timing.callbackEntry / 1000 - qint64(timing.sensorTimestamp);
+        m_offsetWindowMin = qMin(m_offsetWindowMin, offset);
+
+        add(SensorStage, (offset - qMin(m_offsetBaseline, m_offsetWindowMin)) * 1000);
+
+        if (++m_offsetSamples == QNiTELatencyHistogram::Window)
+        {
+            m_offsetBaseline = m_offsetWindowMin;
+            m_offsetWindowMin = std::numeric_limits<qint64>::max();
+            m_offsetSamples = 0;
+        }
+    }
+
+    add(QueueStage, timing.processStart - timing.callbackEntry);
+    add(ProcessStage, timing.processEnd - timing.processStart);
+    add(DeliveryStage, timing.delivered - timing.processEnd);
+
+    scheduleUpdate();
+}
+
+void QNiTELatencyStats::recordPaint(const QNiTEFrameTiming & timing)
+{
+    if (!timing.callbackEntry || !timing.delivered || !timing.painted)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+
+    add(RenderStage, timing.painted - timing.delivered);
+    add(TotalStage, timing.painted - timing.callbackEntry);
+
+    scheduleUpdate();
+}
+
+void QNiTELatencyStats::reset()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+
+        for (int i = 0; i < StageCount; ++i)
+            m_stages[i].clear();
+
+        m_offsetBaseline = m_offsetWindowMin = std::numeric_limits<qint64>::max();
+        m_offsetSamples = 0;
+        m_lastSensorTimestamp = 0;
+    }
+
+    emit updated();
+}
+
+void QNiTELatencyStats::notifyUpdated()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_lastUpdate = qniteTimestampNs();
+    }
+
+    m_updatePending.storeRelease(0);
+    emit updated();
+}
+
+void QNiTELatencyStats::add(Stage stage, qint64 nanoseconds)
+{
+    m_stages[stage].add(nanoseconds);
+}
+
+// called with m_mutex held
+void QNiTELatencyStats::scheduleUpdate()
+{
+    if (qniteTimestampNs() - m_lastUpdate < s_updateIntervalNs)
+        return;
+
+    if (m_updatePending.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "notifyUpdated", Qt::QueuedConnection);
+}
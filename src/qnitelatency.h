@@ -0,0 +1,154 @@
+#ifndef QNITELATENCY_H
+#define QNITELATENCY_H
+
+#include <QObject>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVariantMap>
+
+#include "qniteframe.h"
+
+// monotonic clock shared by every pipeline stage and thread, nanoseconds
+qint64 qniteTimestampNs();
+
+/*
+ * Latency histogram over the last Window samples.
+ *
+ * Bins are 1us wide below 16us, and above that eight bins per power of two,
+ * so percentiles are accurate to about 12% at any scale. Adding a sample and
+ * dropping the oldest one are O(1).
+ */
+class QNiTELatencyHistogram
+{
+public:
+    enum { Window = 300, BinCount = 176 };
+
+    QNiTELatencyHistogram();
+
+    void add(qint64 nanoseconds);
+    void clear();
+
+    int count() const
+    {
+        return m_count;
+    }
+
+    // upper bound of the bin holding the given fraction of samples, in milliseconds
+    qreal percentile(qreal fraction) const;
+
+private:
+    static int binOf(qint64 nanoseconds);
+    static qreal upperBoundOf(int bin);
+
+    quint16 m_bins[BinCount];
+    quint8 m_ring[Window];
+    int m_next;
+    int m_count;
+};
+
+/*
+ * Rolling per-stage latency of tracker frames, as maps of p50/p95/p99 (ms) and count.
+ *
+ *   sensor    sensor timestamp to source callback, relative to the fastest recent
+ *             frame, since the sensor clock is not the host clock
+ *   queue     source callback to processNewFrame(), the queued invocation
+ *   process   processNewFrame() itself
+ *   delivery  emitting newTrackerFrame, i.e. QML handlers
+ *   render    delivery to the swap of the first frame painted by QNiTETrackerRenderer
+ *   total     source callback to that swap
+ *
+ * Stages are recorded from the GUI and render threads; updated() is emitted on the
+ * GUI thread a few times per second at most.
+ */
+class QNiTELatencyStats : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QVariantMap sensor READ sensor NOTIFY updated)
+    Q_PROPERTY(QVariantMap queue READ queue NOTIFY updated)
+    Q_PROPERTY(QVariantMap process READ process NOTIFY updated)
+    Q_PROPERTY(QVariantMap delivery READ delivery NOTIFY updated)
+    Q_PROPERTY(QVariantMap render READ render NOTIFY updated)
+    Q_PROPERTY(QVariantMap total READ total NOTIFY updated)
+
+public:
+    enum Stage {
+        SensorStage,
+        QueueStage,
+        ProcessStage,
+        DeliveryStage,
+        RenderStage,
+        TotalStage,
+
+        StageCount
+    };
+
+    explicit QNiTELatencyStats(QObject *parent = 0);
+
+    QVariantMap sensor() const
+    {
+        return stage(SensorStage);
+    }
+
+    QVariantMap queue() const
+    {
+        return stage(QueueStage);
+    }
+
+    QVariantMap process() const
+    {
+        return stage(ProcessStage);
+    }
+
+    QVariantMap delivery() const
+    {
+        return stage(DeliveryStage);
+    }
+
+    QVariantMap render() const
+    {
+        return stage(RenderStage);
+    }
+
+    QVariantMap total() const
+    {
+        return stage(TotalStage);
+    }
+
+    QVariantMap stage(Stage stage) const;
+
+    // sensor to delivery; GUI thread, after newTrackerFrame was emitted
+    void recordDelivery(const QNiTEFrameTiming & timing);
+
+    // delivery to paint; any thread, painted must be set
+    void recordPaint(const QNiTEFrameTiming & timing);
+
+signals:
+
+    void updated();
+
+public slots:
+
+    void reset();
+
+private slots:
+
+    void notifyUpdated();
+
+private:
+    void add(Stage stage, qint64 nanoseconds);
+    void scheduleUpdate();
+
+    mutable QMutex m_mutex;
+    QNiTELatencyHistogram m_stages[StageCount];
+
+    // sensor clock offset tracking, see the sensor stage
+    qint64 m_offsetBaseline;
+    qint64 m_offsetWindowMin;
+    int m_offsetSamples;
+    quint64 m_lastSensorTimestamp;
+
+    QAtomicInt m_updatePending;
+    qint64 m_lastUpdate;
+};
+
+#endif // QNITELATENCY_H
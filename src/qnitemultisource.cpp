@@ -0,0 +1,523 @@
+#include "qnitemultisource.h"
+
+#include <QMutexLocker>
+
+#include "qnitelatency.h"
+
+// half a torso: closer centers of mass are one person seen twice
+static const float s_defaultMergeDistance = 300.0f;
+
+// a few frames at 30 fps; a sensor that stalls longer stops contributing users
+static const int s_defaultStaleAfter = 200;
+
+// user labels are qint16, so ids made up for a clash stay below that
+static const int s_maxId = 32767;
+
+class QNiTEMultiTrackerStorage : public QNiTEFrameStorage
+{
+public:
+    QSharedPointer<QNiTEFrameStorage> primary;
+    QExplicitlySharedDataPointer<const QNiTEMultiLabels> labels;
+};
+
+// how well a sensor sees a user
+static float scoreOf(const QNiTEUserData & user)
+{
+    float score = (user.isVisible ? 1000.0f : 0.0f) + (user.skeletonTracked ? 100.0f : 0.0f);
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        score += user.joints[j].confidence;
+
+    return score;
+}
+
+static void transformUser(QNiTEUserData * user, const QMatrix4x4 & extrinsic)
+{
+    // a null center of mass means the tracker does not know it
+    if (!user->centerOfMass.isNull())
+        user->centerOfMass = extrinsic.map(user->centerOfMass);
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        user->joints[j].position = extrinsic.map(user->joints[j].position);
+
+    // rotated boxes are not axis aligned anymore, so this is the box around the rotated one
+    const QVector3D & lo = user->boundingMin;
+    const QVector3D & hi = user->boundingMax;
+    QVector3D newMin, newMax;
+
+    for (int c = 0; c < 8; ++c)
+    {
+        const QVector3D corner = extrinsic.map(QVector3D(c & 1 ? hi.x() : lo.x(), c & 2 ? hi.y() : lo.y(), c & 4 ? hi.z() : lo.z()));
+
+        for (int a = 0; a < 3; ++a)
+        {
+            if (c == 0 || corner[a] < newMin[a]) newMin[a] = corner[a];
+            if (c == 0 || corner[a] > newMax[a]) newMax[a] = corner[a];
+        }
+    }
+
+    user->boundingMin = newMin;
+    user->boundingMax = newMax;
+}
+
+QNiTEMultiSource::QNiTEMultiSource()
+{
+    m_mergeDistance = s_defaultMergeDistance;
+    m_staleAfter = s_defaultStaleAfter;
+    m_nextSpareId = 0;
+    m_opened = false;
+}
+
+QNiTEMultiSource::~QNiTEMultiSource()
+{
+    close();
+
+    for (int i = 0; i < m_sensors.size(); ++i)
+        delete m_sensors[i].source;
+}
+
+void QNiTEMultiSource::addSensor(const QString & uri, const QMatrix4x4 & extrinsic)
+{
+    addSensor(QNiTEFrameSource::create(uri), extrinsic);
+}
+
+void QNiTEMultiSource::addSensor(QNiTEFrameSource * source, const QMatrix4x4 & extrinsic)
+{
+    if (m_opened)
+    {
+        qDebug("[QNiTEMultiSource::addSensor] Already open, ignoring.");
+        delete source;
+        return;
+    }
+
+    // only the primary's color is used
+    if (!m_sensors.isEmpty())
+        source->setColorEnabled(false);
+    else
+        source->setColorVideoMode(m_colorVideoMode);
+
+    source->setDepthVideoMode(m_depthVideoMode);
+
+    Sensor sensor;
+    sensor.source = source;
+    sensor.extrinsic = extrinsic;
+    m_sensors.append(sensor);
+}
+
+bool QNiTEMultiSource::open()
+{
+    if (m_opened) return true;
+
+    if (m_sensors.isEmpty())
+    {
+        m_errorString = QString("No sensors to open");
+        return false;
+    }
+
+    m_mergedIds.resize(0);
+    m_reported.resize(0);
+    m_nextSpareId = m_sensors.size() * QNITE_MULTI_SOURCE_ID_STRIDE;
+
+    for (int i = 0; i < m_sensors.size(); ++i)
+    {
+        QNiTEFrameSource * source = m_sensors[i].source;
+        source->setListener(this);
+
+        if (!source->open())
+        {
+            m_errorString = QString("Failed to open sensor %1: %2").arg(i).arg(source->errorString());
+
+            for (int j = 0; j < i; ++j)
+                m_sensors[j].source->close();
+
+            return false;
+        }
+    }
+
+    m_depthIntrinsics = m_sensors[0].source->depthIntrinsics();
+    m_primaryInverse = m_sensors[0].extrinsic.inverted();
+
+    m_opened = true;
+    return true;
+}
+
+void QNiTEMultiSource::close()
+{
+    if (!m_opened) return;
+
+    // waits for the sensors' threads, so nothing calls back after this
+    for (int i = 0; i < m_sensors.size(); ++i)
+    {
+        m_sensors[i].source->close();
+        m_sensors[i].users.clear();
+        m_sensors[i].updated = 0;
+    }
+
+    m_frame = QNiTETrackerFrame();
+    m_depthIntrinsics = QNiTEDepthIntrinsics();
+
+    m_opened = false;
+}
+
+void QNiTEMultiSource::setColorEnabled(bool enabled)
+{
+    if (!m_sensors.isEmpty())
+        m_sensors[0].source->setColorEnabled(enabled);
+}
+
+void QNiTEMultiSource::setColorVideoMode(const QNiTEVideoMode & mode)
+{
+    QNiTEFrameSource::setColorVideoMode(mode);
+
+    if (!m_sensors.isEmpty())
+        m_sensors[0].source->setColorVideoMode(mode);
+}
+
+void QNiTEMultiSource::setDepthVideoMode(const QNiTEVideoMode & mode)
+{
+    QNiTEFrameSource::setDepthVideoMode(mode);
+
+    for (int i = 0; i < m_sensors.size(); ++i)
+        m_sensors[i].source->setDepthVideoMode(mode);
+}
+
+bool QNiTEMultiSource::readTrackerFrame(QNiTETrackerFrame * frame)
+{
+    *frame = m_frame;
+    return m_frame.valid;
+}
+
+bool QNiTEMultiSource::readColorFrame(QNiTEColorFrame * frame)
+{
+    return m_sensors[0].source->readColorFrame(frame);
+}
+
+QPointF QNiTEMultiSource::toDepthSpace(const QVector3D & point) const
+{
+    return m_sensors[0].source->toDepthSpace(m_primaryInverse.map(point));
+}
+
+bool QNiTEMultiSource::depthToColor(int x, int y, quint16 depth, QPointF * color) const
+{
+    return m_sensors[0].source->depthToColor(x, y, depth, color);
+}
+
+int QNiTEMultiSource::maxUsers() const
+{
+    int users = 0;
+    for (int i = 0; i < m_sensors.size(); ++i)
+        users += m_sensors[i].source->maxUsers();
+    return users;
+}
+
+int QNiTEMultiSource::indexOf(const QNiTEFrameSource & source) const
+{
+    for (int i = 0; i < m_sensors.size(); ++i)
+    {
+        if (m_sensors[i].source == &source)
+            return i;
+    }
+    return -1;
+}
+
+void QNiTEMultiSource::onNewTrackerFrame(QNiTEFrameSource & source)
+{
+    const qint64 now = qniteTimestampNs();
+    const int index = indexOf(source);
+
+    if (index < 0) return;
+
+    if (index > 0)
+    {
+        // only the users are kept, so the sensor gets its buffers back right away
+        QNiTETrackerFrame frame;
+        if (source.readTrackerFrame(&frame))
+            storeUsers(index, frame, now);
+        return;
+    }
+
+    if (!source.readTrackerFrame(&m_frame))
+    {
+        qDebug("[QNiTEMultiSource::onNewTrackerFrame] Getting primary tracker frame failed");
+        return;
+    }
+
+    storeUsers(0, m_frame, now);
+    merge(&m_frame, now);
+
+    if (m_listener)
+        m_listener->onNewTrackerFrame(*this);
+}
+
+void QNiTEMultiSource::onNewColorFrame(QNiTEFrameSource & source)
+{
+    if (m_listener && indexOf(source) == 0)
+        m_listener->onNewColorFrame(*this);
+}
+
+void QNiTEMultiSource::storeUsers(int index, const QNiTETrackerFrame & frame, qint64 now)
+{
+    Sensor & sensor = m_sensors[index];
+
+    // only this thread touches the spare, so filling it reuses its buffer
+    QVector<QNiTEUserData> & users = sensor.spare;
+    users.resize(frame.users.size());
+
+    const bool identity = sensor.extrinsic.isIdentity();
+
+    for (int i = 0; i < users.size(); ++i)
+    {
+        users[i] = frame.users[i];
+        users[i].id += index * QNITE_MULTI_SOURCE_ID_STRIDE;
+
+        if (!identity)
+            transformUser(&users[i], sensor.extrinsic);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    sensor.users.swap(users);
+    sensor.updated = now;
+}
+
+static bool containsUser(const QVector<QNiTEUserData> & users, int id)
+{
+    for (int i = 0; i < users.size(); ++i)
+    {
+        if (users[i].id == id)
+            return true;
+    }
+    return false;
+}
+
+bool QNiTEMultiSource::isTaken(int id) const
+{
+    for (int g = 0; g < m_groups.size(); ++g)
+    {
+        if (m_groups[g].id == id)
+            return true;
+    }
+    return false;
+}
+
+QNiTEMultiLabels * QNiTEMultiSource::freeLabels()
+{
+    // one only the pool still holds; every frame that used it is gone
+    for (int i = 0; i < m_labels.size(); ++i)
+    {
+        if (m_labels[i]->ref.loadAcquire() == 1)
+            return m_labels[i].data();
+    }
+
+    QNiTEMultiLabels * labels = new QNiTEMultiLabels();
+    m_labels.append(QExplicitlySharedDataPointer<QNiTEMultiLabels>(labels));
+    return labels;
+}
+
+void QNiTEMultiSource::merge(QNiTETrackerFrame * frame, qint64 now)
+{
+    m_candidates.resize(0);
+    {
+        QMutexLocker locker(&m_mutex);
+        const qint64 staleAfter = qint64(m_staleAfter) * 1000000;
+
+        for (int s = 0; s < m_sensors.size(); ++s)
+        {
+            const Sensor & sensor = m_sensors[s];
+            if (sensor.updated == 0 || now - sensor.updated > staleAfter)
+                continue;
+
+            for (int i = 0; i < sensor.users.size(); ++i)
+            {
+                // lost users are left to disappear from the merged ones below
+                if (sensor.users[i].isLost)
+                    continue;
+
+                Candidate candidate;
+                candidate.user = sensor.users[i];
+                candidate.sensor = s;
+                candidate.score = scoreOf(candidate.user);
+                candidate.next = -1;
+                m_candidates.append(candidate);
+            }
+        }
+    }
+
+    // one person per group, with at most one user of every sensor
+    m_groups.resize(0);
+    const float mergeDistanceSquared = m_mergeDistance * m_mergeDistance;
+
+    for (int c = 0; c < m_candidates.size(); ++c)
+    {
+        const QNiTEUserData & user = m_candidates[c].user;
+        int closest = -1;
+        float closestDistance = mergeDistanceSquared;
+
+        for (int g = 0; g < m_groups.size() && !user.centerOfMass.isNull(); ++g)
+        {
+            const QVector3D & center = m_candidates[m_groups[g].first].user.centerOfMass;
+
+            bool sameSensor = false;
+            for (int m = m_groups[g].first; m >= 0; m = m_candidates[m].next)
+                sameSensor |= m_candidates[m].sensor == m_candidates[c].sensor;
+
+            if (sameSensor || center.isNull())
+                continue;
+
+            const float distance = (center - user.centerOfMass).lengthSquared();
+            if (distance < closestDistance)
+            {
+                closest = g;
+                closestDistance = distance;
+            }
+        }
+
+        if (closest >= 0)
+        {
+            m_candidates[m_groups[closest].last].next = c;
+            m_groups[closest].last = c;
+        }
+        else
+        {
+            Group group;
+            group.first = c;
+            group.last = c;
+            group.id = 0;
+            m_groups.append(group);
+        }
+    }
+
+    // ids reported last frame go first, to the first group still holding one of their users
+    for (int g = 0; g < m_groups.size(); ++g)
+    {
+        Group & group = m_groups[g];
+
+        for (int m = group.first; m >= 0 && !group.id; m = m_candidates[m].next)
+        {
+            const int user = m_candidates[m].user.id;
+
+            for (int i = 0; i < m_mergedIds.size() && !group.id; ++i)
+            {
+                if (m_mergedIds[i].user == user && !isTaken(m_mergedIds[i].id))
+                    group.id = m_mergedIds[i].id;
+            }
+        }
+    }
+
+    // new people take their first user's id, unless a group that split up kept it
+    for (int g = 0; g < m_groups.size(); ++g)
+    {
+        Group & group = m_groups[g];
+
+        for (int m = group.first; m >= 0 && !group.id; m = m_candidates[m].next)
+        {
+            const int id = m_candidates[m].user.id;
+            if (!isTaken(id))
+                group.id = id;
+        }
+
+        while (!group.id)
+        {
+            const int id = m_nextSpareId;
+            m_nextSpareId = m_nextSpareId < s_maxId ? m_nextSpareId + 1 : m_sensors.size() * QNITE_MULTI_SOURCE_ID_STRIDE;
+
+            if (!isTaken(id) && !containsUser(m_reported, id))
+                group.id = id;
+        }
+    }
+
+    // the primary's labels follow its users into the merged ids
+    bool relabeled = false;
+
+    m_mergedIds.resize(0);
+    m_reporting.resize(0);
+    QVector<QNiTEUserData> users;
+    users.reserve(m_groups.size() + m_reported.size());
+
+    for (int g = 0; g < m_groups.size(); ++g)
+    {
+        const Group & group = m_groups[g];
+        int best = group.first;
+
+        for (int m = group.first; m >= 0; m = m_candidates[m].next)
+        {
+            const Candidate & candidate = m_candidates[m];
+
+            MergedId merged;
+            merged.user = candidate.user.id;
+            merged.id = group.id;
+            m_mergedIds.append(merged);
+
+            if (candidate.score > m_candidates[best].score)
+                best = m;
+
+            if (candidate.sensor == 0 && candidate.user.id != group.id && candidate.user.id < QNITE_MULTI_SOURCE_ID_STRIDE)
+            {
+                if (!relabeled)
+                {
+                    m_relabel.resize(QNITE_MULTI_SOURCE_ID_STRIDE);
+                    for (int l = 0; l < m_relabel.size(); ++l)
+                        m_relabel[l] = qint16(l);
+                    relabeled = true;
+                }
+
+                m_relabel[candidate.user.id] = qint16(group.id);
+            }
+        }
+
+        QNiTEUserData user = m_candidates[best].user;
+        user.id = group.id;
+        user.isNew = !containsUser(m_reported, user.id);
+        user.isLost = false;
+
+        users.append(user);
+        m_reporting.append(user);
+    }
+
+    // everyone no sensor reports anymore is lost, once
+    for (int r = 0; r < m_reported.size(); ++r)
+    {
+        if (containsUser(m_reporting, m_reported[r].id))
+            continue;
+
+        QNiTEUserData user = m_reported[r];
+        user.isNew = false;
+        user.isLost = true;
+        user.isVisible = false;
+        user.skeletonTracked = false;
+        users.append(user);
+    }
+
+    m_reported.swap(m_reporting);
+    frame->users.swap(users);
+
+    const QMatrix4x4 & extrinsic = m_sensors[0].extrinsic;
+    if (!extrinsic.isIdentity())
+    {
+        frame->floorPoint = extrinsic.map(frame->floorPoint);
+        frame->floorNormal = extrinsic.mapVector(frame->floorNormal).normalized();
+    }
+
+    if (!relabeled || !frame->labels)
+        return;
+
+    QNiTEMultiLabels * labels = freeLabels();
+    labels->labels.resize(frame->width * frame->height);
+
+    const qint16 * source = frame->labels;
+    const qint16 * relabel = m_relabel.constData();
+    qint16 * target = labels->labels.data();
+
+    for (int i = 0; i < labels->labels.size(); ++i)
+    {
+        const qint16 label = source[i];
+        target[i] = label > 0 && label < QNITE_MULTI_SOURCE_ID_STRIDE ? relabel[label] : label;
+    }
+
+    // a small one per frame, like the device source's; the labels are what it reuses
+    QSharedPointer<QNiTEMultiTrackerStorage> storage(new QNiTEMultiTrackerStorage());
+    storage->primary = frame->storage;
+    storage->labels = QExplicitlySharedDataPointer<const QNiTEMultiLabels>(labels);
+
+    frame->labels = target;
+    frame->storage = storage;
+}
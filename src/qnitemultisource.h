@@ -0,0 +1,188 @@
+#ifndef QNITEMULTISOURCE_H
+#define QNITEMULTISOURCE_H
+
+#include <QExplicitlySharedDataPointer>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QSharedData>
+#include <QVector>
+
+#include "qniteframesource.h"
+
+// user ids of sensor n are n * this plus the id its tracker gave them
+#define QNITE_MULTI_SOURCE_ID_STRIDE 1000
+
+// the primary's user labels with merged ids; the source keeps a few and reuses
+// each once no frame holds it anymore
+struct QNiTEMultiLabels : public QSharedData
+{
+    QVector<qint16> labels;
+};
+
+/*
+ * Several sensors tracking the same space, merged into one frame source.
+ *
+ * Every sensor is a frame source of its own (a device URI, a recorded .oni file
+ * or a synthetic one, see QNiTEFrameSource::create()) that calls back on its own
+ * thread. Each one has an extrinsic transform from its camera space into a shared
+ * world space, in millimeters; users, their joints and the floor are reported in
+ * world space.
+ *
+ * The first sensor is the primary: its frames drive the merged ones, and it alone
+ * provides depth, user labels and color. The others only contribute users, the
+ * latest ones each of them reported, as long as they are not older than
+ * staleAfter. Keep the primary's transform the identity, or the depth overlays
+ * will not line up with the users.
+ *
+ * Users of different sensors whose centers of mass are closer than mergeDistance
+ * are taken to be the same person, and reported once, with the data of the sensor
+ * that sees them best. A merged user keeps its id for as long as any of the
+ * sensors keeps tracking them, so people walking from one sensor's view into
+ * another's stay the same QNiTEUser.
+ */
+class QNiTEMultiSource : public QNiTEFrameSource, public QNiTEFrameSource::Listener
+{
+public:
+    QNiTEMultiSource();
+    ~QNiTEMultiSource();
+
+    // both must be called before open(); the first sensor added is the primary
+    void addSensor(const QString & uri, const QMatrix4x4 & extrinsic = QMatrix4x4());
+
+    // takes ownership
+    void addSensor(QNiTEFrameSource * source, const QMatrix4x4 & extrinsic = QMatrix4x4());
+
+    int sensorCount() const
+    {
+        return m_sensors.size();
+    }
+
+    QNiTEFrameSource * sensor(int index) const
+    {
+        return m_sensors[index].source;
+    }
+
+    QMatrix4x4 extrinsic(int index) const
+    {
+        return m_sensors[index].extrinsic;
+    }
+
+    float mergeDistance() const
+    {
+        return m_mergeDistance;
+    }
+
+    // millimeters
+    void setMergeDistance(float distance)
+    {
+        m_mergeDistance = qMax(0.0f, distance);
+    }
+
+    int staleAfter() const
+    {
+        return m_staleAfter;
+    }
+
+    // milliseconds
+    void setStaleAfter(int milliseconds)
+    {
+        m_staleAfter = qMax(0, milliseconds);
+    }
+
+    virtual bool open();
+    virtual void close();
+
+    virtual void setColorEnabled(bool enabled);
+
+    // the color mode goes to the primary, the depth mode to every sensor
+    virtual void setColorVideoMode(const QNiTEVideoMode & mode);
+    virtual void setDepthVideoMode(const QNiTEVideoMode & mode);
+
+    virtual bool readTrackerFrame(QNiTETrackerFrame * frame);
+    virtual bool readColorFrame(QNiTEColorFrame * frame);
+
+    virtual QPointF toDepthSpace(const QVector3D & point) const;
+    virtual bool depthToColor(int x, int y, quint16 depth, QPointF * color) const;
+
+    // every sensor's, as users nobody else sees are reported as they are
+    virtual int maxUsers() const;
+
+    // from the sensors, each on its own thread
+    virtual void onNewTrackerFrame(QNiTEFrameSource & source);
+    virtual void onNewColorFrame(QNiTEFrameSource & source);
+
+private:
+    struct Sensor
+    {
+        Sensor() : source(0), updated(0) {}
+
+        QNiTEFrameSource * source;
+        QMatrix4x4 extrinsic;
+
+        // latest users, in world space with merged source ids; under m_mutex
+        QVector<QNiTEUserData> users;
+        qint64 updated; // qniteTimestampNs()
+
+        // the ones before, refilled and swapped in by the sensor's thread
+        QVector<QNiTEUserData> spare;
+    };
+
+    // a sensor's user that is not lost, one of a group
+    struct Candidate
+    {
+        QNiTEUserData user;
+        int sensor;
+        float score;
+        int next; // the group's next candidate, or -1
+    };
+
+    // one person, the candidates of every sensor that sees them
+    struct Group
+    {
+        int first;
+        int last;
+        int id; // 0 until it has one
+    };
+
+    struct MergedId
+    {
+        int user; // sensor user id
+        int id;   // id it was reported as
+    };
+
+    int indexOf(const QNiTEFrameSource & source) const;
+
+    // keeps a sensor's frame users for the next merges
+    void storeUsers(int index, const QNiTETrackerFrame & frame, qint64 now);
+
+    // turns the primary's frame, already stored, into the merged one
+    void merge(QNiTETrackerFrame * frame, qint64 now);
+
+    bool isTaken(int id) const;
+    QNiTEMultiLabels * freeLabels();
+
+    QVector<Sensor> m_sensors;
+    QMutex m_mutex;
+
+    float m_mergeDistance;
+    int m_staleAfter;
+
+    bool m_opened;
+    QMatrix4x4 m_primaryInverse;
+
+    // primary thread only
+    QNiTETrackerFrame m_frame;
+    QVector<MergedId> m_mergedIds;
+    QVector<QNiTEUserData> m_reported;       // what was reported last frame
+    int m_nextSpareId;                       // for people whose users' ids are all taken
+
+    // merge()'s, kept so they only ever grow; a handful of users at most, so
+    // lookups are scans
+    QVector<Candidate> m_candidates;
+    QVector<Group> m_groups;
+    QVector<QNiTEUserData> m_reporting;
+    QVector<qint16> m_relabel;
+    QVector<QExplicitlySharedDataPointer<QNiTEMultiLabels> > m_labels;
+};
+
+#endif // QNITEMULTISOURCE_H
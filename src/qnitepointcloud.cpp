@@ -0,0 +1,244 @@
+#include "qnitepointcloud.h"
+
+#include <QtMath>
+
+#include "qnitecpu.h"
+
+// voxel coordinates are packed 21 bits each into a 64 bit key, biased to be positive
+static const int s_voxelBits = 21;
+static const qint64 s_voxelBias = qint64(1) << (s_voxelBits - 1);
+static const quint64 s_voxelMask = (quint64(1) << s_voxelBits) - 1;
+static const quint64 s_emptyVoxel = ~quint64(0);
+
+// world mm per pixel per mm of depth, and the offset that centers the image
+struct UnprojectionFactors
+{
+    float scaleX;
+    float offsetX;
+    float scaleY;
+    float offsetY;
+};
+
+static UnprojectionFactors factorsOf(const QNiTEDepthIntrinsics & intrinsics)
+{
+    const float xzFactor = 2 * qTan(intrinsics.horizontalFov / 2);
+    const float yzFactor = 2 * qTan(intrinsics.verticalFov / 2);
+
+    UnprojectionFactors factors;
+    factors.scaleX = xzFactor / intrinsics.resolutionX;
+    factors.offsetX = -0.5f * xzFactor;
+    factors.scaleY = yzFactor / intrinsics.resolutionY;
+    factors.offsetY = 0.5f * yzFactor;
+    return factors;
+}
+
+// rowFactor is y / z for the whole row
+static void unprojectScalar(const UnprojectionFactors & f, float rowFactor, const float * u, const float * z,
+                            const qint32 * labels, QNiTEPoint * out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        out[i].x = (u[i] * f.scaleX + f.offsetX) * z[i];
+        out[i].y = rowFactor * z[i];
+        out[i].z = z[i];
+        out[i].userId = labels[i];
+    }
+}
+
+#ifdef QNITE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void unprojectSSE2(const UnprojectionFactors & f, float rowFactor, const float * u, const float * z,
+                          const qint32 * labels, QNiTEPoint * out, int count)
+{
+    const __m128 scaleX = _mm_set1_ps(f.scaleX);
+    const __m128 offsetX = _mm_set1_ps(f.offsetX);
+    const __m128 row = _mm_set1_ps(rowFactor);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 px = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(u + i), scaleX), offsetX), pz);
+        __m128 py = _mm_mul_ps(row, pz);
+        __m128 pl = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + i)));
+
+        // four x, y, z, userId columns into four points
+        _MM_TRANSPOSE4_PS(px, py, pz, pl);
+
+        float * p = reinterpret_cast<float *>(out + i);
+        _mm_storeu_ps(p, px);
+        _mm_storeu_ps(p + 4, py);
+        _mm_storeu_ps(p + 8, pz);
+        _mm_storeu_ps(p + 12, pl);
+    }
+
+    unprojectScalar(f, rowFactor, u + i, z + i, labels + i, out + i, count - i);
+}
+
+#endif // QNITE_X86_SIMD
+
+typedef void (*UnprojectFunction)(const UnprojectionFactors &, float, const float *, const float *, const qint32 *, QNiTEPoint *, int);
+
+struct UnprojectKernel
+{
+    UnprojectFunction function;
+    const char * name;
+    int features;
+};
+
+static const UnprojectKernel s_unprojectKernels[] = {
+#ifdef QNITE_X86_SIMD
+    { unprojectSSE2, "sse2", QNiTECpuSSE2 },
+#endif
+    { unprojectScalar, "scalar", 0 }
+};
+
+QNiTEPointCloud::QNiTEPointCloud()
+{
+    m_stride = 1;
+    m_voxelSize = 0;
+    m_userId = AllPixels;
+    m_maxDepth = 0;
+    m_count = 0;
+}
+
+int QNiTEPointCloud::generate(const QNiTETrackerFrame & frame, const QNiTEDepthIntrinsics & intrinsics)
+{
+    m_count = 0;
+
+    if (!frame.isValid() || !frame.depth || !intrinsics.isValid())
+        return 0;
+
+    if (m_userId != AllPixels && !frame.labels)
+        return 0;
+
+    const int columns = (frame.width + m_stride - 1) / m_stride;
+    const int rows = (frame.height + m_stride - 1) / m_stride;
+
+    if (m_points.size() < columns * rows)
+        m_points.resize(columns * rows);
+
+    if (m_u.size() < columns)
+    {
+        m_u.resize(columns);
+        m_z.resize(columns);
+        m_labels.resize(columns);
+    }
+
+    const UnprojectFunction unproject = qniteSelectKernel(s_unprojectKernels).function;
+    const UnprojectionFactors factors = factorsOf(intrinsics);
+    const int maxDepth = m_maxDepth > 0 ? m_maxDepth : 0xffff;
+    const int rowSize = frame.depthStride / sizeof(quint16);
+
+    float * u = m_u.data();
+    float * z = m_z.data();
+    qint32 * labels = m_labels.data();
+    QNiTEPoint * out = m_points.data();
+
+    for (int y = 0; y < frame.height; y += m_stride)
+    {
+        const quint16 * depthRow = frame.depth + y * rowSize;
+        const qint16 * labelRow = frame.labels ? frame.labels + y * frame.width : 0;
+
+        // compact the row's surviving pixels, then unproject them in one batch
+        int n = 0;
+        for (int x = 0; x < frame.width; x += m_stride)
+        {
+            const int depth = depthRow[x];
+            if (depth == 0 || depth > maxDepth)
+                continue;
+
+            const int label = labelRow ? labelRow[x] : 0;
+            if (m_userId == AnyUser ? label == 0 : (m_userId > 0 && label != m_userId))
+                continue;
+
+            u[n] = float(frame.cropOriginX + x);
+            z[n] = float(depth);
+            labels[n] = label;
+            ++n;
+        }
+
+        const float rowFactor = factors.offsetY - (frame.cropOriginY + y) * factors.scaleY;
+        unproject(factors, rowFactor, u, z, labels, out + m_count, n);
+        m_count += n;
+    }
+
+    if (m_voxelSize > 0 && m_count > 0)
+        voxelize();
+
+    return m_count;
+}
+
+void QNiTEPointCloud::voxelize()
+{
+    int bits = 4;
+    while ((1 << bits) < m_count * 2)
+        ++bits;
+
+    const int capacity = 1 << bits;
+    if (m_voxels.size() < capacity)
+        m_voxels.resize(capacity);
+
+    Voxel * voxels = m_voxels.data();
+    for (int i = 0; i < capacity; ++i)
+        voxels[i].key = s_emptyVoxel;
+
+    const float inverse = 1.0f / m_voxelSize;
+    QNiTEPoint * points = m_points.data();
+
+    for (int i = 0; i < m_count; ++i)
+    {
+        const QNiTEPoint & p = points[i];
+
+        const quint64 key = (quint64(qFloor(p.x * inverse) + s_voxelBias) & s_voxelMask) << (2 * s_voxelBits)
+                | (quint64(qFloor(p.y * inverse) + s_voxelBias) & s_voxelMask) << s_voxelBits
+                | (quint64(qFloor(p.z * inverse) + s_voxelBias) & s_voxelMask);
+
+        // Fibonacci hashing, then linear probing
+        int slot = int((key * Q_UINT64_C(0x9e3779b97f4a7c15)) >> (64 - bits));
+        while (voxels[slot].key != key && voxels[slot].key != s_emptyVoxel)
+            slot = (slot + 1) & (capacity - 1);
+
+        Voxel & voxel = voxels[slot];
+        if (voxel.key == s_emptyVoxel)
+        {
+            voxel.key = key;
+            voxel.x = voxel.y = voxel.z = 0;
+            voxel.userId = 0;
+            voxel.count = 0;
+        }
+
+        voxel.x += p.x;
+        voxel.y += p.y;
+        voxel.z += p.z;
+        voxel.count++;
+
+        // a voxel touching a user belongs to it
+        if (voxel.userId == 0)
+            voxel.userId = p.userId;
+    }
+
+    // there are never more voxels than points, so they can replace them in place
+    int n = 0;
+    for (int i = 0; i < capacity; ++i)
+    {
+        const Voxel & voxel = voxels[i];
+        if (voxel.key == s_emptyVoxel)
+            continue;
+
+        const float scale = 1.0f / voxel.count;
+        points[n].x = voxel.x * scale;
+        points[n].y = voxel.y * scale;
+        points[n].z = voxel.z * scale;
+        points[n].userId = voxel.userId;
+        ++n;
+    }
+
+    m_count = n;
+}
+
+const char * qnitePointCloudImplementation()
+{
+    return qniteSelectKernel(s_unprojectKernels).name;
+}
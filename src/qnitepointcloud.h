@@ -0,0 +1,147 @@
+#ifndef QNITEPOINTCLOUD_H
+#define QNITEPOINTCLOUD_H
+
+#include <QVector>
+
+#include "qniteframe.h"
+
+/*
+ * Turns the depth image of tracker frames into world space points, the same
+ * pinhole model as OpenNI's CoordinateConverter::convertDepthToWorld.
+ *
+ * Pixels are sampled every stride pixels along both axes; invalid depth, pixels
+ * beyond maxDepth and, depending on userId, pixels of other users are skipped.
+ * A voxel size above zero then merges the points of every voxel into their
+ * average.
+ *
+ * Points are written to a buffer that only grows, so after the first few frames
+ * generate() does not allocate. Rows are unprojected with SSE2 where the CPU has
+ * it (see qnitecpu.h).
+ *
+ * Not thread safe; use one per thread.
+ */
+class QNiTEPointCloud
+{
+public:
+    enum UserSelection
+    {
+        AllPixels = -1, // background included
+        AnyUser = 0     // pixels labelled with any user; a positive userId keeps that user only
+    };
+
+    QNiTEPointCloud();
+
+    int stride() const
+    {
+        return m_stride;
+    }
+
+    // 1 samples every pixel
+    void setStride(int stride)
+    {
+        m_stride = qMax(1, stride);
+    }
+
+    float voxelSize() const
+    {
+        return m_voxelSize;
+    }
+
+    // edge of the downsampling voxels, in mm; 0 disables the voxel grid
+    void setVoxelSize(float size)
+    {
+        m_voxelSize = qMax(0.0f, size);
+    }
+
+    int userId() const
+    {
+        return m_userId;
+    }
+
+    // a UserSelection, or the id of the one user to keep
+    void setUserId(int userId)
+    {
+        m_userId = qMax(int(AllPixels), userId);
+    }
+
+    int maxDepth() const
+    {
+        return m_maxDepth;
+    }
+
+    // in mm; 0 keeps every valid depth
+    void setMaxDepth(int maxDepth)
+    {
+        m_maxDepth = qMax(0, maxDepth);
+    }
+
+    // fills the buffer from frame's depth and labels, returns the point count
+    int generate(const QNiTETrackerFrame & frame, const QNiTEDepthIntrinsics & intrinsics);
+
+    // valid until the next generate(); count() points long
+    const QNiTEPoint * points() const
+    {
+        return m_points.constData();
+    }
+
+    int count() const
+    {
+        return m_count;
+    }
+
+    // exchanges the buffer with points, which the next generate() then fills; hands a
+    // cloud on without copying it, and empties this one
+    void swapPoints(QVector<QNiTEPoint> & points)
+    {
+        m_points.swap(points);
+        m_count = 0;
+    }
+
+private:
+    void voxelize();
+
+    int m_stride;
+    float m_voxelSize;
+    int m_userId;
+    int m_maxDepth;
+
+    QVector<QNiTEPoint> m_points;
+    int m_count;
+
+    // pixels of one row that passed the filters, as separate arrays for the kernel
+    QVector<float> m_u, m_z;
+    QVector<qint32> m_labels;
+
+    // open addressing hash of voxels; only the first power of two above twice the
+    // point count is in use during a frame
+    struct Voxel
+    {
+        quint64 key;
+        float x, y, z;
+        qint32 userId;
+        int count;
+    };
+
+    QVector<Voxel> m_voxels;
+};
+
+// what QNiTE's tracker worker generates a snapshot's cloud with, see QNiTE::addPointCloud()
+struct QNiTEPointCloudSettings
+{
+    QNiTEPointCloudSettings() : stride(2), voxelSize(0), userId(QNiTEPointCloud::AllPixels), maxDepth(0) {}
+
+    bool operator==(const QNiTEPointCloudSettings & other) const
+    {
+        return stride == other.stride && voxelSize == other.voxelSize && userId == other.userId && maxDepth == other.maxDepth;
+    }
+
+    int stride;
+    float voxelSize;
+    int userId;
+    int maxDepth;
+};
+
+// "sse2" or "scalar", whichever unprojects the rows of generate()
+const char * qnitePointCloudImplementation();
+
+#endif // QNITEPOINTCLOUD_H
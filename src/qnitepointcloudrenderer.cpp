@@ -0,0 +1,194 @@
+#include "qnitepointcloudrenderer.h"
+
+#include <QSGGeometryNode>
+#include <QSGTransformNode>
+#include <QSGVertexColorMaterial>
+#include <QtMath>
+
+#include "qnite.h"
+
+// viewMatrix turns the cloud around this depth, which is also fitted to the item, in mm
+static const float s_pivotDepth = 3000.0f;
+
+// points fade out towards this depth unless maxDepth is set, in mm
+static const float s_fadeDepth = 10000.0f;
+static const int s_minIntensity = 48;
+
+struct PointVertex
+{
+    float x, y, z;
+    uchar r, g, b, a;
+};
+
+// the layout of QSGGeometry::ColoredPoint2D with a third coordinate
+static const QSGGeometry::AttributeSet & pointAttributes()
+{
+    static QSGGeometry::Attribute attributes[] = {
+        QSGGeometry::Attribute::create(0, 3, GL_FLOAT, true),
+        QSGGeometry::Attribute::create(1, 4, GL_UNSIGNED_BYTE, false)
+    };
+
+    static QSGGeometry::AttributeSet set = { 2, sizeof(PointVertex), attributes };
+    return set;
+}
+
+// root node placing the cloud in the item; the points are its only child
+class QNiTEPointCloudNode : public QSGTransformNode
+{
+public:
+    QNiTEPointCloudNode()
+    {
+        QSGGeometry * geometry = new QSGGeometry(pointAttributes(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawPoints);
+        geometry->setVertexDataPattern(QSGGeometry::StreamPattern);
+
+        points = new QSGGeometryNode();
+        points->setGeometry(geometry);
+        points->setMaterial(new QSGVertexColorMaterial());
+        points->setFlags(QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+        appendChildNode(points);
+    }
+
+    QSGGeometryNode * points;
+};
+
+QNiTEPointCloudRenderer::QNiTEPointCloudRenderer(QQuickItem * parent) : QQuickItem(parent)
+{
+    m_qnite = 0;
+    m_pointCloudId = 0;
+    m_kinect = 0;
+    m_initialized = false;
+    m_frameDirty = false;
+
+    m_stride = 2;
+    m_voxelSize = 0;
+    m_userId = QNiTEPointCloud::AllPixels;
+    m_maxDepth = 0;
+
+    setFlag(ItemHasContents, true);
+}
+
+QNiTEPointCloudRenderer::~QNiTEPointCloudRenderer()
+{
+    // other renderers keep their clouds
+    if (m_qnite && m_pointCloudId)
+        m_qnite->removePointCloud(m_pointCloudId);
+}
+
+void QNiTEPointCloudRenderer::initialize()
+{
+    if (m_initialized || !m_kinect) return;
+
+    m_qnite = reinterpret_cast<QNiTE*>(m_kinect);
+
+    connect(m_qnite, &QNiTE::newTrackerFrame, this, &QNiTEPointCloudRenderer::onNewFrame);
+
+    m_pointCloudId = m_qnite->addPointCloud(pointCloudSettings());
+
+    setInitialized(true);
+}
+
+void QNiTEPointCloudRenderer::updatePointCloud()
+{
+    if (!m_initialized || !m_qnite) return;
+
+    m_qnite->setPointCloud(m_pointCloudId, pointCloudSettings());
+}
+
+QNiTEPointCloudSettings QNiTEPointCloudRenderer::pointCloudSettings() const
+{
+    QNiTEPointCloudSettings settings;
+    settings.stride = m_stride;
+    settings.voxelSize = float(m_voxelSize);
+    settings.userId = m_userId;
+    settings.maxDepth = m_maxDepth;
+    return settings;
+}
+
+void QNiTEPointCloudRenderer::onNewFrame()
+{
+    m_frameDirty = true;
+    update();
+}
+
+QSGNode * QNiTEPointCloudRenderer::updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *)
+{
+    QNiTEPointCloudNode * node = static_cast<QNiTEPointCloudNode *>(oldNode);
+
+    if (!m_initialized)
+    {
+        delete node;
+        return 0;
+    }
+
+    const QNiTETrackerSnapshotPointer snapshot = m_qnite->trackerSnapshot();
+    const QNiTEDepthIntrinsics & intrinsics = snapshot->intrinsics;
+
+    if (!snapshot->frame.isValid() || !intrinsics.isValid())
+    {
+        delete node;
+        return 0;
+    }
+
+    if (!node)
+    {
+        node = new QNiTEPointCloudNode();
+        m_frameDirty = true;
+    }
+
+    if (m_frameDirty)
+    {
+        m_frameDirty = false;
+
+        // generated by QNiTE's worker, possibly with the settings before the latest change
+        const QNiTEPointCloudBuffer * cloud = snapshot->pointCloud(m_pointCloudId);
+        const int count = cloud ? cloud->count : 0;
+
+        // grow only; vertices past the cloud are transparent, so the buffer is rewritten in place
+        QSGGeometry * geometry = node->points->geometry();
+        if (geometry->vertexCount() < count)
+            geometry->allocate(count);
+
+        PointVertex * v = static_cast<PointVertex *>(geometry->vertexData());
+        const QNiTEPoint * points = cloud ? cloud->points.constData() : 0;
+        const float fade = 255.0f / (m_maxDepth > 0 ? m_maxDepth : s_fadeDepth);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const QNiTEPoint & p = points[i];
+            const uchar intensity = uchar(qBound(s_minIntensity, 255 - int(p.z * fade), 255));
+            const int channel = p.userId == 0 ? -1 : p.userId % 3;
+
+            v[i].x = p.x;
+            v[i].y = p.y;
+            v[i].z = p.z;
+            v[i].r = channel < 0 || channel == 0 ? intensity : 0;
+            v[i].g = channel < 0 || channel == 1 ? intensity : 0;
+            v[i].b = channel < 0 || channel == 2 ? intensity : 0;
+            v[i].a = 255;
+        }
+
+        for (int i = count; i < geometry->vertexCount(); ++i)
+        {
+            v[i].x = v[i].y = v[i].z = 0;
+            v[i].r = v[i].g = v[i].b = v[i].a = 0;
+        }
+
+        node->points->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    // fit the field of view at the pivot depth into the item, then flatten z
+    const float viewWidth = 2 * qTan(intrinsics.horizontalFov / 2) * s_pivotDepth;
+    const float viewHeight = 2 * qTan(intrinsics.verticalFov / 2) * s_pivotDepth;
+    const float scale = qMin(float(width()) / viewWidth, float(height()) / viewHeight);
+
+    QMatrix4x4 matrix;
+    matrix.translate(width() / 2, height() / 2);
+    matrix.scale(scale, -scale, 0);
+    matrix *= m_viewMatrix;
+    matrix.translate(0, 0, -s_pivotDepth);
+
+    node->setMatrix(matrix);
+
+    return node;
+}
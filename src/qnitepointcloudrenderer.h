@@ -0,0 +1,184 @@
+#ifndef QNITEPOINTCLOUDRENDERER_H
+#define QNITEPOINTCLOUDRENDERER_H
+
+#include <QMatrix4x4>
+#include <QPointer>
+#include <QQuickItem>
+
+#include "qnitepointcloud.h"
+
+class QNiTE;
+
+/*
+ * Draws the tracker's depth as a point cloud, one vertex per point.
+ *
+ * QNiTE's tracker worker generates the points with this item's settings, and
+ * every snapshot carries them; while the scene graph syncs they are only copied
+ * into the vertex buffer. Every renderer has a cloud of its own in QNiTE, and
+ * renderers with the same settings share the points.
+ * Background points are gray, users cycle through red, green and blue by id,
+ * like the tracker renderer's depth image; nearer points are brighter.
+ *
+ * viewMatrix is applied in world space (mm) around a point 3 m in front of the
+ * sensor; the result is then fitted to the item, orthographically.
+ */
+class QNiTEPointCloudRenderer : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QObject* kinect READ kinect WRITE setKinect NOTIFY kinectChanged)
+    Q_PROPERTY(bool initialized READ initialized NOTIFY initializedChanged)
+    Q_PROPERTY(int stride READ stride WRITE setStride NOTIFY strideChanged)
+    Q_PROPERTY(qreal voxelSize READ voxelSize WRITE setVoxelSize NOTIFY voxelSizeChanged)
+    Q_PROPERTY(int userId READ userId WRITE setUserId NOTIFY userIdChanged)
+    Q_PROPERTY(int maxDepth READ maxDepth WRITE setMaxDepth NOTIFY maxDepthChanged)
+    Q_PROPERTY(QMatrix4x4 viewMatrix READ viewMatrix WRITE setViewMatrix NOTIFY viewMatrixChanged)
+
+public:
+    explicit QNiTEPointCloudRenderer(QQuickItem * parent = 0);
+    ~QNiTEPointCloudRenderer();
+
+    QObject* kinect() const
+    {
+        return m_kinect;
+    }
+
+    bool initialized() const
+    {
+        return m_initialized;
+    }
+
+    int stride() const
+    {
+        return m_stride;
+    }
+
+    qreal voxelSize() const
+    {
+        return m_voxelSize;
+    }
+
+    int userId() const
+    {
+        return m_userId;
+    }
+
+    int maxDepth() const
+    {
+        return m_maxDepth;
+    }
+
+    QMatrix4x4 viewMatrix() const
+    {
+        return m_viewMatrix;
+    }
+
+signals:
+
+    void kinectChanged(QObject* arg);
+    void initializedChanged(bool arg);
+
+    void strideChanged(int arg);
+    void voxelSizeChanged(qreal arg);
+    void userIdChanged(int arg);
+    void maxDepthChanged(int arg);
+    void viewMatrixChanged(const QMatrix4x4 & arg);
+
+public slots:
+
+    void initialize();
+    void onNewFrame();
+
+    void setKinect(QObject* arg)
+    {
+        if (m_kinect == arg)
+            return;
+
+        m_kinect = arg;
+        emit kinectChanged(arg);
+    }
+
+    void setStride(int arg)
+    {
+        arg = qMax(1, arg);
+        if (m_stride == arg)
+            return;
+
+        m_stride = arg;
+        emit strideChanged(arg);
+        updatePointCloud();
+    }
+
+    void setVoxelSize(qreal arg)
+    {
+        arg = qMax(qreal(0), arg);
+        if (m_voxelSize == arg)
+            return;
+
+        m_voxelSize = arg;
+        emit voxelSizeChanged(arg);
+        updatePointCloud();
+    }
+
+    void setUserId(int arg)
+    {
+        arg = qMax(int(QNiTEPointCloud::AllPixels), arg);
+        if (m_userId == arg)
+            return;
+
+        m_userId = arg;
+        emit userIdChanged(arg);
+        updatePointCloud();
+    }
+
+    void setMaxDepth(int arg)
+    {
+        arg = qMax(0, arg);
+        if (m_maxDepth == arg)
+            return;
+
+        m_maxDepth = arg;
+        emit maxDepthChanged(arg);
+        updatePointCloud();
+    }
+
+    void setViewMatrix(const QMatrix4x4 & arg)
+    {
+        if (m_viewMatrix == arg)
+            return;
+
+        m_viewMatrix = arg;
+        emit viewMatrixChanged(arg);
+        update();
+    }
+
+protected:
+    virtual QSGNode * updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *);
+
+private:
+    // hands the settings to QNiTE, which applies them from its next frame on
+    void updatePointCloud();
+    QNiTEPointCloudSettings pointCloudSettings() const;
+
+    void setInitialized(bool arg)
+    {
+        if (m_initialized == arg)
+            return;
+
+        m_initialized = arg;
+        emit initializedChanged(arg);
+    }
+
+    QPointer<QNiTE> m_qnite; // may go first, and is told to drop this cloud if not
+    int m_pointCloudId; // 0 until initialized
+    QObject* m_kinect;
+    bool m_initialized;
+    bool m_frameDirty;
+
+    int m_stride;
+    qreal m_voxelSize;
+    int m_userId;
+    int m_maxDepth;
+    QMatrix4x4 m_viewMatrix;
+};
+
+#endif // QNITEPOINTCLOUDRENDERER_H
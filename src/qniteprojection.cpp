@@ -0,0 +1,118 @@
+#include "qniteprojection.h"
+
+#include <QtMath>
+
+#include "qnitecpu.h"
+
+// pixels per unit of x/z and y/z, and the image center
+struct ProjectionFactors
+{
+    float scaleX;
+    float scaleY;
+    float centerX;
+    float centerY;
+};
+
+static ProjectionFactors factorsOf(const QNiTEDepthIntrinsics & intrinsics)
+{
+    ProjectionFactors factors;
+
+    if (!intrinsics.isValid())
+    {
+        factors.scaleX = factors.scaleY = factors.centerX = factors.centerY = 0;
+        return factors;
+    }
+
+    factors.scaleX = intrinsics.resolutionX / (2 * qTan(intrinsics.horizontalFov / 2));
+    factors.scaleY = intrinsics.resolutionY / (2 * qTan(intrinsics.verticalFov / 2));
+    factors.centerX = intrinsics.resolutionX * 0.5f;
+    factors.centerY = intrinsics.resolutionY * 0.5f;
+    return factors;
+}
+
+static void projectScalar(const ProjectionFactors & f, const float * x, const float * y, const float * z,
+                          float * outX, float * outY, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (z[i] <= 0)
+        {
+            outX[i] = outY[i] = 0;
+            continue;
+        }
+
+        const float invZ = 1.0f / z[i];
+        outX[i] = f.centerX + x[i] * invZ * f.scaleX;
+        outY[i] = f.centerY - y[i] * invZ * f.scaleY;
+    }
+}
+
+#ifdef QNITE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void projectSSE2(const ProjectionFactors & f, const float * x, const float * y, const float * z,
+                        float * outX, float * outY, int count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scaleX = _mm_set1_ps(f.scaleX);
+    const __m128 scaleY = _mm_set1_ps(f.scaleY);
+    const __m128 centerX = _mm_set1_ps(f.centerX);
+    const __m128 centerY = _mm_set1_ps(f.centerY);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 depth = _mm_loadu_ps(z + i);
+        const __m128 inFront = _mm_cmpgt_ps(depth, zero);
+
+        // a true division, so the results match the scalar kernel bit for bit
+        const __m128 invZ = _mm_div_ps(one, depth);
+
+        __m128 px = _mm_add_ps(centerX, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(x + i), invZ), scaleX));
+        __m128 py = _mm_sub_ps(centerY, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(y + i), invZ), scaleY));
+
+        _mm_storeu_ps(outX + i, _mm_and_ps(px, inFront));
+        _mm_storeu_ps(outY + i, _mm_and_ps(py, inFront));
+    }
+
+    projectScalar(f, x + i, y + i, z + i, outX + i, outY + i, count - i);
+}
+
+#endif // QNITE_X86_SIMD
+
+typedef void (*ProjectFunction)(const ProjectionFactors &, const float *, const float *, const float *, float *, float *, int);
+
+struct ProjectKernel
+{
+    ProjectFunction function;
+    const char * name;
+    int features;
+};
+
+static const ProjectKernel s_projectKernels[] = {
+#ifdef QNITE_X86_SIMD
+    { projectSSE2, "sse2", QNiTECpuSSE2 },
+#endif
+    { projectScalar, "scalar", 0 }
+};
+
+QPointF qniteProjectToDepth(const QNiTEDepthIntrinsics & intrinsics, const QVector3D & point)
+{
+    const float x = point.x(), y = point.y(), z = point.z();
+    float outX, outY;
+
+    projectScalar(factorsOf(intrinsics), &x, &y, &z, &outX, &outY, 1);
+    return QPointF(outX, outY);
+}
+
+void qniteProjectToDepth(const QNiTEDepthIntrinsics & intrinsics, const float * x, const float * y, const float * z,
+                         float * outX, float * outY, int count)
+{
+    qniteSelectKernel(s_projectKernels).function(factorsOf(intrinsics), x, y, z, outX, outY, count);
+}
+
+const char * qniteProjectionImplementation()
+{
+    return qniteSelectKernel(s_projectKernels).name;
+}
@@ -0,0 +1,27 @@
+#ifndef QNITEPROJECTION_H
+#define QNITEPROJECTION_H
+
+#include <QPointF>
+#include <QVector3D>
+
+#include "qniteframe.h"
+
+/*
+ * World space (mm) to depth image pixels, the same pinhole model as OpenNI's
+ * CoordinateConverter::convertWorldToDepth, from intrinsics cached when the
+ * source opened instead of a NiTE call per point. Points at z <= 0 map to 0, 0.
+ */
+QPointF qniteProjectToDepth(const QNiTEDepthIntrinsics & intrinsics, const QVector3D & point);
+
+/*
+ * Projects count points, given as separate x, y and z arrays, in one pass.
+ *
+ * Runs on SSE2 where the CPU has it (see qnitecpu.h).
+ */
+void qniteProjectToDepth(const QNiTEDepthIntrinsics & intrinsics, const float * x, const float * y, const float * z,
+                         float * outX, float * outY, int count);
+
+// "sse2" or "scalar", for the batch projection
+const char * qniteProjectionImplementation();
+
+#endif // QNITEPROJECTION_H
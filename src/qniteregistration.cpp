@@ -0,0 +1,304 @@
+#include "qniteregistration.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "qnitecpu.h"
+#include "qniteframesource.h"
+
+// the source's converter is sampled every this many depth pixels, and interpolated in between
+static const int s_gridStep = 8;
+
+// far apart, so the parallax stands out from converters that round to whole pixels
+static const quint16 s_nearSample = 500;
+static const quint16 s_farSample = 8000;
+
+QNiTERegistrationTable::QNiTERegistrationTable(int depthWidth, int depthHeight, int colorWidth, int colorHeight)
+{
+    m_depthWidth = qMax(depthWidth, 0);
+    m_depthHeight = qMax(depthHeight, 0);
+    m_colorWidth = qMax(colorWidth, 0);
+    m_colorHeight = qMax(colorHeight, 0);
+
+    m_baseX.resize(m_depthWidth * m_depthHeight);
+    m_baseY.resize(m_depthWidth * m_depthHeight);
+    m_shiftX = m_shiftY = 0;
+
+    for (int y = 0, i = 0; y < m_depthHeight; ++y)
+    {
+        for (int x = 0; x < m_depthWidth; ++x, ++i)
+        {
+            m_baseX[i] = x;
+            m_baseY[i] = y;
+        }
+    }
+}
+
+static float median(QVector<float> values)
+{
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+QSharedPointer<const QNiTERegistrationTable> QNiTERegistrationTable::build(const QNiTEFrameSource & source, int depthWidth, int depthHeight, int colorWidth, int colorHeight)
+{
+    QSharedPointer<QNiTERegistrationTable> table(new QNiTERegistrationTable(depthWidth, depthHeight, colorWidth, colorHeight));
+
+    if (depthWidth <= 0 || depthHeight <= 0 || colorWidth <= 0 || colorHeight <= 0)
+        return table;
+
+    const int columns = (depthWidth - 1 + s_gridStep - 1) / s_gridStep + 1;
+    const int rows = (depthHeight - 1 + s_gridStep - 1) / s_gridStep + 1;
+
+    // color pixels to registered pixels
+    const float scaleX = float(depthWidth) / colorWidth;
+    const float scaleY = float(depthHeight) / colorHeight;
+
+    QVector<QPointF> nearSamples(columns * rows), farSamples(columns * rows);
+    QVector<float> shiftsX(columns * rows), shiftsY(columns * rows);
+    const float inverseSpan = 1.0f / (1.0f / s_nearSample - 1.0f / s_farSample);
+
+    for (int r = 0, i = 0; r < rows; ++r)
+    {
+        const int y = qMin(r * s_gridStep, depthHeight - 1);
+
+        for (int c = 0; c < columns; ++c, ++i)
+        {
+            const int x = qMin(c * s_gridStep, depthWidth - 1);
+
+            if (!source.depthToColor(x, y, s_nearSample, &nearSamples[i]) || !source.depthToColor(x, y, s_farSample, &farSamples[i]))
+                return table;
+
+            shiftsX[i] = (nearSamples[i].x() - farSamples[i].x()) * inverseSpan;
+            shiftsY[i] = (nearSamples[i].y() - farSamples[i].y()) * inverseSpan;
+        }
+    }
+
+    // the baseline is the same for every pixel, so one shift each fits them all
+    const float shiftX = median(shiftsX);
+    const float shiftY = median(shiftsY);
+    const float meanInverse = 0.5f * (1.0f / s_nearSample + 1.0f / s_farSample);
+
+    QVector<float> gridX(columns * rows), gridY(columns * rows);
+    for (int i = 0; i < gridX.size(); ++i)
+    {
+        gridX[i] = (0.5f * (nearSamples[i].x() + farSamples[i].x()) - shiftX * meanInverse) * scaleX;
+        gridY[i] = (0.5f * (nearSamples[i].y() + farSamples[i].y()) - shiftY * meanInverse) * scaleY;
+    }
+
+    table->m_shiftX = shiftX * scaleX;
+    table->m_shiftY = shiftY * scaleY;
+
+    for (int y = 0, i = 0; y < depthHeight; ++y)
+    {
+        const int r = qMin(y / s_gridStep, qMax(rows - 2, 0));
+        const int y0 = qMin(r * s_gridStep, depthHeight - 1);
+        const int y1 = qMin((r + 1) * s_gridStep, depthHeight - 1);
+        const float fy = y1 > y0 ? float(y - y0) / (y1 - y0) : 0.0f;
+        const int r1 = qMin(r + 1, rows - 1);
+
+        for (int x = 0; x < depthWidth; ++x, ++i)
+        {
+            const int c = qMin(x / s_gridStep, qMax(columns - 2, 0));
+            const int x0 = qMin(c * s_gridStep, depthWidth - 1);
+            const int x1 = qMin((c + 1) * s_gridStep, depthWidth - 1);
+            const float fx = x1 > x0 ? float(x - x0) / (x1 - x0) : 0.0f;
+            const int c1 = qMin(c + 1, columns - 1);
+
+            const int a = r * columns + c, b = r * columns + c1;
+            const int d = r1 * columns + c, e = r1 * columns + c1;
+
+            table->m_baseX[i] = (gridX[a] * (1 - fx) + gridX[b] * fx) * (1 - fy) + (gridX[d] * (1 - fx) + gridX[e] * fx) * fy;
+            table->m_baseY[i] = (gridY[a] * (1 - fx) + gridY[b] * fx) * (1 - fy) + (gridY[d] * (1 - fx) + gridY[e] * fx) * fy;
+        }
+    }
+
+    return table;
+}
+
+QPointF QNiTERegistrationTable::map(const QPointF & depthPixel, float z) const
+{
+    if (m_baseX.isEmpty())
+        return depthPixel;
+
+    const int x = qBound(0, qRound(depthPixel.x()), m_depthWidth - 1);
+    const int y = qBound(0, qRound(depthPixel.y()), m_depthHeight - 1);
+    const int i = y * m_depthWidth + x;
+
+    // the base is only known per pixel, the fraction carries over as is
+    float px = m_baseX[i] + float(depthPixel.x() - x);
+    float py = m_baseY[i] + float(depthPixel.y() - y);
+
+    if (z > 0)
+    {
+        px += m_shiftX / z;
+        py += m_shiftY / z;
+    }
+
+    return QPointF(px, py);
+}
+
+/*
+ * Registered pixel index of each depth pixel of a row, or -1 for pixels without
+ * depth or that land outside the image. The bounds are checked in floating point,
+ * before anything is rounded, so both kernels agree on every pixel.
+ */
+static void targetsScalar(const quint16 * depth, const float * baseX, const float * baseY, float shiftX, float shiftY,
+                          int width, int height, qint32 * out, int count)
+{
+    const float maxX = width - 0.5f;
+    const float maxY = height - 0.5f;
+
+    for (int i = 0; i < count; ++i)
+    {
+        out[i] = -1;
+
+        if (!depth[i])
+            continue;
+
+        const float inverse = 1.0f / depth[i];
+        const float x = baseX[i] + shiftX * inverse;
+        const float y = baseY[i] + shiftY * inverse;
+
+        if (x > -0.5f && x < maxX && y > -0.5f && y < maxY)
+            out[i] = qint32(y + 0.5f) * width + qint32(x + 0.5f);
+    }
+}
+
+#ifdef QNITE_X86_SIMD
+
+__attribute__((target("sse2")))
+static inline __m128i targetsOf4(__m128i z32, const float * baseX, const float * baseY, __m128 shiftX, __m128 shiftY,
+                                 __m128 maxX, __m128 maxY, __m128 width)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 minusHalf = _mm_set1_ps(-0.5f);
+
+    const __m128 z = _mm_cvtepi32_ps(z32);
+    const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), z);
+    const __m128 x = _mm_add_ps(_mm_loadu_ps(baseX), _mm_mul_ps(shiftX, inverse));
+    const __m128 y = _mm_add_ps(_mm_loadu_ps(baseY), _mm_mul_ps(shiftY, inverse));
+
+    // comparisons with NaN are false, so pixels without depth drop out here as well
+    __m128 inside = _mm_cmpgt_ps(z, _mm_setzero_ps());
+    inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(x, minusHalf), _mm_cmplt_ps(x, maxX)));
+    inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(y, minusHalf), _mm_cmplt_ps(y, maxY)));
+
+    // SSE2 has no 32 bit integer multiply; row * width + column is exact in floats up to 16M pixels
+    const __m128 column = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(x, half)));
+    const __m128 row = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(y, half)));
+    const __m128i index = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(row, width), column));
+
+    const __m128i mask = _mm_castps_si128(inside);
+    return _mm_or_si128(_mm_and_si128(mask, index), _mm_andnot_si128(mask, _mm_set1_epi32(-1)));
+}
+
+__attribute__((target("sse2")))
+static void targetsSSE2(const quint16 * depth, const float * baseX, const float * baseY, float shiftX, float shiftY,
+                        int width, int height, qint32 * out, int count)
+{
+    const __m128 sx = _mm_set1_ps(shiftX);
+    const __m128 sy = _mm_set1_ps(shiftY);
+    const __m128 maxX = _mm_set1_ps(width - 0.5f);
+    const __m128 maxY = _mm_set1_ps(height - 0.5f);
+    const __m128 w = _mm_set1_ps(float(width));
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth + i));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         targetsOf4(_mm_unpacklo_epi16(z, zero), baseX + i, baseY + i, sx, sy, maxX, maxY, w));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4),
+                         targetsOf4(_mm_unpackhi_epi16(z, zero), baseX + i + 4, baseY + i + 4, sx, sy, maxX, maxY, w));
+    }
+
+    targetsScalar(depth + i, baseX + i, baseY + i, shiftX, shiftY, width, height, out + i, count - i);
+}
+
+#endif // QNITE_X86_SIMD
+
+typedef void (*TargetsFunction)(const quint16 *, const float *, const float *, float, float, int, int, qint32 *, int);
+
+struct TargetsKernel
+{
+    TargetsFunction function;
+    const char * name;
+    int features;
+};
+
+static const TargetsKernel s_targetsKernels[] = {
+#ifdef QNITE_X86_SIMD
+    { targetsSSE2, "sse2", QNiTECpuSSE2 },
+#endif
+    { targetsScalar, "scalar", 0 }
+};
+
+QNiTEDepthRegistration::QNiTEDepthRegistration()
+{
+    m_width = m_height = 0;
+}
+
+bool QNiTEDepthRegistration::apply(const QNiTERegistrationTable & table, const QNiTETrackerFrame & frame)
+{
+    if (!frame.depth || frame.resolutionX != table.depthWidth() || frame.resolutionY != table.depthHeight() ||
+        frame.cropOriginX + frame.width > frame.resolutionX || frame.cropOriginY + frame.height > frame.resolutionY)
+        return false;
+
+    m_width = table.depthWidth();
+    m_height = table.depthHeight();
+
+    const int size = m_width * m_height;
+    if (m_depth.size() < size)
+    {
+        m_depth.resize(size);
+        m_labels.resize(size);
+    }
+
+    if (m_targets.size() < frame.width)
+        m_targets.resize(frame.width);
+
+    quint16 * depthOut = m_depth.data();
+    qint16 * labelsOut = m_labels.data();
+    qint32 * targets = m_targets.data();
+
+    memset(depthOut, 0, size * sizeof(quint16));
+    memset(labelsOut, 0, size * sizeof(qint16));
+
+    const TargetsFunction targetsOf = qniteSelectKernel(s_targetsKernels).function;
+    const int rowSize = frame.depthStride / sizeof(quint16);
+
+    for (int y = 0; y < frame.height; ++y)
+    {
+        const quint16 * depth = frame.depth + y * rowSize;
+        const qint16 * labels = frame.labels ? frame.labels + y * frame.width : 0;
+        const int first = (frame.cropOriginY + y) * m_width + frame.cropOriginX;
+
+        targetsOf(depth, table.baseX() + first, table.baseY() + first, table.shiftX(), table.shiftY(),
+                  m_width, m_height, targets, frame.width);
+
+        // scattered, so this part stays scalar; the nearest surface wins
+        for (int x = 0; x < frame.width; ++x)
+        {
+            const qint32 target = targets[x];
+            if (target < 0)
+                continue;
+
+            const quint16 z = depth[x];
+            if (depthOut[target] && depthOut[target] <= z)
+                continue;
+
+            depthOut[target] = z;
+            labelsOut[target] = labels ? labels[x] : 0;
+        }
+    }
+
+    return true;
+}
+
+const char * qniteRegistrationImplementation()
+{
+    return qniteSelectKernel(s_targetsKernels).name;
+}
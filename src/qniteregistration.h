@@ -0,0 +1,148 @@
+#ifndef QNITEREGISTRATION_H
+#define QNITEREGISTRATION_H
+
+#include <QPointF>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "qniteframe.h"
+
+class QNiTEFrameSource;
+
+/*
+ * Where every pixel of a depth video mode shows up on the color image.
+ *
+ * The depth and color cameras sit a few centimeters apart, so depth pixel (x, y)
+ * at depth z (mm) lands on
+ *
+ *     (baseX(x, y) + shiftX / z, baseY(x, y) + shiftY / z)
+ *
+ * The bases take care of the lenses and resolutions, and the shifts are the
+ * parallax of the baseline between the cameras. build() fits them once per pair of
+ * video modes from the source's own converter, sampled on a coarse grid.
+ *
+ * Color coordinates are scaled down to the depth resolution, so registered maps
+ * are as big as the depth image and stretch over the color image just like it.
+ */
+class QNiTERegistrationTable
+{
+public:
+    // plain scaling, as if both cameras were in the same place
+    QNiTERegistrationTable(int depthWidth, int depthHeight, int colorWidth, int colorHeight);
+
+    // the source's mapping, or plain scaling if it cannot tell
+    static QSharedPointer<const QNiTERegistrationTable> build(const QNiTEFrameSource & source, int depthWidth, int depthHeight, int colorWidth, int colorHeight);
+
+    bool matches(int depthWidth, int depthHeight, int colorWidth, int colorHeight) const
+    {
+        return m_depthWidth == depthWidth && m_depthHeight == depthHeight && m_colorWidth == colorWidth && m_colorHeight == colorHeight;
+    }
+
+    int depthWidth() const
+    {
+        return m_depthWidth;
+    }
+
+    int depthHeight() const
+    {
+        return m_depthHeight;
+    }
+
+    int colorWidth() const
+    {
+        return m_colorWidth;
+    }
+
+    int colorHeight() const
+    {
+        return m_colorHeight;
+    }
+
+    // depthWidth * depthHeight each, in registered pixels
+    const float * baseX() const
+    {
+        return m_baseX.constData();
+    }
+
+    const float * baseY() const
+    {
+        return m_baseY.constData();
+    }
+
+    // registered pixels times millimeters
+    float shiftX() const
+    {
+        return m_shiftX;
+    }
+
+    float shiftY() const
+    {
+        return m_shiftY;
+    }
+
+    // depth image pixel at depth z (mm) to registered pixels
+    QPointF map(const QPointF & depthPixel, float z) const;
+
+private:
+    int m_depthWidth;
+    int m_depthHeight;
+    int m_colorWidth;
+    int m_colorHeight;
+
+    QVector<float> m_baseX;
+    QVector<float> m_baseY;
+    float m_shiftX;
+    float m_shiftY;
+};
+
+/*
+ * Moves the depth and user labels of tracker frames onto the color image, through
+ * a QNiTERegistrationTable.
+ *
+ * Where several depth pixels land on the same registered pixel the nearest one
+ * wins, and registered pixels nothing lands on are left at depth 0 and label 0,
+ * like the shadows in the depth image itself. The target of every pixel is worked
+ * out with SSE2 where available; the buffers only grow and are reused.
+ */
+class QNiTEDepthRegistration
+{
+public:
+    QNiTEDepthRegistration();
+
+    // false, leaving the maps as they were, if frame is not in the table's depth video mode
+    bool apply(const QNiTERegistrationTable & table, const QNiTETrackerFrame & frame);
+
+    int width() const
+    {
+        return m_width;
+    }
+
+    int height() const
+    {
+        return m_height;
+    }
+
+    // width * height each, tightly packed
+    const quint16 * depth() const
+    {
+        return m_depth.constData();
+    }
+
+    const qint16 * labels() const
+    {
+        return m_labels.constData();
+    }
+
+private:
+    int m_width;
+    int m_height;
+
+    QVector<quint16> m_depth;
+    QVector<qint16> m_labels;
+    QVector<qint32> m_targets; // one row
+};
+
+// "sse2" or "scalar", for where QNiTEDepthRegistration sends each pixel
+const char * qniteRegistrationImplementation();
+
+#endif // QNITEREGISTRATION_H
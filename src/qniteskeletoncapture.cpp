@@ -0,0 +1,339 @@
+#include "qniteskeletoncapture.h"
+
+#include <limits.h>
+#include <string.h>
+
+static const char s_magic[8] = { 'Q', 'N', 'S', 'K', 'E', 'L', 0, 0 };
+static const quint32 s_version = 1;
+
+static inline void storeVector(float * out, const QVector3D & v)
+{
+    out[0] = v.x();
+    out[1] = v.y();
+    out[2] = v.z();
+}
+
+static inline QVector3D loadVector(const float * in)
+{
+    return QVector3D(in[0], in[1], in[2]);
+}
+
+qint64 qniteSkeletonRecordSize(int maxUsers)
+{
+    return sizeof(QNiTESkeletonCaptureFrame) + qint64(maxUsers) * sizeof(QNiTESkeletonCaptureUser);
+}
+
+static void storeUser(const QNiTEUserData & user, QNiTESkeletonCaptureUser * u)
+{
+    u->id = user.id;
+    u->flags = (user.isNew ? QNiTESkeletonCaptureUser::New : 0) |
+               (user.isLost ? QNiTESkeletonCaptureUser::Lost : 0) |
+               (user.isVisible ? QNiTESkeletonCaptureUser::Visible : 0) |
+               (user.skeletonTracked ? QNiTESkeletonCaptureUser::SkeletonTracked : 0);
+
+    storeVector(u->centerOfMass, user.centerOfMass);
+    storeVector(u->boundingMin, user.boundingMin);
+    storeVector(u->boundingMax, user.boundingMax);
+
+    for(int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        storeVector(u->joints[j], user.joints[j].position);
+        u->joints[j][3] = user.joints[j].confidence;
+    }
+
+    u->reserved = 0;
+}
+
+int qniteStoreSkeletonRecord(const QNiTETrackerFrame & frame, int maxUsers, uchar * record)
+{
+    QNiTESkeletonCaptureFrame * out = reinterpret_cast<QNiTESkeletonCaptureFrame *>(record);
+    QNiTESkeletonCaptureUser * outUsers = reinterpret_cast<QNiTESkeletonCaptureUser *>(record + sizeof(QNiTESkeletonCaptureFrame));
+
+    int userCount = 0;
+
+    // present users first, then the lost ones in what is left
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(int i = 0; i < frame.users.size() && userCount < maxUsers; ++i)
+        {
+            const QNiTEUserData & user = frame.users[i];
+            if(user.isLost == (pass == 0))
+                continue;
+
+            storeUser(user, &outUsers[userCount++]);
+        }
+    }
+
+    const int dropped = frame.users.size() - userCount;
+
+    out->frameIndex = frame.frameIndex;
+    out->userCount = userCount;
+    out->timestamp = frame.timestamp;
+    storeVector(out->floorPoint, frame.floorPoint);
+    storeVector(out->floorNormal, frame.floorNormal);
+    out->floorConfidence = frame.floorConfidence;
+    out->droppedUsers = dropped;
+
+    return dropped;
+}
+
+void qniteLoadSkeletonRecord(const uchar * record, int maxUsers, QVector<QNiTEUserData> * users)
+{
+    const QNiTESkeletonCaptureFrame * f = reinterpret_cast<const QNiTESkeletonCaptureFrame *>(record);
+    const QNiTESkeletonCaptureUser * u = reinterpret_cast<const QNiTESkeletonCaptureUser *>(f + 1);
+
+    const int count = qMin<quint32>(f->userCount, maxUsers);
+    users->resize(count);
+
+    for(int i = 0; i < count; ++i, ++u)
+    {
+        QNiTEUserData & data = (*users)[i];
+
+        data.id = u->id;
+        data.isNew = u->flags & QNiTESkeletonCaptureUser::New;
+        data.isLost = u->flags & QNiTESkeletonCaptureUser::Lost;
+        data.isVisible = u->flags & QNiTESkeletonCaptureUser::Visible;
+        data.skeletonTracked = u->flags & QNiTESkeletonCaptureUser::SkeletonTracked;
+
+        data.centerOfMass = loadVector(u->centerOfMass);
+        data.boundingMin = loadVector(u->boundingMin);
+        data.boundingMax = loadVector(u->boundingMax);
+
+        for(int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        {
+            data.joints[j].position = loadVector(u->joints[j]);
+            data.joints[j].confidence = u->joints[j][3];
+        }
+    }
+}
+
+QNiTESkeletonWriter::QNiTESkeletonWriter(int maxUsers) :
+    m_maxUsers(qMax(maxUsers, 1)),
+    m_recordSize(qniteSkeletonRecordSize(m_maxUsers)),
+    m_header(0),
+    m_chunk(0),
+    m_chunkFirst(0),
+    m_frameCount(0),
+    m_truncatedFrames(0)
+{
+}
+
+QNiTESkeletonWriter::~QNiTESkeletonWriter()
+{
+    close();
+}
+
+bool QNiTESkeletonWriter::open(const QString & fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_frameCount = 0;
+    m_truncatedFrames = 0;
+
+    if(!mapChunk(0))
+    {
+        m_file.close();
+        return false;
+    }
+
+    memset(m_header, 0, sizeof(QNiTESkeletonCaptureHeader));
+    memcpy(m_header->magic, s_magic, sizeof(s_magic));
+    m_header->version = s_version;
+    m_header->headerSize = sizeof(QNiTESkeletonCaptureHeader);
+    m_header->recordSize = m_recordSize;
+    m_header->maxUsers = m_maxUsers;
+
+    m_errorString.clear();
+    return true;
+}
+
+void QNiTESkeletonWriter::close()
+{
+    if(!isOpen())
+        return;
+
+    unmapAll();
+
+    // drop the unused tail of the last chunk
+    m_file.resize(sizeof(QNiTESkeletonCaptureHeader) + m_frameCount * m_recordSize);
+    m_file.close();
+}
+
+void QNiTESkeletonWriter::setMaxUsers(int maxUsers)
+{
+    if(isOpen())
+    {
+        qDebug("[QNiTESkeletonWriter::setMaxUsers] Already open, ignoring.");
+        return;
+    }
+
+    m_maxUsers = qMax(maxUsers, 1);
+    m_recordSize = qniteSkeletonRecordSize(m_maxUsers);
+}
+
+bool QNiTESkeletonWriter::append(const QNiTETrackerFrame & frame)
+{
+    if(!isOpen())
+        return false;
+
+    if(m_frameCount >= m_chunkFirst + ChunkRecords && !mapChunk(m_frameCount))
+    {
+        // the file is unusable past this point
+        unmapAll();
+        m_file.close();
+        return false;
+    }
+
+    uchar * record = m_chunk + (m_frameCount - m_chunkFirst) * m_recordSize;
+    // unused user slots are left alone, freshly grown file space reads as zeros
+    const int dropped = qniteStoreSkeletonRecord(frame, m_maxUsers, record);
+
+    if(dropped > 0 && m_truncatedFrames++ == 0)
+        qDebug("[QNiTESkeletonWriter::append] Frame %d has %d users, %d did not fit", frame.frameIndex, frame.users.size(), dropped);
+
+    // only count the record once it is complete, so a crash leaves a readable file
+    m_header->frameCount = ++m_frameCount;
+    return true;
+}
+
+bool QNiTESkeletonWriter::mapChunk(quint64 firstRecord)
+{
+    // mappings must go before the file is resized, some platforms refuse otherwise
+    unmapAll();
+
+    const qint64 headerSize = sizeof(QNiTESkeletonCaptureHeader);
+    const qint64 chunkOffset = headerSize + qint64(firstRecord) * m_recordSize;
+    const qint64 chunkSize = qint64(ChunkRecords) * m_recordSize;
+
+    if(!m_file.resize(chunkOffset + chunkSize))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_header = reinterpret_cast<QNiTESkeletonCaptureHeader *>(m_file.map(0, headerSize));
+    m_chunk = m_file.map(chunkOffset, chunkSize);
+
+    if(!m_header || !m_chunk)
+    {
+        m_errorString = m_file.errorString();
+        unmapAll();
+        return false;
+    }
+
+    m_chunkFirst = firstRecord;
+    return true;
+}
+
+void QNiTESkeletonWriter::unmapAll()
+{
+    if(m_chunk)
+        m_file.unmap(m_chunk);
+
+    if(m_header)
+        m_file.unmap(reinterpret_cast<uchar *>(m_header));
+
+    m_chunk = 0;
+    m_header = 0;
+}
+
+QNiTESkeletonReader::QNiTESkeletonReader() :
+    m_data(0),
+    m_headerSize(0),
+    m_recordSize(0),
+    m_maxUsers(0),
+    m_frameCount(0)
+{
+}
+
+QNiTESkeletonReader::~QNiTESkeletonReader()
+{
+    close();
+}
+
+bool QNiTESkeletonReader::open(const QString & fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::ReadOnly))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar * data = size >= qint64(sizeof(QNiTESkeletonCaptureHeader)) ? m_file.map(0, size) : 0;
+    const QNiTESkeletonCaptureHeader * header = reinterpret_cast<const QNiTESkeletonCaptureHeader *>(data);
+
+    if(!header ||
+       memcmp(header->magic, s_magic, sizeof(s_magic)) != 0 ||
+       header->version != s_version ||
+       header->headerSize < sizeof(QNiTESkeletonCaptureHeader) ||
+       qint64(header->headerSize) > size ||
+       header->maxUsers < 1 ||
+       header->recordSize != qniteSkeletonRecordSize(header->maxUsers))
+    {
+        m_errorString = QStringLiteral("Not a skeleton capture file");
+        m_file.close();
+        return false;
+    }
+
+    m_data = data;
+    m_headerSize = header->headerSize;
+    m_recordSize = header->recordSize;
+    m_maxUsers = header->maxUsers;
+
+    // the header count may run ahead of the file if it was copied while being written
+    const quint64 available = quint64(size - m_headerSize) / m_recordSize;
+    m_frameCount = int(qMin<quint64>(qMin(header->frameCount, available), INT_MAX));
+
+    m_errorString.clear();
+    return true;
+}
+
+void QNiTESkeletonReader::close()
+{
+    if(!isOpen())
+        return;
+
+    m_file.unmap(const_cast<uchar *>(m_data));
+    m_file.close();
+
+    m_data = 0;
+    m_frameCount = 0;
+}
+
+const QNiTESkeletonCaptureFrame * QNiTESkeletonReader::frame(int index) const
+{
+    if(index < 0 || index >= m_frameCount)
+        return 0;
+
+    return reinterpret_cast<const QNiTESkeletonCaptureFrame *>(m_data + m_headerSize + qint64(index) * m_recordSize);
+}
+
+const QNiTESkeletonCaptureUser * QNiTESkeletonReader::user(int index, int slot) const
+{
+    const QNiTESkeletonCaptureFrame * f = frame(index);
+    if(!f || slot < 0 || quint32(slot) >= qMin<quint32>(f->userCount, m_maxUsers))
+        return 0;
+
+    return reinterpret_cast<const QNiTESkeletonCaptureUser *>(f + 1) + slot;
+}
+
+bool QNiTESkeletonReader::readUsers(int index, QVector<QNiTEUserData> * users) const
+{
+    const QNiTESkeletonCaptureFrame * f = frame(index);
+    if(!f)
+        return false;
+
+    qniteLoadSkeletonRecord(reinterpret_cast<const uchar *>(f), m_maxUsers, users);
+    return true;
+}
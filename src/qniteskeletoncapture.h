@@ -0,0 +1,196 @@
+#ifndef QNITESKELETONCAPTURE_H
+#define QNITESKELETONCAPTURE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "qniteframe.h"
+
+#define QNITE_CAPTURE_DEFAULT_USERS QNITE_MAX_USERS
+
+/*
+ * Skeleton capture files.
+ *
+ * A 64 byte header followed by fixed size records, one per tracker frame. Each
+ * record is a QNiTESkeletonCaptureFrame followed by maxUsers user slots, so frame
+ * N lives at headerSize + N * recordSize and can be reached without scanning.
+ *
+ * Values are stored in host byte order; a file from a machine of the other
+ * endianness fails the version check instead of being misread.
+ */
+
+struct QNiTESkeletonCaptureHeader
+{
+    char magic[8];       // "QNSKEL\0\0"
+    quint32 version;
+    quint32 headerSize;
+    quint32 recordSize;
+    quint32 maxUsers;
+    quint64 frameCount;  // records completely written so far
+    quint8 reserved[32];
+};
+
+struct QNiTESkeletonCaptureFrame
+{
+    qint32 frameIndex;
+    quint32 userCount;   // used slots, at most maxUsers
+    quint64 timestamp;   // sensor clock, microseconds
+
+    float floorPoint[3];
+    float floorNormal[3];
+    float floorConfidence;
+    quint32 droppedUsers; // users the frame had beyond maxUsers, not recorded
+};
+
+struct QNiTESkeletonCaptureUser
+{
+    enum Flag {
+        New = 0x1,
+        Lost = 0x2,
+        Visible = 0x4,
+        SkeletonTracked = 0x8
+    };
+
+    qint32 id;
+    quint32 flags;
+
+    float centerOfMass[3];
+    float boundingMin[3];
+    float boundingMax[3];
+
+    // x, y, z (mm), confidence; indexed by QNiTEUser::Joint
+    float joints[QNITE_JOINT_COUNT][4];
+
+    quint32 reserved;
+};
+
+Q_STATIC_ASSERT(sizeof(QNiTESkeletonCaptureHeader) == 64);
+Q_STATIC_ASSERT(sizeof(QNiTESkeletonCaptureFrame) == 48);
+Q_STATIC_ASSERT(sizeof(QNiTESkeletonCaptureUser) == 288);
+
+// a QNiTESkeletonCaptureFrame and maxUsers user slots; also used by QNiTESkeletonPublisher
+qint64 qniteSkeletonRecordSize(int maxUsers);
+
+// users that are not lost go first, so only lost ones are dropped while there are
+// maxUsers of the others; returns how many were dropped. Unused slots are left alone
+int qniteStoreSkeletonRecord(const QNiTETrackerFrame & frame, int maxUsers, uchar * record);
+
+// converts a record back to the structs QNiTEUser::update() takes
+void qniteLoadSkeletonRecord(const uchar * record, int maxUsers, QVector<QNiTEUserData> * users);
+
+// appends tracker frames to a capture file; grows and maps the file in chunks, so appending does not allocate
+class QNiTESkeletonWriter
+{
+public:
+    explicit QNiTESkeletonWriter(int maxUsers = QNITE_CAPTURE_DEFAULT_USERS);
+    ~QNiTESkeletonWriter();
+
+    // truncates an existing file
+    bool open(const QString & fileName);
+    void close();
+
+    bool isOpen() const
+    {
+        return m_header != 0;
+    }
+
+    // the record size is fixed per file, so only while closed
+    void setMaxUsers(int maxUsers);
+
+    // users beyond maxUsers are dropped from the record, and counted in its droppedUsers
+    bool append(const QNiTETrackerFrame & frame);
+
+    quint64 frameCount() const
+    {
+        return m_frameCount;
+    }
+
+    int maxUsers() const
+    {
+        return m_maxUsers;
+    }
+
+    // frames appended since open() that did not fit
+    quint64 truncatedFrames() const
+    {
+        return m_truncatedFrames;
+    }
+
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTESkeletonWriter)
+
+    enum { ChunkRecords = 512 };
+
+    bool mapChunk(quint64 firstRecord);
+    void unmapAll();
+
+    QFile m_file;
+    int m_maxUsers;
+    qint64 m_recordSize;
+
+    QNiTESkeletonCaptureHeader * m_header;
+    uchar * m_chunk;
+    quint64 m_chunkFirst;
+    quint64 m_frameCount;
+    quint64 m_truncatedFrames;
+
+    QString m_errorString;
+};
+
+// maps a whole capture file read-only; frames are addressed by record number
+class QNiTESkeletonReader
+{
+public:
+    QNiTESkeletonReader();
+    ~QNiTESkeletonReader();
+
+    bool open(const QString & fileName);
+    void close();
+
+    bool isOpen() const
+    {
+        return m_data != 0;
+    }
+
+    int frameCount() const
+    {
+        return m_frameCount;
+    }
+
+    int maxUsers() const
+    {
+        return m_maxUsers;
+    }
+
+    // null if out of range; pointers stay valid until close()
+    const QNiTESkeletonCaptureFrame * frame(int index) const;
+    const QNiTESkeletonCaptureUser * user(int index, int slot) const;
+
+    // converts a record back to the structs QNiTEUser::update() takes
+    bool readUsers(int index, QVector<QNiTEUserData> * users) const;
+
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTESkeletonReader)
+
+    QFile m_file;
+    const uchar * m_data;
+    qint64 m_headerSize;
+    qint64 m_recordSize;
+    int m_maxUsers;
+    int m_frameCount;
+
+    QString m_errorString;
+};
+
+#endif // QNITESKELETONCAPTURE_H
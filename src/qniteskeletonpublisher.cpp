@@ -0,0 +1,353 @@
+#include "qniteskeletonpublisher.h"
+
+#include <atomic>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char s_magic[8] = { 'Q', 'N', 'S', 'H', 'M', 0, 0, 0 };
+static const quint32 s_version = 1;
+
+// slots start on cache lines, so the publisher never shares one with a reader of another slot
+static inline qint64 slotSizeFor(int maxUsers)
+{
+    const qint64 size = sizeof(QNiTESkeletonShmSlot) + qniteSkeletonRecordSize(maxUsers);
+    return (size + 63) & ~qint64(63);
+}
+
+static QByteArray segmentName(const QString & name)
+{
+    QByteArray segment = name.toLocal8Bit();
+    if(!segment.startsWith('/'))
+        segment.prepend('/');
+
+    return segment;
+}
+
+#ifdef Q_OS_UNIX
+// unlinks a segment left behind under name if its publisher closed it or died; false if another one holds the name
+static bool removeClosedSegment(const QByteArray & name, QString * errorString)
+{
+    const int fd = shm_open(name.constData(), O_RDONLY, 0);
+    if(fd < 0)
+    {
+        if(errno == ENOENT)
+            return true;
+
+        *errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    void * data = MAP_FAILED;
+    if(fstat(fd, &info) == 0 && info.st_size >= qint64(sizeof(QNiTESkeletonShmHeader)))
+        data = mmap(0, sizeof(QNiTESkeletonShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    const QNiTESkeletonShmHeader * header = data != MAP_FAILED ? static_cast<const QNiTESkeletonShmHeader *>(data) : 0;
+    const bool valid = header && memcmp(header->magic, s_magic, sizeof(s_magic)) == 0;
+    const bool closed = valid && header->closed.loadAcquire();
+
+    // a publisher that crashed never set closed; ESRCH means no process has its pid anymore
+    const bool orphaned = valid && !closed && header->publisherPid > 0 &&
+                          kill(header->publisherPid, 0) != 0 && errno == ESRCH;
+
+    if(data != MAP_FAILED)
+        munmap(data, sizeof(QNiTESkeletonShmHeader));
+
+    if(!closed && !orphaned)
+    {
+        *errorString = QStringLiteral("Segment %1 is in use by a running publisher").arg(QString::fromLocal8Bit(name.constData()));
+        return false;
+    }
+
+    shm_unlink(name.constData());
+    return true;
+}
+#endif
+
+QNiTESkeletonPublisher::QNiTESkeletonPublisher(int maxUsers, int slotCount) :
+    m_maxUsers(qMax(maxUsers, 1)),
+    m_slotCount(qMax(slotCount, 2)),
+    m_slotSize(slotSizeFor(m_maxUsers)),
+    m_header(0),
+    m_size(0),
+    m_published(0)
+{
+}
+
+QNiTESkeletonPublisher::~QNiTESkeletonPublisher()
+{
+    close();
+}
+
+bool QNiTESkeletonPublisher::open(const QString & name)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    m_name = segmentName(name);
+    m_size = sizeof(QNiTESkeletonShmHeader) + m_slotCount * m_slotSize;
+
+    // a fresh segment, so readers of the previous one see it closed and reopen
+    if(!removeClosedSegment(m_name, &m_errorString))
+        return false;
+
+    const int fd = shm_open(m_name.constData(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0)
+    {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+
+    void * data = MAP_FAILED;
+    if(ftruncate(fd, m_size) == 0)
+        data = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if(data == MAP_FAILED)
+    {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        ::close(fd);
+        shm_unlink(m_name.constData());
+        return false;
+    }
+
+    ::close(fd);
+
+    // new segments read as zeros: no frames, every slot sequence at 0
+    m_header = static_cast<QNiTESkeletonShmHeader *>(data);
+    m_header->version = s_version;
+    m_header->headerSize = sizeof(QNiTESkeletonShmHeader);
+    m_header->slotSize = m_slotSize;
+    m_header->slotCount = m_slotCount;
+    m_header->maxUsers = m_maxUsers;
+    m_header->publisherPid = getpid();
+
+    // readers check the magic first, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(m_header->magic, s_magic, sizeof(s_magic));
+
+    m_published = 0;
+    m_errorString.clear();
+    return true;
+#else
+    Q_UNUSED(name)
+    m_errorString = QStringLiteral("POSIX shared memory is not available on this platform");
+    return false;
+#endif
+}
+
+void QNiTESkeletonPublisher::close()
+{
+    if(!isOpen())
+        return;
+
+#ifdef Q_OS_UNIX
+    m_header->closed.storeRelease(1);
+
+    munmap(m_header, m_size);
+    shm_unlink(m_name.constData());
+#endif
+
+    m_header = 0;
+}
+
+void QNiTESkeletonPublisher::setMaxUsers(int maxUsers)
+{
+    if(isOpen())
+    {
+        qDebug("[QNiTESkeletonPublisher::setMaxUsers] Already open, ignoring.");
+        return;
+    }
+
+    m_maxUsers = qMax(maxUsers, 1);
+    m_slotSize = slotSizeFor(m_maxUsers);
+}
+
+bool QNiTESkeletonPublisher::publish(const QNiTETrackerFrame & frame)
+{
+    if(!isOpen())
+        return false;
+
+    const quint64 number = m_published + 1;
+
+    uchar * slotData = reinterpret_cast<uchar *>(m_header + 1) + (number % m_slotCount) * m_slotSize;
+    QNiTESkeletonShmSlot * slot = reinterpret_cast<QNiTESkeletonShmSlot *>(slotData);
+
+    // odd while writing; the fence keeps the record's stores after it
+    slot->sequence.store(2 * number - 1);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    qniteStoreSkeletonRecord(frame, m_maxUsers, slotData + sizeof(QNiTESkeletonShmSlot));
+
+    slot->sequence.storeRelease(2 * number);
+    m_header->published.storeRelease(number);
+
+    m_published = number;
+    return true;
+}
+
+QNiTESkeletonSubscriber::QNiTESkeletonSubscriber() :
+    m_header(0),
+    m_size(0),
+    m_slotSize(0),
+    m_slotCount(0),
+    m_maxUsers(0)
+{
+}
+
+QNiTESkeletonSubscriber::~QNiTESkeletonSubscriber()
+{
+    close();
+}
+
+bool QNiTESkeletonSubscriber::open(const QString & name)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    const QByteArray shmName = segmentName(name);
+
+    const int fd = shm_open(shmName.constData(), O_RDONLY, 0);
+    if(fd < 0)
+    {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    void * data = MAP_FAILED;
+    if(fstat(fd, &info) == 0 && info.st_size >= qint64(sizeof(QNiTESkeletonShmHeader)))
+        data = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    const QNiTESkeletonShmHeader * header = data != MAP_FAILED ? static_cast<const QNiTESkeletonShmHeader *>(data) : 0;
+    bool valid = header && memcmp(header->magic, s_magic, sizeof(s_magic)) == 0;
+
+    if(valid)
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        valid = header->version == s_version &&
+                header->headerSize == sizeof(QNiTESkeletonShmHeader) &&
+                header->maxUsers >= 1 && header->slotCount >= 2 &&
+                header->slotSize == slotSizeFor(header->maxUsers) &&
+                header->headerSize + qint64(header->slotCount) * header->slotSize <= info.st_size;
+    }
+
+    if(!valid)
+    {
+        if(data != MAP_FAILED)
+            munmap(data, info.st_size);
+
+        m_errorString = QStringLiteral("Not a skeleton segment, or not ready yet");
+        return false;
+    }
+
+    m_header = header;
+    m_size = info.st_size;
+    m_slotSize = header->slotSize;
+    m_slotCount = header->slotCount;
+    m_maxUsers = header->maxUsers;
+
+    m_errorString.clear();
+    return true;
+#else
+    Q_UNUSED(name)
+    m_errorString = QStringLiteral("POSIX shared memory is not available on this platform");
+    return false;
+#endif
+}
+
+void QNiTESkeletonSubscriber::close()
+{
+    if(!isOpen())
+        return;
+
+#ifdef Q_OS_UNIX
+    munmap(const_cast<QNiTESkeletonShmHeader *>(m_header), m_size);
+#endif
+
+    m_header = 0;
+}
+
+quint64 QNiTESkeletonSubscriber::published() const
+{
+    return isOpen() ? m_header->published.loadAcquire() : 0;
+}
+
+bool QNiTESkeletonSubscriber::publisherClosed() const
+{
+    return isOpen() && m_header->closed.loadAcquire();
+}
+
+const QNiTESkeletonShmSlot * QNiTESkeletonSubscriber::slotOf(quint64 number) const
+{
+    const uchar * ring = reinterpret_cast<const uchar *>(m_header + 1);
+    return reinterpret_cast<const QNiTESkeletonShmSlot *>(ring + (number % m_slotCount) * m_slotSize);
+}
+
+const QNiTESkeletonCaptureFrame * QNiTESkeletonSubscriber::beginRead(quint64 number, quint64 * token) const
+{
+    if(!isOpen() || number == 0 || number > published())
+        return 0;
+
+    const QNiTESkeletonShmSlot * slot = slotOf(number);
+    const quint64 sequence = slot->sequence.loadAcquire();
+
+    // anything else is a later frame, finished or being written
+    if(sequence != 2 * number)
+        return 0;
+
+    *token = sequence;
+    return reinterpret_cast<const QNiTESkeletonCaptureFrame *>(slot + 1);
+}
+
+bool QNiTESkeletonSubscriber::endRead(quint64 number, quint64 token) const
+{
+    // keeps the record's loads before the second look at the sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotOf(number)->sequence.load() == token;
+}
+
+bool QNiTESkeletonSubscriber::read(quint64 number, QNiTESkeletonCaptureFrame * frame, QVector<QNiTEUserData> * users) const
+{
+    quint64 token;
+    const QNiTESkeletonCaptureFrame * record = beginRead(number, &token);
+    if(!record)
+        return false;
+
+    *frame = *record;
+    qniteLoadSkeletonRecord(reinterpret_cast<const uchar *>(record), m_maxUsers, users);
+
+    return endRead(number, token);
+}
+
+bool QNiTESkeletonSubscriber::readLatest(QNiTESkeletonCaptureFrame * frame, QVector<QNiTEUserData> * users, quint64 * number) const
+{
+    // losing a race means a newer frame is out, so try that one; the ring is rarely lapped twice in a row
+    for(int attempt = 0; attempt < 4; ++attempt)
+    {
+        const quint64 latest = published();
+        if(latest == 0)
+            return false;
+
+        if(read(latest, frame, users))
+        {
+            if(number)
+                *number = latest;
+            return true;
+        }
+    }
+
+    return false;
+}
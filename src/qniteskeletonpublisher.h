@@ -0,0 +1,182 @@
+#ifndef QNITESKELETONPUBLISHER_H
+#define QNITESKELETONPUBLISHER_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "qniteskeletoncapture.h"
+
+#define QNITE_SHM_DEFAULT_SLOTS 8
+
+/*
+ * Skeleton frames shared with other local processes through POSIX shared memory.
+ *
+ * The segment is a 64 byte header followed by a ring of slotCount slots. Frame n
+ * (counting from 1) goes to slot n % slotCount: a 64 byte slot header, then a
+ * skeleton capture record (see qniteskeletoncapture.h).
+ *
+ * Every slot is a seqlock. Its sequence is odd while the publisher writes it and
+ * 2n once frame n is complete, so readers never wait for the publisher and can
+ * tell a record that was overwritten while they read it. The header's published
+ * count is only raised once a frame is complete.
+ *
+ * Values are in host byte order, and the segment is only meant for processes on
+ * the same machine.
+ */
+
+struct QNiTESkeletonShmHeader
+{
+    char magic[8];        // "QNSHM\0\0\0"
+    quint32 version;
+    quint32 headerSize;
+    quint32 slotSize;     // from one slot to the next, slot header included
+    quint32 slotCount;
+    quint32 maxUsers;
+    QBasicAtomicInteger<quint32> closed;    // set once the publisher is gone
+    QBasicAtomicInteger<quint64> published; // frames published so far
+    qint32 publisherPid;  // tells a segment left by a crashed publisher from a live one
+    quint8 reserved[20];
+};
+
+struct QNiTESkeletonShmSlot
+{
+    QBasicAtomicInteger<quint64> sequence;
+    quint8 reserved[56];
+};
+
+Q_STATIC_ASSERT(sizeof(QNiTESkeletonShmHeader) == 64);
+Q_STATIC_ASSERT(sizeof(QNiTESkeletonShmSlot) == 64);
+
+// creates the segment and publishes tracker frames into it; one per segment
+class QNiTESkeletonPublisher
+{
+public:
+    explicit QNiTESkeletonPublisher(int maxUsers = QNITE_CAPTURE_DEFAULT_USERS, int slotCount = QNITE_SHM_DEFAULT_SLOTS);
+    ~QNiTESkeletonPublisher();
+
+    // a leading '/' is added if missing. Replaces a segment left behind under that name
+    // if it was closed or its publisher is gone; one that is live is an error
+    bool open(const QString & name);
+
+    // marks the segment closed and unlinks it; readers keep what they mapped
+    void close();
+
+    bool isOpen() const
+    {
+        return m_header != 0;
+    }
+
+    // the slot size is fixed per segment, so only while closed
+    void setMaxUsers(int maxUsers);
+
+    int maxUsers() const
+    {
+        return m_maxUsers;
+    }
+
+    // users beyond maxUsers are dropped from the record, and counted in its droppedUsers
+    bool publish(const QNiTETrackerFrame & frame);
+
+    quint64 published() const
+    {
+        return m_published;
+    }
+
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTESkeletonPublisher)
+
+    int m_maxUsers;
+    int m_slotCount;
+    qint64 m_slotSize;
+
+    QByteArray m_name;
+    QNiTESkeletonShmHeader * m_header;
+    qint64 m_size;
+    quint64 m_published;
+
+    QString m_errorString;
+};
+
+/*
+ * Reads a QNiTESkeletonPublisher's segment, without locks or system calls once it
+ * is open. Needs nothing from QNiTE but this file and qniteskeletoncapture.
+ *
+ * Not thread safe; use one per thread.
+ */
+class QNiTESkeletonSubscriber
+{
+public:
+    QNiTESkeletonSubscriber();
+    ~QNiTESkeletonSubscriber();
+
+    bool open(const QString & name);
+    void close();
+
+    bool isOpen() const
+    {
+        return m_header != 0;
+    }
+
+    // number of the newest complete frame, 0 if none yet
+    quint64 published() const;
+
+    // the publisher closed the segment; reopen to follow the next one
+    bool publisherClosed() const;
+
+    int maxUsers() const
+    {
+        return m_maxUsers;
+    }
+
+    int slotCount() const
+    {
+        return m_slotCount;
+    }
+
+    /*
+     * Zero copy access: the record of frame number in place, or null if it is not
+     * published yet or was already overwritten. Whatever was read from it only
+     * holds if endRead() then returns true.
+     */
+    const QNiTESkeletonCaptureFrame * beginRead(quint64 number, quint64 * token) const;
+    bool endRead(quint64 number, quint64 token) const;
+
+    // the user slots following a record from beginRead()
+    static const QNiTESkeletonCaptureUser * usersOf(const QNiTESkeletonCaptureFrame * frame)
+    {
+        return reinterpret_cast<const QNiTESkeletonCaptureUser *>(frame + 1);
+    }
+
+    // copies frame number out; false if it is not published yet or was overwritten
+    bool read(quint64 number, QNiTESkeletonCaptureFrame * frame, QVector<QNiTEUserData> * users) const;
+
+    // the newest frame; number receives which one it was
+    bool readLatest(QNiTESkeletonCaptureFrame * frame, QVector<QNiTEUserData> * users, quint64 * number = 0) const;
+
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTESkeletonSubscriber)
+
+    const QNiTESkeletonShmSlot * slotOf(quint64 number) const;
+
+    const QNiTESkeletonShmHeader * m_header;
+    qint64 m_size;
+    qint64 m_slotSize;
+    int m_slotCount;
+    int m_maxUsers;
+
+    QString m_errorString;
+};
+
+#endif // QNITESKELETONPUBLISHER_H
@@ -0,0 +1,136 @@
+#include "qniteskeletonserver.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+
+// about two seconds of deltas for a few users
+static const int s_defaultMaxBacklog = 64 * 1024;
+
+QNiTESkeletonServer::QNiTESkeletonServer(QObject * parent) : QObject(parent)
+{
+    m_server = new QLocalServer(this);
+    m_maxBacklog = s_defaultMaxBacklog;
+    m_bytesQueued = 0;
+    m_framesSkipped = 0;
+
+    connect(m_server, &QLocalServer::newConnection, this, &QNiTESkeletonServer::onNewConnection);
+}
+
+QNiTESkeletonServer::~QNiTESkeletonServer()
+{
+    close();
+}
+
+bool QNiTESkeletonServer::listen(const QString & name)
+{
+    close();
+
+    QLocalServer::removeServer(name);
+
+    if(!m_server->listen(name))
+    {
+        m_errorString = m_server->errorString();
+        return false;
+    }
+
+    m_encoder.reset();
+    m_errorString.clear();
+    return true;
+}
+
+void QNiTESkeletonServer::close()
+{
+    m_server->close();
+
+    for(int i = 0; i < m_subscribers.size(); ++i)
+    {
+        QLocalSocket * socket = m_subscribers[i].socket;
+        disconnect(socket, 0, this, 0);
+        socket->abort();
+        socket->deleteLater();
+    }
+
+    m_subscribers.clear();
+}
+
+bool QNiTESkeletonServer::isListening() const
+{
+    return m_server->isListening();
+}
+
+void QNiTESkeletonServer::onNewConnection()
+{
+    while(QLocalSocket * socket = m_server->nextPendingConnection())
+    {
+        connect(socket, &QLocalSocket::disconnected, this, &QNiTESkeletonServer::onDisconnected);
+
+        Subscriber subscriber;
+        subscriber.socket = socket;
+        subscriber.needsKeyframe = true;
+        m_subscribers.append(subscriber);
+    }
+}
+
+void QNiTESkeletonServer::onDisconnected()
+{
+    QLocalSocket * socket = qobject_cast<QLocalSocket *>(sender());
+
+    for(int i = 0; i < m_subscribers.size(); ++i)
+    {
+        if(m_subscribers[i].socket == socket)
+        {
+            m_subscribers.remove(i);
+            break;
+        }
+    }
+
+    if(socket)
+        socket->deleteLater();
+}
+
+void QNiTESkeletonServer::publish(const QNiTETrackerFrame & frame)
+{
+    if(!isListening())
+        return;
+
+    // encoded even without subscribers, so the deltas stay relative to the previous frame
+    const bool keyframe = m_encoder.encode(frame, &m_message);
+    bool keyframeReady = false;
+
+    for(int i = 0; i < m_subscribers.size(); ++i)
+    {
+        Subscriber & subscriber = m_subscribers[i];
+
+        if(subscriber.socket->bytesToWrite() > m_maxBacklog)
+        {
+            subscriber.needsKeyframe = true;
+            m_framesSkipped++;
+            continue;
+        }
+
+        if(subscriber.needsKeyframe && !keyframe)
+        {
+            // one keyframe for all the subscribers that need it this frame
+            if(!keyframeReady)
+            {
+                m_encoder.encodeKeyframe(&m_keyframe);
+                keyframeReady = true;
+            }
+
+            send(subscriber, m_keyframe);
+        }
+        else
+        {
+            send(subscriber, m_message);
+        }
+
+        subscriber.needsKeyframe = false;
+    }
+}
+
+void QNiTESkeletonServer::send(Subscriber & subscriber, const QByteArray & message)
+{
+    // only queues the bytes; the event loop writes them out
+    subscriber.socket->write(message);
+    m_bytesQueued += message.size();
+}
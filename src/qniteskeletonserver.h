@@ -0,0 +1,109 @@
+#ifndef QNITESKELETONSERVER_H
+#define QNITESKELETONSERVER_H
+
+#include <QObject>
+#include <QVector>
+
+#include "qniteskeletonstream.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+/*
+ * Serves the skeleton stream (see qniteskeletonstream.h) to any number of local
+ * subscribers over QLocalSocket.
+ *
+ * Each frame is encoded once and the same bytes are queued on every socket, which
+ * never blocks. A subscriber whose socket has more than maxBacklog bytes waiting
+ * misses frames until it catches up, and then restarts from a keyframe, so a slow
+ * one never holds back the others or the caller. New subscribers start from a
+ * keyframe as well.
+ *
+ * Lives on the thread that calls publish(); QNiTE's is the GUI thread.
+ */
+class QNiTESkeletonServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QNiTESkeletonServer(QObject * parent = 0);
+    ~QNiTESkeletonServer();
+
+    // replaces a socket left behind under that name
+    bool listen(const QString & name);
+    void close();
+
+    bool isListening() const;
+
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+    void publish(const QNiTETrackerFrame & frame);
+
+    int keyframeInterval() const
+    {
+        return m_encoder.keyframeInterval();
+    }
+
+    void setKeyframeInterval(int frames)
+    {
+        m_encoder.setKeyframeInterval(frames);
+    }
+
+    int maxBacklog() const
+    {
+        return m_maxBacklog;
+    }
+
+    // bytes
+    void setMaxBacklog(int bytes)
+    {
+        m_maxBacklog = qMax(0, bytes);
+    }
+
+    int subscriberCount() const
+    {
+        return m_subscribers.size();
+    }
+
+    // totals over every subscriber
+    quint64 bytesQueued() const
+    {
+        return m_bytesQueued;
+    }
+
+    quint64 framesSkipped() const
+    {
+        return m_framesSkipped;
+    }
+
+private slots:
+    void onNewConnection();
+    void onDisconnected();
+
+private:
+    struct Subscriber
+    {
+        QLocalSocket * socket;
+        bool needsKeyframe;
+    };
+
+    void send(Subscriber & subscriber, const QByteArray & message);
+
+    QLocalServer * m_server;
+    QVector<Subscriber> m_subscribers;
+
+    QNiTESkeletonEncoder m_encoder;
+    QByteArray m_message;
+    QByteArray m_keyframe;
+
+    int m_maxBacklog;
+    quint64 m_bytesQueued;
+    quint64 m_framesSkipped;
+
+    QString m_errorString;
+};
+
+#endif // QNITESKELETONSERVER_H
@@ -0,0 +1,490 @@
+#include "qniteskeletonstream.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+#include "qniteskeletoncapture.h"
+
+enum MessageType
+{
+    Keyframe = 1,
+    Delta = 2
+};
+
+// what a user entry carries
+enum UserField
+{
+    FlagsField = 0x1,
+    CenterField = 0x2,
+    BoundsField = 0x4,
+    JointsField = 0x8,
+    RemovedField = 0x10
+};
+
+static const int s_lengthSize = 4;
+static const float s_normalScale = 10000.0f;
+
+static inline void putByte(QByteArray * out, quint8 value)
+{
+    out->append(char(value));
+}
+
+static inline void putUnsigned(QByteArray * out, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        out->append(char(value | 0x80));
+        value >>= 7;
+    }
+    out->append(char(value));
+}
+
+static inline void putSigned(QByteArray * out, qint64 value)
+{
+    putUnsigned(out, (quint64(value) << 1) ^ quint64(value >> 63));
+}
+
+// reads a payload; any read past its end clears ok and returns zeros
+struct PayloadReader
+{
+    PayloadReader(const uchar * data, int size) : p(data), end(data + size), ok(true) {}
+
+    quint8 byte()
+    {
+        if (p >= end)
+        {
+            ok = false;
+            return 0;
+        }
+        return *p++;
+    }
+
+    quint64 unsignedValue()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64 && ok; shift += 7)
+        {
+            const quint8 b = byte();
+            value |= quint64(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return value;
+        }
+
+        ok = false;
+        return 0;
+    }
+
+    qint64 signedValue()
+    {
+        const quint64 value = unsignedValue();
+        return qint64(value >> 1) ^ -qint64(value & 1);
+    }
+
+    const uchar * p;
+    const uchar * end;
+    bool ok;
+};
+
+static inline void quantizeVector(qint32 * out, const QVector3D & v, float scale = 1.0f)
+{
+    out[0] = qRound(v.x() * scale);
+    out[1] = qRound(v.y() * scale);
+    out[2] = qRound(v.z() * scale);
+}
+
+static inline QVector3D dequantizeVector(const qint32 * in, float scale = 1.0f)
+{
+    return QVector3D(in[0] / scale, in[1] / scale, in[2] / scale);
+}
+
+static inline quint8 quantizeConfidence(float confidence)
+{
+    return quint8(qRound(qBound(0.0f, confidence, 1.0f) * 255));
+}
+
+static void quantize(const QNiTETrackerFrame & frame, QNiTESkeletonStreamState * state)
+{
+    state->frameIndex = frame.frameIndex;
+    state->timestamp = frame.timestamp;
+    quantizeVector(state->floor, frame.floorPoint);
+    quantizeVector(state->floor + 3, frame.floorNormal, s_normalScale);
+    state->floorConfidence = quantizeConfidence(frame.floorConfidence);
+
+    state->users.resize(frame.users.size());
+
+    for (int i = 0; i < frame.users.size(); ++i)
+    {
+        const QNiTEUserData & user = frame.users[i];
+        QNiTESkeletonStreamState::User & u = state->users[i];
+
+        u.id = user.id;
+        u.flags = (user.isNew ? QNiTESkeletonCaptureUser::New : 0) |
+                  (user.isLost ? QNiTESkeletonCaptureUser::Lost : 0) |
+                  (user.isVisible ? QNiTESkeletonCaptureUser::Visible : 0) |
+                  (user.skeletonTracked ? QNiTESkeletonCaptureUser::SkeletonTracked : 0);
+
+        quantizeVector(u.centerOfMass, user.centerOfMass);
+        quantizeVector(u.bounds, user.boundingMin);
+        quantizeVector(u.bounds + 3, user.boundingMax);
+
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        {
+            quantizeVector(u.joints[j], user.joints[j].position);
+            u.confidence[j] = quantizeConfidence(user.joints[j].confidence);
+        }
+    }
+}
+
+static const QNiTESkeletonStreamState::User * findUser(const QNiTESkeletonStreamState & state, qint32 id)
+{
+    // a handful of users at most, not worth more than a scan
+    for (int i = 0; i < state.users.size(); ++i)
+    {
+        if (state.users[i].id == id)
+            return &state.users[i];
+    }
+    return 0;
+}
+
+static inline void putDeltas(QByteArray * out, const qint32 * from, const qint32 * to, int count)
+{
+    for (int i = 0; i < count; ++i)
+        putSigned(out, qint64(to[i]) - from[i]);
+}
+
+// replaces out with the message that turns from into to
+static void writeMessage(const QNiTESkeletonStreamState & from, const QNiTESkeletonStreamState & to, MessageType type, QByteArray * out)
+{
+    QNiTESkeletonStreamState::User nobody;
+    memset(&nobody, 0, sizeof(nobody));
+
+    out->resize(s_lengthSize);
+
+    putByte(out, type);
+    putSigned(out, qint64(to.frameIndex) - from.frameIndex);
+    putSigned(out, qint64(to.timestamp - from.timestamp));
+
+    const bool floorChanged = memcmp(from.floor, to.floor, sizeof(to.floor)) != 0 || from.floorConfidence != to.floorConfidence;
+    putByte(out, floorChanged);
+    if (floorChanged)
+    {
+        putDeltas(out, from.floor, to.floor, 6);
+        putByte(out, to.floorConfidence);
+    }
+
+    // patched once the entries are written
+    const int countOffset = out->size();
+    out->append(2, '\0');
+    int entries = 0;
+
+    for (int i = 0; i < to.users.size(); ++i)
+    {
+        const QNiTESkeletonStreamState::User & user = to.users[i];
+        const QNiTESkeletonStreamState::User * found = findUser(from, user.id);
+        const QNiTESkeletonStreamState::User & before = found ? *found : nobody;
+
+        quint16 joints = 0;
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        {
+            if (!found || memcmp(before.joints[j], user.joints[j], sizeof(user.joints[j])) != 0 || before.confidence[j] != user.confidence[j])
+                joints |= 1 << j;
+        }
+
+        int fields = 0;
+        if (!found || before.flags != user.flags) fields |= FlagsField;
+        if (!found || memcmp(before.centerOfMass, user.centerOfMass, sizeof(user.centerOfMass)) != 0) fields |= CenterField;
+        if (!found || memcmp(before.bounds, user.bounds, sizeof(user.bounds)) != 0) fields |= BoundsField;
+        if (joints) fields |= JointsField;
+
+        if (!fields)
+            continue;
+
+        putUnsigned(out, quint32(user.id));
+        putByte(out, fields);
+
+        if (fields & FlagsField)
+            putByte(out, user.flags);
+
+        if (fields & CenterField)
+            putDeltas(out, before.centerOfMass, user.centerOfMass, 3);
+
+        if (fields & BoundsField)
+            putDeltas(out, before.bounds, user.bounds, 6);
+
+        if (fields & JointsField)
+        {
+            putUnsigned(out, joints);
+            for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+            {
+                if (!(joints & (1 << j)))
+                    continue;
+
+                putDeltas(out, before.joints[j], user.joints[j], 3);
+                putByte(out, user.confidence[j]);
+            }
+        }
+
+        ++entries;
+    }
+
+    // a keyframe replaces every user anyway
+    if (type == Delta)
+    {
+        for (int i = 0; i < from.users.size(); ++i)
+        {
+            if (findUser(to, from.users[i].id))
+                continue;
+
+            putUnsigned(out, quint32(from.users[i].id));
+            putByte(out, RemovedField);
+            ++entries;
+        }
+    }
+
+    uchar * data = reinterpret_cast<uchar *>(out->data());
+    qToLittleEndian<quint16>(entries, data + countOffset);
+    qToLittleEndian<quint32>(out->size() - s_lengthSize, data);
+}
+
+QNiTESkeletonEncoder::QNiTESkeletonEncoder()
+{
+    m_keyframeInterval = QNITE_STREAM_DEFAULT_KEYFRAME_INTERVAL;
+    reset();
+}
+
+void QNiTESkeletonEncoder::reset()
+{
+    m_sinceKeyframe = -1;
+}
+
+bool QNiTESkeletonEncoder::encode(const QNiTETrackerFrame & frame, QByteArray * out)
+{
+    // the previous state's buffers are reused for the new one
+    qSwap(m_previous, m_state);
+    quantize(frame, &m_state);
+
+    const bool keyframe = m_sinceKeyframe < 0 || (m_keyframeInterval > 0 && m_sinceKeyframe + 1 >= m_keyframeInterval);
+
+    if (keyframe)
+    {
+        encodeKeyframe(out);
+        m_sinceKeyframe = 0;
+    }
+    else
+    {
+        writeMessage(m_previous, m_state, Delta, out);
+        m_sinceKeyframe++;
+    }
+
+    return keyframe;
+}
+
+void QNiTESkeletonEncoder::encodeKeyframe(QByteArray * out) const
+{
+    static const QNiTESkeletonStreamState nothing;
+    writeMessage(nothing, m_state, Keyframe, out);
+}
+
+QNiTESkeletonDecoder::QNiTESkeletonDecoder()
+{
+    m_offset = 0;
+    m_synced = false;
+    m_broken = false;
+    m_skipped = 0;
+}
+
+void QNiTESkeletonDecoder::reset()
+{
+    m_buffer.clear();
+    m_offset = 0;
+    m_synced = false;
+    m_broken = false;
+}
+
+void QNiTESkeletonDecoder::append(const QByteArray & data)
+{
+    if (m_broken)
+        return;
+
+    // drop what was decoded before growing the buffer
+    if (m_offset > 0)
+    {
+        m_buffer.remove(0, m_offset);
+        m_offset = 0;
+    }
+
+    m_buffer.append(data);
+}
+
+bool QNiTESkeletonDecoder::decodeNext()
+{
+    for (;;)
+    {
+        const int available = m_buffer.size() - m_offset;
+        if (available < s_lengthSize)
+            return false;
+
+        const uchar * data = reinterpret_cast<const uchar *>(m_buffer.constData()) + m_offset;
+        const quint32 size = qFromLittleEndian<quint32>(data);
+
+        // waiting for it would buffer without bound, and skipping it lands mid-message
+        if (size > QNITE_STREAM_MAX_MESSAGE_SIZE)
+        {
+            m_buffer.clear();
+            m_offset = 0;
+            m_synced = false;
+            m_broken = true;
+            m_skipped++;
+            return false;
+        }
+
+        if (quint32(available - s_lengthSize) < size)
+            return false;
+
+        m_offset += s_lengthSize + size;
+
+        if (apply(data + s_lengthSize, size))
+            return true;
+
+        m_skipped++;
+    }
+}
+
+bool QNiTESkeletonDecoder::apply(const uchar * data, int size)
+{
+    PayloadReader in(data, size);
+    QNiTESkeletonStreamState & state = m_state;
+
+    const quint8 type = in.byte();
+
+    if (type == Keyframe)
+    {
+        state.frameIndex = 0;
+        state.timestamp = 0;
+        memset(state.floor, 0, sizeof(state.floor));
+        state.floorConfidence = 0;
+        state.users.resize(0);
+    }
+    else if (type != Delta || !m_synced)
+    {
+        return false;
+    }
+
+    // from here on a malformed message leaves the state unusable until the next keyframe
+    m_synced = false;
+
+    state.frameIndex += qint32(in.signedValue());
+    state.timestamp += quint64(in.signedValue());
+
+    if (in.byte())
+    {
+        for (int i = 0; i < 6; ++i)
+            state.floor[i] += qint32(in.signedValue());
+        state.floorConfidence = in.byte();
+    }
+
+    const int entriesLow = in.byte();
+    const int entries = entriesLow | (in.byte() << 8);
+
+    for (int e = 0; e < entries && in.ok; ++e)
+    {
+        const qint32 id = qint32(in.unsignedValue());
+        const quint8 fields = in.byte();
+
+        int index = 0;
+        while (index < state.users.size() && state.users[index].id != id)
+            ++index;
+
+        if (fields & RemovedField)
+        {
+            if (index < state.users.size())
+                state.users.remove(index);
+            continue;
+        }
+
+        if (index == state.users.size())
+        {
+            QNiTESkeletonStreamState::User user;
+            memset(&user, 0, sizeof(user));
+            user.id = id;
+            state.users.append(user);
+        }
+
+        QNiTESkeletonStreamState::User & user = state.users[index];
+
+        if (fields & FlagsField)
+            user.flags = in.byte();
+
+        if (fields & CenterField)
+        {
+            for (int i = 0; i < 3; ++i)
+                user.centerOfMass[i] += qint32(in.signedValue());
+        }
+
+        if (fields & BoundsField)
+        {
+            for (int i = 0; i < 6; ++i)
+                user.bounds[i] += qint32(in.signedValue());
+        }
+
+        if (fields & JointsField)
+        {
+            const quint64 joints = in.unsignedValue();
+            for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+            {
+                if (!(joints & (1 << j)))
+                    continue;
+
+                for (int i = 0; i < 3; ++i)
+                    user.joints[j][i] += qint32(in.signedValue());
+                user.confidence[j] = in.byte();
+            }
+        }
+    }
+
+    if (!in.ok || in.p != in.end)
+        return false;
+
+    m_synced = true;
+
+    m_users.resize(state.users.size());
+    for (int i = 0; i < state.users.size(); ++i)
+    {
+        const QNiTESkeletonStreamState::User & u = state.users[i];
+        QNiTEUserData & data = m_users[i];
+
+        data.id = u.id;
+        data.isNew = u.flags & QNiTESkeletonCaptureUser::New;
+        data.isLost = u.flags & QNiTESkeletonCaptureUser::Lost;
+        data.isVisible = u.flags & QNiTESkeletonCaptureUser::Visible;
+        data.skeletonTracked = u.flags & QNiTESkeletonCaptureUser::SkeletonTracked;
+
+        data.centerOfMass = dequantizeVector(u.centerOfMass);
+        data.boundingMin = dequantizeVector(u.bounds);
+        data.boundingMax = dequantizeVector(u.bounds + 3);
+
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        {
+            data.joints[j].position = dequantizeVector(u.joints[j]);
+            data.joints[j].confidence = u.confidence[j] / 255.0f;
+        }
+    }
+
+    return true;
+}
+
+QVector3D QNiTESkeletonDecoder::floorPoint() const
+{
+    return dequantizeVector(m_state.floor);
+}
+
+QVector3D QNiTESkeletonDecoder::floorNormal() const
+{
+    return dequantizeVector(m_state.floor + 3, s_normalScale);
+}
+
+float QNiTESkeletonDecoder::floorConfidence() const
+{
+    return m_state.floorConfidence / 255.0f;
+}
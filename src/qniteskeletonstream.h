@@ -0,0 +1,156 @@
+#ifndef QNITESKELETONSTREAM_H
+#define QNITESKELETONSTREAM_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include "qniteframe.h"
+
+#define QNITE_STREAM_DEFAULT_KEYFRAME_INTERVAL 30
+
+// longest payload a decoder accepts; a keyframe of a few thousand users fits
+#define QNITE_STREAM_MAX_MESSAGE_SIZE (1 << 20)
+
+/*
+ * Compact binary skeleton stream, as served by QNiTESkeletonServer.
+ *
+ * Every message is a 32 bit little endian payload length followed by the payload.
+ * A payload describes one tracker frame as the difference from the frame before
+ * it; keyframes are the difference from nothing, and let a decoder start or
+ * resynchronize. Only users and fields that changed are sent, and of their joints
+ * only the ones that moved.
+ *
+ * Positions are quantized to whole millimeters, confidences to 1/255 and the
+ * floor normal to 1/10000, then sent as zigzag varint deltas from the previous
+ * values. Both sides keep the quantized values, so rounding never accumulates.
+ */
+
+// one frame as both sides of the stream keep it, quantized
+struct QNiTESkeletonStreamState
+{
+    struct User
+    {
+        qint32 id;
+        quint8 flags; // QNiTESkeletonCaptureUser::Flag
+        qint32 centerOfMass[3];
+        qint32 bounds[6]; // min then max
+        qint32 joints[QNITE_JOINT_COUNT][3];
+        quint8 confidence[QNITE_JOINT_COUNT];
+    };
+
+    QNiTESkeletonStreamState() : frameIndex(0), timestamp(0), floorConfidence(0)
+    {
+        for (int i = 0; i < 6; ++i)
+            floor[i] = 0;
+    }
+
+    qint32 frameIndex;
+    quint64 timestamp;
+    qint32 floor[6]; // point then normal
+    quint8 floorConfidence;
+    QVector<User> users;
+};
+
+class QNiTESkeletonEncoder
+{
+public:
+    QNiTESkeletonEncoder();
+
+    int keyframeInterval() const
+    {
+        return m_keyframeInterval;
+    }
+
+    // every this many frames the message is a keyframe; 0 sends keyframes only on request
+    void setKeyframeInterval(int frames)
+    {
+        m_keyframeInterval = qMax(0, frames);
+    }
+
+    // replaces out with frame's message; returns whether it is a keyframe
+    bool encode(const QNiTETrackerFrame & frame, QByteArray * out);
+
+    // the frame last encoded, as a keyframe, for decoders that join or fell behind
+    void encodeKeyframe(QByteArray * out) const;
+
+    // the next message is a keyframe
+    void reset();
+
+private:
+    QNiTESkeletonStreamState m_previous;
+    QNiTESkeletonStreamState m_state;
+    int m_keyframeInterval;
+    int m_sinceKeyframe;
+};
+
+/*
+ * Turns a stream back into frames: append() whatever arrived, then call
+ * decodeNext() until it returns false.
+ *
+ * Deltas that arrive before the first keyframe are skipped, so a decoder can join
+ * a stream at any point. Malformed messages are skipped too, and then everything
+ * up to the next keyframe.
+ *
+ * A length prefix over QNITE_STREAM_MAX_MESSAGE_SIZE means the stream is out of
+ * step, and there is no telling where the next message starts: the decoder drops
+ * what it has buffered and ignores anything appended until reset(). Reconnecting
+ * gets a keyframe from the server.
+ */
+class QNiTESkeletonDecoder
+{
+public:
+    QNiTESkeletonDecoder();
+
+    void append(const QByteArray & data);
+
+    // decodes the next complete message; false once there is none
+    bool decodeNext();
+
+    void reset();
+
+    // a message was too long to be real; nothing decodes until reset()
+    bool isBroken() const
+    {
+        return m_broken;
+    }
+
+    // the frame last decoded; users come in the order they first appeared
+    qint32 frameIndex() const
+    {
+        return m_state.frameIndex;
+    }
+
+    quint64 timestamp() const
+    {
+        return m_state.timestamp;
+    }
+
+    QVector3D floorPoint() const;
+    QVector3D floorNormal() const;
+    float floorConfidence() const;
+
+    const QVector<QNiTEUserData> & users() const
+    {
+        return m_users;
+    }
+
+    // messages skipped while waiting for a keyframe, or as malformed
+    quint64 skipped() const
+    {
+        return m_skipped;
+    }
+
+private:
+    bool apply(const uchar * data, int size);
+
+    QByteArray m_buffer;
+    int m_offset;
+
+    QNiTESkeletonStreamState m_state;
+    bool m_synced;
+    bool m_broken;
+    QVector<QNiTEUserData> m_users;
+    quint64 m_skipped;
+};
+
+#endif // QNITESKELETONSTREAM_H
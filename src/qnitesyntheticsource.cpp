@@ -0,0 +1,391 @@
+#include "qnitesyntheticsource.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtMath>
+
+#include "qniteprojection.h"
+
+// field of view of a Kinect depth camera
+static const float s_horizontalFov = 1.0225f;
+static const float s_verticalFov = 0.7941f;
+
+// users cycle through appearing and leaving every s_cyclePeriod frames
+static const int s_cyclePeriod = 600;
+static const int s_visibleFrames = 480;
+static const int s_calibrationFrames = 15;
+
+// between the depth and color cameras, in millimeters
+static const float s_colorBaseline = 25.0f;
+
+static const float s_floorY = -1050.0f;
+static const quint16 s_wallDepth = 4500;
+
+// joint offsets from the torso, in millimeters, indexed like QNiTEUser::Joint
+static const float s_pose[QNITE_JOINT_COUNT][3] = {
+    {    0,   450, 0 }, // head
+    {    0,   300, 0 }, // neck
+    { -170,   270, 0 }, // left shoulder
+    {  170,   270, 0 }, // right shoulder
+    { -200,    20, 0 }, // left elbow
+    {  200,    20, 0 }, // right elbow
+    { -220,  -220, 0 }, // left hand
+    {  220,  -220, 0 }, // right hand
+    {    0,     0, 0 }, // torso
+    { -100,  -200, 0 }, // left hip
+    {  100,  -200, 0 }, // right hip
+    { -110,  -600, 0 }, // left knee
+    {  110,  -600, 0 }, // right knee
+    { -120, -1000, 0 }, // left foot
+    {  120, -1000, 0 }  // right foot
+};
+
+class QNiTESyntheticSource::Generator : public QThread
+{
+public:
+    explicit Generator(QNiTESyntheticSource * source) : m_source(source)
+    {
+        setObjectName("QNiTE Synthetic Source");
+    }
+
+protected:
+    virtual void run()
+    {
+        m_source->run();
+    }
+
+private:
+    QNiTESyntheticSource * m_source;
+};
+
+class QNiTESyntheticTrackerStorage : public QNiTEFrameStorage
+{
+public:
+    QVector<quint16> depth;
+    QVector<qint16> labels;
+};
+
+class QNiTESyntheticColorStorage : public QNiTEFrameStorage
+{
+public:
+    QByteArray pixels;
+};
+
+// how many frames user slot has been on stage at index, or -1 if it is away
+static int framesVisible(int slot, int index)
+{
+    if (index < 0) return -1;
+
+    int phase = (index + slot * 137) % s_cyclePeriod;
+    return phase < s_visibleFrames ? phase : -1;
+}
+
+QNiTESyntheticSource::QNiTESyntheticSource(int users, int fps)
+{
+    m_users = qMax(0, users);
+    m_fps = qMax(0, fps);
+
+    m_generator = 0;
+    m_colorEnabled.storeRelease(1);
+    m_currentIndex = 0;
+
+    // fixed, so frames can be generated without opening the source
+    m_depthIntrinsics.horizontalFov = s_horizontalFov;
+    m_depthIntrinsics.verticalFov = s_verticalFov;
+    m_depthIntrinsics.resolutionX = Width;
+    m_depthIntrinsics.resolutionY = Height;
+}
+
+QNiTESyntheticSource::~QNiTESyntheticSource()
+{
+    close();
+}
+
+bool QNiTESyntheticSource::open()
+{
+    if (m_generator) return true;
+
+    m_running.storeRelease(1);
+    m_generator = new Generator(this);
+    m_generator->start();
+
+    return true;
+}
+
+void QNiTESyntheticSource::close()
+{
+    if (!m_generator) return;
+
+    m_running.storeRelease(0);
+    m_generator->wait();
+    delete m_generator;
+    m_generator = 0;
+}
+
+void QNiTESyntheticSource::setColorEnabled(bool enabled)
+{
+    m_colorEnabled.storeRelease(enabled ? 1 : 0);
+}
+
+bool QNiTESyntheticSource::readTrackerFrame(QNiTETrackerFrame * frame)
+{
+    generateTrackerFrame(m_currentIndex, frame);
+    return true;
+}
+
+bool QNiTESyntheticSource::readColorFrame(QNiTEColorFrame * frame)
+{
+    generateColorFrame(m_currentIndex, frame);
+    return true;
+}
+
+QPointF QNiTESyntheticSource::toDepthSpace(const QVector3D & point) const
+{
+    return qniteProjectToDepth(m_depthIntrinsics, point);
+}
+
+bool QNiTESyntheticSource::depthToColor(int x, int y, quint16 depth, QPointF * color) const
+{
+    if (!depth)
+        return false;
+
+    // same lens for both cameras, so only the parallax and resolution are left
+    const float focalLength = 0.5f * Width / qTan(0.5f * s_horizontalFov);
+    const float scaleX = m_colorVideoMode.width > 0 ? float(m_colorVideoMode.width) / Width : 1.0f;
+    const float scaleY = m_colorVideoMode.height > 0 ? float(m_colorVideoMode.height) / Height : 1.0f;
+
+    *color = QPointF((x + s_colorBaseline * focalLength / depth) * scaleX, y * scaleY);
+    return true;
+}
+
+quint64 QNiTESyntheticSource::timestampOf(int index) const
+{
+    return quint64(index) * 1000000 / (m_fps > 0 ? m_fps : 30);
+}
+
+void QNiTESyntheticSource::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    for (int index = 0; m_running.loadAcquire(); ++index)
+    {
+        m_currentIndex = index;
+
+        if (m_listener)
+        {
+            m_listener->onNewTrackerFrame(*this);
+
+            if (m_colorEnabled.loadAcquire())
+                m_listener->onNewColorFrame(*this);
+        }
+
+        if (m_fps > 0)
+        {
+            qint64 due = qint64(timestampOf(index + 1));
+            qint64 now = clock.nsecsElapsed() / 1000;
+            if (due > now)
+                QThread::usleep(due - now);
+        }
+    }
+}
+
+void QNiTESyntheticSource::generateTrackerFrame(int index, QNiTETrackerFrame * frame) const
+{
+    QSharedPointer<QNiTESyntheticTrackerStorage> storage(new QNiTESyntheticTrackerStorage());
+    storage->depth.resize(Width * Height);
+    storage->labels.resize(Width * Height);
+
+    quint16 * depth = storage->depth.data();
+    qint16 * labels = storage->labels.data();
+
+    // back wall, with the floor coming closer towards the bottom of the image
+    for (int y = 0; y < Height; ++y)
+    {
+        quint16 rowDepth = y < Height * 5 / 8 ? s_wallDepth : quint16(s_wallDepth - (y - Height * 5 / 8) * 12);
+        for (int x = 0; x < Width; ++x)
+        {
+            depth[y * Width + x] = rowDepth;
+            labels[y * Width + x] = 0;
+        }
+    }
+
+    const float t = float(timestampOf(index)) / 1000000.0f;
+
+    frame->users.resize(0);
+
+    for (int slot = 0; slot < m_users; ++slot)
+    {
+        const int visible = framesVisible(slot, index);
+        const int visibleBefore = framesVisible(slot, index - 1);
+
+        if (visible < 0 && visibleBefore < 0)
+            continue;
+
+        QNiTEUserData user;
+        user.id = slot + 1;
+
+        if (visible < 0)
+        {
+            // NiTE reports a leaving user once, flagged as lost
+            user.isLost = true;
+            frame->users.append(user);
+            continue;
+        }
+
+        user.isNew = visible == 0;
+        user.isVisible = true;
+        user.skeletonTracked = visible >= s_calibrationFrames;
+
+        const QVector3D torso(800.0f * qSin(0.3f * t + slot * 1.3f),
+                              0.0f,
+                              2500.0f + 700.0f * qCos(0.2f * t + slot * 0.7f));
+        const float swing = qSin(2.0f * t + slot);
+
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+        {
+            QVector3D offset(s_pose[j][0], s_pose[j][1], s_pose[j][2]);
+
+            // elbows and hands swing back and forth, opposite on each side
+            if (j >= 4 && j <= 7)
+                offset.setZ(((j % 2) ? -swing : swing) * (j >= 6 ? 300.0f : 150.0f));
+
+            user.joints[j].position = torso + offset;
+            user.joints[j].confidence = user.skeletonTracked ? ((index + j + slot) % 50 == 0 ? 0.5f : 1.0f) : 0.0f;
+        }
+
+        user.centerOfMass = torso;
+        user.boundingMin = torso + QVector3D(-300, s_floorY - torso.y(), -150);
+        user.boundingMax = torso + QVector3D(300, 500, 150);
+
+        frame->users.append(user);
+
+        // silhouette: an ellipse filling the projected bounding box, z-tested against the scene
+        QPointF topLeft = toDepthSpace(QVector3D(user.boundingMin.x(), user.boundingMax.y(), torso.z()));
+        QPointF bottomRight = toDepthSpace(QVector3D(user.boundingMax.x(), user.boundingMin.y(), torso.z()));
+
+        const float cx = (topLeft.x() + bottomRight.x()) / 2, cy = (topLeft.y() + bottomRight.y()) / 2;
+        const float rx = (bottomRight.x() - topLeft.x()) / 2, ry = (bottomRight.y() - topLeft.y()) / 2;
+        const quint16 userDepth = quint16(torso.z());
+
+        const int x0 = qMax(0, int(topLeft.x())), x1 = qMin(int(Width) - 1, int(bottomRight.x()));
+        const int y0 = qMax(0, int(topLeft.y())), y1 = qMin(int(Height) - 1, int(bottomRight.y()));
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                const float dx = (x - cx) / rx, dy = (y - cy) / ry;
+                const int i = y * Width + x;
+
+                if (dx*dx + dy*dy <= 1.0f && userDepth < depth[i])
+                {
+                    depth[i] = userDepth;
+                    labels[i] = user.id;
+                }
+            }
+        }
+    }
+
+    frame->valid = true;
+    frame->frameIndex = index;
+    frame->timestamp = timestampOf(index);
+
+    frame->resolutionX = frame->width = Width;
+    frame->resolutionY = frame->height = Height;
+    frame->cropOriginX = frame->cropOriginY = 0;
+    frame->depthStride = Width * sizeof(quint16);
+    frame->depth = depth;
+    frame->labels = labels;
+
+    frame->floorPoint = QVector3D(0, s_floorY, 0);
+    frame->floorNormal = QVector3D(0, 1, 0);
+    frame->floorConfidence = 1.0f;
+
+    frame->storage = storage;
+}
+
+// BT.601 studio range, the inverse of what qnitecolorconvert does
+static inline uchar lumaOf(int r, int g, int b)
+{
+    return uchar(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uchar blueDifferenceOf(int r, int g, int b)
+{
+    return uchar(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uchar redDifferenceOf(int r, int g, int b)
+{
+    return uchar(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+void QNiTESyntheticSource::generateColorFrame(int index, QNiTEColorFrame * frame) const
+{
+    const int width = m_colorVideoMode.width > 0 ? m_colorVideoMode.width : int(Width);
+    const int height = m_colorVideoMode.height > 0 ? m_colorVideoMode.height : int(Height);
+    const QNiTEColorFrame::PixelFormat format = m_colorVideoMode.pixelFormat;
+
+    int stride = width * 3;
+    if (format == QNiTEColorFrame::Gray8)
+        stride = width;
+    else if (format == QNiTEColorFrame::YUV422 || format == QNiTEColorFrame::YUYV)
+        stride = (width + 1) / 2 * 4;
+
+    QSharedPointer<QNiTESyntheticColorStorage> storage(new QNiTESyntheticColorStorage());
+    storage->pixels.resize(stride * height);
+
+    const int blue = uchar(index * 4);
+
+    for (int y = 0; y < height; ++y)
+    {
+        uchar * pixel = reinterpret_cast<uchar *>(storage->pixels.data()) + y * stride;
+        const int green = y * 255 / height;
+
+        for (int x = 0; x < width; ++x)
+        {
+            const int red = x * 255 / width;
+
+            switch (format)
+            {
+            case QNiTEColorFrame::Gray8:
+                pixel[x] = lumaOf(red, green, blue);
+                break;
+
+            case QNiTEColorFrame::YUV422:
+            case QNiTEColorFrame::YUYV:
+            {
+                // chroma of the left pixel of every pair, the gradient barely moves across it
+                const bool uyvy = format == QNiTEColorFrame::YUV422;
+                uchar * pair = pixel + x / 2 * 4;
+
+                pair[uyvy ? (x & 1) * 2 + 1 : (x & 1) * 2] = lumaOf(red, green, blue);
+                if (!(x & 1))
+                {
+                    pair[uyvy ? 0 : 1] = blueDifferenceOf(red, green, blue);
+                    pair[uyvy ? 2 : 3] = redDifferenceOf(red, green, blue);
+                }
+                break;
+            }
+
+            default:
+                pixel[3 * x] = uchar(red);
+                pixel[3 * x + 1] = uchar(green);
+                pixel[3 * x + 2] = uchar(blue);
+                break;
+            }
+        }
+    }
+
+    frame->valid = true;
+    frame->frameIndex = index;
+    frame->timestamp = timestampOf(index);
+    frame->width = width;
+    frame->height = height;
+    frame->stride = stride;
+    frame->pixelFormat = format;
+    frame->data = reinterpret_cast<const uchar *>(storage->pixels.constData());
+
+    frame->storage = storage;
+}
@@ -0,0 +1,71 @@
+#ifndef QNITESYNTHETICSOURCE_H
+#define QNITESYNTHETICSOURCE_H
+
+#include <QAtomicInt>
+
+#include "qniteframesource.h"
+
+/*
+ * Hardware-free frame source.
+ *
+ * Generates depth, user labels, skeletons, floor and color frames that depend
+ * only on the frame index, so runs are reproducible for profiling and
+ * regression tests. Users walk around the room, come and go periodically, and
+ * get a tracked skeleton shortly after appearing. fps 0 generates frames as fast
+ * as the listener consumes them.
+ *
+ * Color frames follow the color video mode's size and pixel format; depth frames
+ * are always Width x Height.
+ */
+class QNiTESyntheticSource : public QNiTEFrameSource
+{
+public:
+    explicit QNiTESyntheticSource(int users = 2, int fps = 30);
+    ~QNiTESyntheticSource();
+
+    enum { Width = 640, Height = 480 };
+
+    virtual bool open();
+    virtual void close();
+
+    virtual void setColorEnabled(bool enabled);
+
+    virtual bool readTrackerFrame(QNiTETrackerFrame * frame);
+    virtual bool readColorFrame(QNiTEColorFrame * frame);
+
+    virtual QPointF toDepthSpace(const QVector3D & point) const;
+
+    // as if the color camera sat 25 mm to the right of the depth camera
+    virtual bool depthToColor(int x, int y, quint16 depth, QPointF * color) const;
+
+    int userCount() const
+    {
+        return m_users;
+    }
+
+    int fps() const
+    {
+        return m_fps;
+    }
+
+    // the same index always produces the same frame
+    void generateTrackerFrame(int index, QNiTETrackerFrame * frame) const;
+    void generateColorFrame(int index, QNiTEColorFrame * frame) const;
+
+private:
+    class Generator;
+    friend class Generator;
+
+    void run();
+    quint64 timestampOf(int index) const;
+
+    int m_users;
+    int m_fps;
+
+    Generator * m_generator;
+    QAtomicInt m_running;
+    QAtomicInt m_colorEnabled;
+    int m_currentIndex; // generator thread only
+};
+
+#endif // QNITESYNTHETICSOURCE_H
@@ -1,20 +1,132 @@
 #include "qnitetrackerrenderer.h"
+#include <QColor>
+#include <QImage>
 #include <QPainter>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+#include <QSGSimpleTextureNode>
+#include <QSGVertexColorMaterial>
 #include <QtMath>
 
+#include <algorithm>
+
 #include "qnite.h"
+#include "qnitecolorize.h"
+#include "qniteuser.h"
+
+// limbs drawn by the skeleton overlay, as pairs of joints
+static const QNiTEUser::Joint s_limbs[][2] = {
+    {QNiTEUser::J_HEAD, QNiTEUser::J_NECK},
+
+    {QNiTEUser::J_LEFT_SHOULDER, QNiTEUser::J_LEFT_ELBOW},
+    {QNiTEUser::J_LEFT_ELBOW, QNiTEUser::J_LEFT_HAND},
+
+    {QNiTEUser::J_RIGHT_SHOULDER, QNiTEUser::J_RIGHT_ELBOW},
+    {QNiTEUser::J_RIGHT_ELBOW, QNiTEUser::J_RIGHT_HAND},
+
+    {QNiTEUser::J_LEFT_SHOULDER, QNiTEUser::J_RIGHT_SHOULDER},
+
+    {QNiTEUser::J_LEFT_SHOULDER, QNiTEUser::J_TORSO},
+    {QNiTEUser::J_RIGHT_SHOULDER, QNiTEUser::J_TORSO},
+
+    {QNiTEUser::J_TORSO, QNiTEUser::J_LEFT_HIP},
+    {QNiTEUser::J_TORSO, QNiTEUser::J_RIGHT_HIP},
+
+    {QNiTEUser::J_LEFT_HIP, QNiTEUser::J_RIGHT_HIP},
+
+    {QNiTEUser::J_LEFT_HIP, QNiTEUser::J_LEFT_KNEE},
+    {QNiTEUser::J_LEFT_KNEE, QNiTEUser::J_LEFT_FOOT},
 
-QNiTETrackerRenderer::QNiTETrackerRenderer(QQuickItem *parent) : QQuickPaintedItem(parent)
+    {QNiTEUser::J_RIGHT_HIP, QNiTEUser::J_RIGHT_KNEE},
+    {QNiTEUser::J_RIGHT_KNEE, QNiTEUser::J_RIGHT_FOOT}
+};
+
+static const int s_limbCount = sizeof(s_limbs) / sizeof(s_limbs[0]);
+static const int s_jointCount = QNITE_JOINT_COUNT;
+
+// every limb and every joint is a quad made of two triangles
+static const int s_verticesPerQuad = 6;
+static const int s_verticesPerUser = (s_limbCount + s_jointCount) * s_verticesPerQuad;
+
+static const float s_limbWidth = 3.0f;
+static const float s_jointSize = 7.0f;
+
+// root node holding the depth image and the skeleton overlay on top of it; the
+// software scene graph cannot draw custom geometry, so there the overlay is an image
+class QNiTETrackerNode : public QSGNode
+{
+public:
+    explicit QNiTETrackerNode(bool software)
+    {
+        depth = new QSGSimpleTextureNode();
+        depth->setOwnsTexture(true);
+        depth->setFiltering(QSGTexture::Linear);
+        appendChildNode(depth);
+
+        skeleton = 0;
+        skeletonImage = 0;
+
+        if (software)
+        {
+            skeletonImage = new QSGSimpleTextureNode();
+            skeletonImage->setOwnsTexture(true);
+            appendChildNode(skeletonImage);
+            return;
+        }
+
+        QSGGeometry * geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        geometry->setVertexDataPattern(QSGGeometry::DynamicPattern);
+
+        skeleton = new QSGGeometryNode();
+        skeleton->setGeometry(geometry);
+        skeleton->setMaterial(new QSGVertexColorMaterial());
+        skeleton->setFlags(QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+        appendChildNode(skeleton);
+    }
+
+    QSGSimpleTextureNode * depth;
+    QSGGeometryNode * skeleton; // null on the software backend
+    QSGSimpleTextureNode * skeletonImage; // only on the software backend
+};
+
+static inline void setQuad(QSGGeometry::ColoredPoint2D * v, const QPointF & a, const QPointF & b, const QPointF & c, const QPointF & d, const QColor & color)
+{
+    uchar r = color.red(), g = color.green(), bl = color.blue(), al = color.alpha();
+
+    v[0].set(a.x(), a.y(), r, g, bl, al);
+    v[1].set(b.x(), b.y(), r, g, bl, al);
+    v[2].set(c.x(), c.y(), r, g, bl, al);
+    v[3].set(c.x(), c.y(), r, g, bl, al);
+    v[4].set(b.x(), b.y(), r, g, bl, al);
+    v[5].set(d.x(), d.y(), r, g, bl, al);
+}
+
+static inline void setDegenerate(QSGGeometry::ColoredPoint2D * v, int count)
+{
+    for (int i = 0; i < count; ++i)
+        v[i].set(0, 0, 0, 0, 0, 0);
+}
+
+QNiTETrackerRenderer::QNiTETrackerRenderer(QQuickItem *parent) : QQuickItem(parent)
 {
     m_initialized = false;
+    m_frameDirty = false;
 
-    m_device = 0;
-    m_userTracker = 0;
+    m_kinect = 0;
+    m_qnite = 0;
 
     m_nTexMapX = m_nTexMapY = 0;
+    g_nXRes = g_nYRes = 0;
     m_pTexMap = 0;
 
-    m_keepHistogram = m_hasHistogram = false;
+    m_registered = false;
+
+    m_window = 0;
+
+    setFlag(ItemHasContents, true);
+
+    connect(this, &QQuickItem::windowChanged, this, &QNiTETrackerRenderer::handleWindowChanged);
 }
 
 void QNiTETrackerRenderer::initialize()
@@ -22,7 +134,6 @@ void QNiTETrackerRenderer::initialize()
     if(m_initialized || !m_kinect) return;
 
     m_qnite = reinterpret_cast<QNiTE*>(m_kinect);
-    m_userTracker = m_qnite->m_userTracker;
 
     connect(m_qnite, &QNiTE::newTrackerFrame, this, &QNiTETrackerRenderer::onNewFrame);
 
@@ -39,247 +150,302 @@ QNiTETrackerRenderer::~QNiTETrackerRenderer()
 
 void QNiTETrackerRenderer::onNewFrame()
 {
+    m_frameDirty = true;
+    update();
+
     emit newFrameAvailable();
 }
 
-void calculateHistogram(float* pHistogram, int histogramSize, const openni::VideoFrameRef& depthFrame)
+QSGNode * QNiTETrackerRenderer::updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *)
 {
-    const openni::DepthPixel* pDepth = (const openni::DepthPixel*)depthFrame.getData();
-    int width = depthFrame.getWidth();
-    int height = depthFrame.getHeight();
+    QNiTETrackerNode * node = static_cast<QNiTETrackerNode *>(oldNode);
+
+    if(!m_initialized)
+    {
+        delete node;
+        return 0;
+    }
 
-    memset(pHistogram, 0, histogramSize*sizeof(float));
-    int restOfRow = depthFrame.getStrideInBytes() / sizeof(openni::DepthPixel) - width;
+    const QNiTETrackerFrame & userTrackerFrame = m_qnite->trackerFrame();
 
-    unsigned int nNumberOfPoints = 0;
-    for (int y = 0; y < height; ++y)
+    if (!node)
     {
-        for (int x = 0; x < width; ++x, ++pDepth)
-        {
-            if (*pDepth != 0)
-            {
-                pHistogram[*pDepth]++;
-                nNumberOfPoints++;
-            }
-        }
-        pDepth += restOfRow;
+        if (!userTrackerFrame.isValid())
+            return 0;
+
+        const bool software = window()->rendererInterface()->graphicsApi() == QSGRendererInterface::Software;
+
+        node = new QNiTETrackerNode(software);
+        m_frameDirty = true;
     }
-    for (int nIndex=1; nIndex<histogramSize; nIndex++)
+
+    if (m_frameDirty && userTrackerFrame.isValid() && userTrackerFrame.resolutionX > 0)
     {
-        pHistogram[nIndex] += pHistogram[nIndex-1];
+        m_frameDirty = false;
+
+        updateDepthTexture(userTrackerFrame);
+
+        // m_pTexMap is only rewritten during the next sync, after this frame has been rendered
+        QImage image( reinterpret_cast<uchar *>(m_pTexMap), m_nTexMapX, m_nTexMapY, QImage::Format_RGB32);
+        node->depth->setTexture(window()->createTextureFromImage(image));
+
+        m_paintTiming = m_qnite->trackerTiming();
     }
-    if (nNumberOfPoints)
+
+    node->depth->setRect(boundingRect());
+
+    // the overlay depends on the item size as well, so it is refreshed on every sync
+    if (userTrackerFrame.isValid() && g_nXRes > 0)
     {
-        for (int nIndex=1; nIndex<histogramSize; nIndex++)
-        {
-            pHistogram[nIndex] = (256 * (1.0f - (pHistogram[nIndex] / nNumberOfPoints)));
-        }
+        if (node->skeleton)
+            updateSkeletonGeometry(m_qnite->trackerSnapshot()->users, node->skeleton);
+        else
+            updateSkeletonImage(m_qnite->trackerSnapshot()->users, node->skeletonImage);
     }
+
+    return node;
 }
 
-void QNiTETrackerRenderer::DrawLimb(nite::UserTracker* pUserTracker, const nite::SkeletonJoint& joint1, const nite::SkeletonJoint& joint2, QPainter *painter)
+void QNiTETrackerRenderer::handleWindowChanged(QQuickWindow * window)
 {
-    float coordinates[6] = {0};
-    pUserTracker->convertJointCoordinatesToDepth(joint1.getPosition().x, joint1.getPosition().y, joint1.getPosition().z, &coordinates[0], &coordinates[1]);
-    pUserTracker->convertJointCoordinatesToDepth(joint2.getPosition().x, joint2.getPosition().y, joint2.getPosition().z, &coordinates[3], &coordinates[4]);
+    if (m_window)
+        disconnect(m_window, &QQuickWindow::frameSwapped, this, &QNiTETrackerRenderer::onFrameSwapped);
 
-    coordinates[0] *= width()/(float)g_nXRes;
-    coordinates[1] *= height()/(float)g_nYRes;
-    coordinates[3] *= width()/(float)g_nXRes;
-    coordinates[4] *= height()/(float)g_nYRes;
+    m_window = window;
 
-    if (joint1.getPositionConfidence() == 1 && joint2.getPositionConfidence() == 1)
-    {
-        painter->setPen(QPen(Qt::yellow, 3, Qt::SolidLine, Qt::RoundCap));
-    }
-    else if (joint1.getPositionConfidence() < 0.5f || joint2.getPositionConfidence() < 0.5f)
-    {
+    // emitted on the render thread, right after the frame synced in updatePaintNode() is shown
+    if (m_window)
+        connect(m_window, &QQuickWindow::frameSwapped, this, &QNiTETrackerRenderer::onFrameSwapped, Qt::DirectConnection);
+}
+
+void QNiTETrackerRenderer::onFrameSwapped()
+{
+    if (!m_paintTiming.delivered)
         return;
-    }
-    else
-    {
-        painter->setPen(QPen(Qt::gray, 3, Qt::SolidLine, Qt::RoundCap));
-    }
 
-    painter->drawLine( QPointF(coordinates[0], coordinates[1]), QPointF(coordinates[3], coordinates[4]) );
+    m_paintTiming.painted = qniteTimestampNs();
+    m_qnite->latencyStats()->recordPaint(m_paintTiming);
 
+    m_paintTiming = QNiTEFrameTiming();
+}
 
-    if (joint1.getPositionConfidence() == 1)
-    {
-        painter->setPen(QPen(Qt::yellow, 7, Qt::SolidLine, Qt::RoundCap));
-    }
-    else
+void QNiTETrackerRenderer::updateDepthTexture(const QNiTETrackerFrame & userTrackerFrame)
+{
+    g_nXRes = userTrackerFrame.resolutionX;
+    g_nYRes = userTrackerFrame.resolutionY;
+
+    if (m_pTexMap == 0 || m_nTexMapX != g_nXRes || m_nTexMapY != g_nYRes)
     {
-        painter->setPen(QPen(Qt::gray, 7, Qt::SolidLine, Qt::RoundCap));
+        delete[] m_pTexMap;
+        m_nTexMapX = g_nXRes;
+        m_nTexMapY = g_nYRes;
+        m_pTexMap = new quint32[m_nTexMapX * m_nTexMapY];
+        std::fill(m_pTexMap, m_pTexMap + m_nTexMapX*m_nTexMapY, 0xff000000);
     }
 
-    painter->drawPoint(coordinates[0], coordinates[1]);
+    // registration needs the color frame size, and the color frame is only around once it arrived
+    m_registrationTable.clear();
 
-    if (joint2.getPositionConfidence() == 1)
+    if (m_registered && userTrackerFrame.depth && m_qnite->rgbFrame().isValid())
     {
-        painter->setPen(QPen(Qt::yellow, 7, Qt::SolidLine, Qt::RoundCap));
-    }
-    else
-    {
-        painter->setPen(QPen(Qt::gray, 7, Qt::SolidLine, Qt::RoundCap));
+        const QNiTEColorFrame & colorFrame = m_qnite->rgbFrame();
+        QSharedPointer<const QNiTERegistrationTable> table =
+                m_qnite->registrationTable(g_nXRes, g_nYRes, colorFrame.width, colorFrame.height);
+
+        if (table && m_registration.apply(*table, userTrackerFrame))
+            m_registrationTable = table;
     }
 
-    painter->drawPoint(coordinates[3], coordinates[4]);
+    if (m_registrationTable)
+    {
+        m_histogram.update(userTrackerFrame.depth, userTrackerFrame.width, userTrackerFrame.height, userTrackerFrame.depthStride);
 
-}
+        // registered maps always cover the whole texture
+        for (int y = 0; y < m_nTexMapY; ++y)
+        {
+            const int row = y * m_nTexMapX;
+            qniteColorizeDepth(m_registration.depth() + row, m_registration.labels() + row, m_histogram.lut(), m_pTexMap + row, m_nTexMapX);
+        }
+    }
+    else if (userTrackerFrame.depth && userTrackerFrame.labels)
+    {
+        m_histogram.update(userTrackerFrame.depth, userTrackerFrame.width, userTrackerFrame.height, userTrackerFrame.depthStride);
 
-void QNiTETrackerRenderer::DrawSkeleton(nite::UserTracker* pUserTracker, const nite::UserData& userData, QPainter *painter)
-{
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_HEAD), userData.getSkeleton().getJoint(nite::JOINT_NECK),  painter);
+        const qint16* pLabels = userTrackerFrame.labels;
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_SHOULDER), userData.getSkeleton().getJoint(nite::JOINT_LEFT_ELBOW),  painter);
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_ELBOW), userData.getSkeleton().getJoint(nite::JOINT_LEFT_HAND),  painter);
+        const quint16* pDepthRow = userTrackerFrame.depth;
+        quint32* pTexRow = m_pTexMap + userTrackerFrame.cropOriginY * m_nTexMapX;
+        int rowSize = userTrackerFrame.depthStride / sizeof(quint16);
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_RIGHT_SHOULDER), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_ELBOW),  painter);
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_RIGHT_ELBOW), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_HAND),  painter);
+        // cropped frames leave a border the kernel never writes
+        if (userTrackerFrame.width != m_nTexMapX || userTrackerFrame.height != m_nTexMapY)
+            std::fill(m_pTexMap, m_pTexMap + m_nTexMapX*m_nTexMapY, 0xff000000);
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_SHOULDER), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_SHOULDER),  painter);
+        for (int y = 0; y < userTrackerFrame.height; ++y)
+        {
+            qniteColorizeDepth(pDepthRow, pLabels, m_histogram.lut(), pTexRow + userTrackerFrame.cropOriginX, userTrackerFrame.width);
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_SHOULDER), userData.getSkeleton().getJoint(nite::JOINT_TORSO),  painter);
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_RIGHT_SHOULDER), userData.getSkeleton().getJoint(nite::JOINT_TORSO),  painter);
+            pDepthRow += rowSize;
+            pLabels += userTrackerFrame.width;
+            pTexRow += m_nTexMapX;
+        }
+    }
+    else
+    {
+        std::fill(m_pTexMap, m_pTexMap + m_nTexMapX*m_nTexMapY, 0xff000000);
+    }
+}
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_TORSO), userData.getSkeleton().getJoint(nite::JOINT_LEFT_HIP),  painter);
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_TORSO), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_HIP),  painter);
+bool QNiTETrackerRenderer::projectSkeleton(const QNiTEUserData & user, QPointF * projected) const
+{
+    if (user.isNew || user.isLost || !user.skeletonTracked)
+        return false;
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_HIP), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_HIP),  painter);
+    const float scaleX = width()/(float)g_nXRes;
+    const float scaleY = height()/(float)g_nYRes;
 
+    // joints come projected by QNiTE's worker, limbs share the results
+    for (int j = 0; j < s_jointCount; ++j)
+    {
+        const QNiTEJointData & joint = user.joints[j];
+        const QPointF p = m_registrationTable ? m_registrationTable->map(joint.projected, joint.position.z()) : joint.projected;
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_HIP), userData.getSkeleton().getJoint(nite::JOINT_LEFT_KNEE),  painter);
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_LEFT_KNEE), userData.getSkeleton().getJoint(nite::JOINT_LEFT_FOOT),  painter);
+        projected[j] = QPointF(p.x() * scaleX, p.y() * scaleY);
+    }
 
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_RIGHT_HIP), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_KNEE),  painter);
-    DrawLimb(pUserTracker, userData.getSkeleton().getJoint(nite::JOINT_RIGHT_KNEE), userData.getSkeleton().getJoint(nite::JOINT_RIGHT_FOOT),  painter);
+    return true;
 }
 
-void QNiTETrackerRenderer::paint(QPainter *painter)
+void QNiTETrackerRenderer::updateSkeletonGeometry(const QVector<QNiTEUserData> & users, QSGGeometryNode * node)
 {
-    if(!m_initialized)
-        return;
+    // grow only; slots of users that are not drawn are left as degenerate triangles,
+    // so the vertex buffer keeps its size and is rewritten in place
+    QSGGeometry * geometry = node->geometry();
+    if (geometry->vertexCount() < users.size() * s_verticesPerUser)
+        geometry->allocate(users.size() * s_verticesPerUser);
 
-    m_qnite->lockFrameRef();
+    QSGGeometry::ColoredPoint2D * v = geometry->vertexDataAsColoredPoint2D();
+    QSGGeometry::ColoredPoint2D * end = v + geometry->vertexCount();
 
-    nite::UserTrackerFrameRef & userTrackerFrame = (*m_qnite->getFrameRef());
-    openni::VideoFrameRef depthFrame;
-    nite::Status rc = m_userTracker->readFrame(&userTrackerFrame);
-    if (rc != nite::STATUS_OK)
-    {
-        printf("GetNextData failed\n");
-        return;
-    }
+    const QColor confident(Qt::yellow);
+    const QColor unsure(Qt::gray);
 
-    depthFrame = userTrackerFrame.getDepthFrame();
-    g_nXRes = depthFrame.getVideoMode().getResolutionX();
-    g_nYRes = depthFrame.getVideoMode().getResolutionY();
+    QPointF projected[s_jointCount];
+    float confidence[s_jointCount];
+    bool jointDrawn[s_jointCount];
 
-    if (m_pTexMap == 0)
+    for (int i = 0; i < users.size(); ++i)
     {
-        m_nTexMapX = depthFrame.getVideoMode().getResolutionX();
-        m_nTexMapY = depthFrame.getVideoMode().getResolutionY();
-        m_pTexMap = new openni::RGB888Pixel[m_nTexMapX * m_nTexMapY];
-    }
-
-    const nite::UserMap& userLabels = userTrackerFrame.getUserMap();
+        const QNiTEUserData& user = users[i];
 
-    painter->eraseRect(0,0,width(),height());
+        if (!projectSkeleton(user, projected))
+            continue;
 
-    if (depthFrame.isValid())
-    {
-        if(!m_hasHistogram || !m_keepHistogram)
+        for (int j = 0; j < s_jointCount; ++j)
         {
-            calculateHistogram(m_pDepthHist, MAX_DEPTH, depthFrame);
-            m_hasHistogram = true;
+            confidence[j] = user.joints[j].confidence;
+            jointDrawn[j] = false;
         }
 
-    }
+        for (int l = 0; l < s_limbCount; ++l, v += s_verticesPerQuad)
+        {
+            const int a = s_limbs[l][0];
+            const int b = s_limbs[l][1];
 
-    memset(m_pTexMap, 0, m_nTexMapX*m_nTexMapY*sizeof(openni::RGB888Pixel));
+            if (confidence[a] < 0.5f || confidence[b] < 0.5f)
+            {
+                setDegenerate(v, s_verticesPerQuad);
+                continue;
+            }
 
-    float factor[3] = {1, 1, 1};
-    const float Colors[][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 1}};
-    const int colorCount = 3;
+            jointDrawn[a] = jointDrawn[b] = true;
 
-    // check if we need to draw depth frame to texture
-    if (depthFrame.isValid())
-    {
-        const nite::UserId* pLabels = userLabels.getPixels();
+            QPointF dir = projected[b] - projected[a];
+            qreal length = qSqrt(dir.x()*dir.x() + dir.y()*dir.y());
+            QPointF normal = length > 0 ? QPointF(-dir.y(), dir.x()) * (s_limbWidth * 0.5f / length) : QPointF();
 
-        const openni::DepthPixel* pDepthRow = (const openni::DepthPixel*)depthFrame.getData();
-        openni::RGB888Pixel* pTexRow = m_pTexMap + depthFrame.getCropOriginY() * m_nTexMapX;
-        int rowSize = depthFrame.getStrideInBytes() / sizeof(openni::DepthPixel);
+            setQuad(v, projected[a] + normal, projected[a] - normal, projected[b] + normal, projected[b] - normal,
+                    (confidence[a] == 1 && confidence[b] == 1) ? confident : unsure);
+        }
 
-        for (int y = 0; y < depthFrame.getHeight(); ++y)
+        for (int j = 0; j < s_jointCount; ++j, v += s_verticesPerQuad)
         {
-            const openni::DepthPixel* pDepth = pDepthRow;
-            openni::RGB888Pixel* pTex = pTexRow + depthFrame.getCropOriginX();
-
-            for (int x = 0; x < depthFrame.getWidth(); ++x, ++pDepth, ++pTex, ++pLabels)
+            if (!jointDrawn[j])
             {
-                if (*pDepth != 0)
-                {
-                    if (*pLabels == 0)
-                    {
-                        if (false)//!g_drawBackground)
-                        {
-                            factor[0] = factor[1] = factor[2] = 0;
-
-                        }
-                        else
-                        {
-                            factor[0] = Colors[colorCount][0];
-                            factor[1] = Colors[colorCount][1];
-                            factor[2] = Colors[colorCount][2];
-                        }
-                    }
-                    else
-                    {
-                        factor[0] = Colors[*pLabels % colorCount][0];
-                        factor[1] = Colors[*pLabels % colorCount][1];
-                        factor[2] = Colors[*pLabels % colorCount][2];
-                    }
-
-                    int nHistValue = m_pDepthHist[*pDepth]; // (1.0 - (*pDepth)*0.00001525902189669642d)*256.0f;//(*pDepth)%256;//
-                    pTex->r = nHistValue*factor[0];
-                    pTex->g = nHistValue*factor[1];
-                    pTex->b = nHistValue*factor[2];
-
-                    factor[0] = factor[1] = factor[2] = 1;
-                }
+                setDegenerate(v, s_verticesPerQuad);
+                continue;
             }
 
-            pDepthRow += rowSize;
-            pTexRow += m_nTexMapX;
+            const float h = s_jointSize * 0.5f;
+            const QPointF & p = projected[j];
+
+            setQuad(v, p + QPointF(-h, -h), p + QPointF(-h, h), p + QPointF(h, -h), p + QPointF(h, h),
+                    confidence[j] == 1 ? confident : unsure);
         }
     }
 
-    QImage image( reinterpret_cast<uchar *>(m_pTexMap), m_nTexMapX, m_nTexMapY, QImage::Format_RGB888);
-    painter->drawImage(QRect(0, 0, width(), height()), image);
+    setDegenerate(v, end - v);
+
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+void QNiTETrackerRenderer::updateSkeletonImage(const QVector<QNiTEUserData> & users, QSGSimpleTextureNode * node)
+{
+    const QSize size(qCeil(width()), qCeil(height()));
+    if (size.isEmpty())
+        return;
+
+    if (m_skeletonImage.size() != size)
+        m_skeletonImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+
+    m_skeletonImage.fill(Qt::transparent);
+
+    QPainter painter(&m_skeletonImage);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    const QColor confident(Qt::yellow);
+    const QColor unsure(Qt::gray);
 
-    const nite::Array<nite::UserData>& users = userTrackerFrame.getUsers();
-    for (int i = 0; i < users.getSize(); ++i)
+    QPointF projected[s_jointCount];
+    bool jointDrawn[s_jointCount];
+
+    for (int i = 0; i < users.size(); ++i)
     {
-        const nite::UserData& user = users[i];
+        const QNiTEUserData& user = users[i];
+
+        if (!projectSkeleton(user, projected))
+            continue;
 
-        //updateUserState(user, userTrackerFrame.getTimestamp());
-        if (user.isNew())
+        std::fill(jointDrawn, jointDrawn + s_jointCount, false);
+
+        for (int l = 0; l < s_limbCount; ++l)
         {
-            m_userTracker->startSkeletonTracking(user.getId());
+            const int a = s_limbs[l][0];
+            const int b = s_limbs[l][1];
+            const float confidenceA = user.joints[a].confidence;
+            const float confidenceB = user.joints[b].confidence;
+
+            if (confidenceA < 0.5f || confidenceB < 0.5f)
+                continue;
+
+            jointDrawn[a] = jointDrawn[b] = true;
+
+            painter.setPen(QPen((confidenceA == 1 && confidenceB == 1) ? confident : unsure, s_limbWidth, Qt::SolidLine, Qt::FlatCap));
+            painter.drawLine(projected[a], projected[b]);
         }
-        else if (!user.isLost())
+
+        const float h = s_jointSize * 0.5f;
+
+        for (int j = 0; j < s_jointCount; ++j)
         {
-            if (users[i].getSkeleton().getState() == nite::SKELETON_TRACKED)
-            {
-                DrawSkeleton(m_userTracker, user, painter);
-            }
+            if (jointDrawn[j])
+                painter.fillRect(QRectF(projected[j] - QPointF(h, h), QSizeF(s_jointSize, s_jointSize)), user.joints[j].confidence == 1 ? confident : unsure);
         }
-
     }
 
-    m_qnite->unlockFrameRef();
+    painter.end();
 
+    // the software backend copies the image into its own pixmap, so it can be redrawn next sync
+    node->setTexture(window()->createTextureFromImage(m_skeletonImage));
+    node->setRect(QRectF(QPointF(0, 0), size));
 }
-
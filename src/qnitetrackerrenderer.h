@@ -1,21 +1,26 @@
 #ifndef QNiTETrackerRendererTRACKERRENDERER_H
 #define QNiTETrackerRendererTRACKERRENDERER_H
 
-#include <OpenNI.h>
-#include <NiTE.h>
+#include <QImage>
+#include <QQuickItem>
 
-#include <QQuickPaintedItem>
-
-#define MAX_DEPTH 10000
+#include "qnitedepthhistogram.h"
+#include "qniteframe.h"
+#include "qniteregistration.h"
 
 class QNiTE;
+class QSGGeometryNode;
+class QSGSimpleTextureNode;
 
-class QNiTETrackerRenderer : public QQuickPaintedItem
+class QNiTETrackerRenderer : public QQuickItem
 {
     Q_OBJECT
     Q_PROPERTY(QObject* kinect READ kinect WRITE setKinect NOTIFY kinectChanged)
     Q_PROPERTY(bool initialized READ initialized WRITE setInitialized NOTIFY initializedChanged)
-    Q_PROPERTY(bool keepHistogram READ keepHistogram WRITE setKeepHistogram NOTIFY keepHistogramChanged)
+    Q_PROPERTY(int histogramSubsample READ histogramSubsample WRITE setHistogramSubsample NOTIFY histogramSubsampleChanged)
+    Q_PROPERTY(int histogramInterval READ histogramInterval WRITE setHistogramInterval NOTIFY histogramIntervalChanged)
+    Q_PROPERTY(qreal histogramBlend READ histogramBlend WRITE setHistogramBlend NOTIFY histogramBlendChanged)
+    Q_PROPERTY(bool registered READ registered WRITE setRegistered NOTIFY registeredChanged)
 public:
     explicit QNiTETrackerRenderer(QQuickItem *parent = 0);
     ~QNiTETrackerRenderer();
@@ -25,16 +30,29 @@ public:
         return m_initialized;
     }
 
-    virtual void paint(QPainter *painter);
-
     QObject* kinect() const
     {
         return m_kinect;
     }
 
-    bool keepHistogram() const
+    int histogramSubsample() const
+    {
+        return m_histogram.subsample();
+    }
+
+    int histogramInterval() const
+    {
+        return m_histogram.refreshInterval();
+    }
+
+    qreal histogramBlend() const
     {
-        return m_keepHistogram;
+        return m_histogram.blend();
+    }
+
+    bool registered() const
+    {
+        return m_registered;
     }
 
 signals:
@@ -44,7 +62,10 @@ signals:
 
     void kinectChanged(QObject* arg);
 
-    void keepHistogramChanged(bool arg);
+    void histogramSubsampleChanged(int arg);
+    void histogramIntervalChanged(int arg);
+    void histogramBlendChanged(qreal arg);
+    void registeredChanged(bool arg);
 
 public slots:
 
@@ -68,35 +89,81 @@ public slots:
         emit kinectChanged(arg);
     }
 
-    void setKeepHistogram(bool arg)
+    void setHistogramSubsample(int arg)
+    {
+        if (m_histogram.subsample() == arg)
+            return;
+
+        m_histogram.setSubsample(arg);
+        emit histogramSubsampleChanged(m_histogram.subsample());
+    }
+
+    void setHistogramInterval(int arg)
+    {
+        if (m_histogram.refreshInterval() == arg)
+            return;
+
+        m_histogram.setRefreshInterval(arg);
+        emit histogramIntervalChanged(m_histogram.refreshInterval());
+    }
+
+    void setHistogramBlend(qreal arg)
     {
-        if (m_keepHistogram == arg)
+        if (m_histogram.blend() == arg)
             return;
 
-        m_keepHistogram = arg;
-        emit keepHistogramChanged(arg);
+        m_histogram.setBlend(arg);
+        emit histogramBlendChanged(m_histogram.blend());
     }
 
+    // draws depth, users and skeletons where they show up on the color image, so the
+    // renderer lines up with a QNiTEColorRenderer of the same size underneath it
+    void setRegistered(bool arg)
+    {
+        if (m_registered == arg)
+            return;
+
+        m_registered = arg;
+        m_frameDirty = true;
+        emit registeredChanged(arg);
+        update();
+    }
+
+protected:
+    virtual QSGNode * updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *);
+
+private slots:
+    void handleWindowChanged(QQuickWindow * window);
+    void onFrameSwapped();
+
 private:
-    void DrawSkeleton(nite::UserTracker* pUserTracker, const nite::UserData& userData, QPainter *painter);
-    void DrawLimb(nite::UserTracker* pUserTracker, const nite::SkeletonJoint& joint1, const nite::SkeletonJoint& joint2, QPainter *painter);
+    void updateDepthTexture(const QNiTETrackerFrame & userTrackerFrame);
+    // false for users without a skeleton to draw
+    bool projectSkeleton(const QNiTEUserData & user, QPointF * projected) const;
+    void updateSkeletonGeometry(const QVector<QNiTEUserData> & users, QSGGeometryNode * node);
+    void updateSkeletonImage(const QVector<QNiTEUserData> & users, QSGSimpleTextureNode * node);
 
     QNiTE *m_qnite;
 
-    openni::Device * m_device;
-    nite::UserTracker * m_userTracker;
     bool m_initialized;
 
     int m_nTexMapX;
     int m_nTexMapY;
     int g_nXRes;
     int g_nYRes;
-    openni::RGB888Pixel * m_pTexMap;
+    quint32 * m_pTexMap;
+
+    QNiTEDepthHistogram m_histogram;
 
-    float m_pDepthHist[MAX_DEPTH];
-    bool m_hasHistogram;
+    bool m_registered;
+    QNiTEDepthRegistration m_registration; // render thread
+    QSharedPointer<const QNiTERegistrationTable> m_registrationTable; // of the frame last drawn, if registered
+    QImage m_skeletonImage; // render thread, software backend only
     QObject* m_kinect;
-    bool m_keepHistogram;
+    bool m_frameDirty;
+
+    QQuickWindow * m_window;
+    QNiTEFrameTiming m_paintTiming; // render thread
 };
 
 #endif // QNiTETrackerRendererTRACKERRENDERER_H
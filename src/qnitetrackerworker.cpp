@@ -0,0 +1,261 @@
+#include "qnitetrackerworker.h"
+
+#include "qniteprojection.h"
+#include "qniteuser.h"
+
+QNiTETrackerWorker::QNiTETrackerWorker(QNiTEFrameQueue<QNiTETrackerFrame> * frames,
+                                       QNiTEFrameQueue<QNiTETrackerSnapshotPointer> * snapshots)
+    : m_frames(frames), m_snapshots(snapshots), m_previous(new QNiTETrackerSnapshot())
+{
+    m_nextPointCloudId = 1;
+}
+
+QNiTETrackerSnapshotPointer QNiTETrackerWorker::buildSnapshot(const QNiTETrackerFrame & frame)
+{
+    QNiTETrackerSnapshot * snapshot = new QNiTETrackerSnapshot();
+    snapshot->frame = frame;
+    snapshot->users = frame.users;
+
+    filterJoints(snapshot);
+    projectJoints(snapshot);
+
+    m_maskExtractor.extract(snapshot->frame, &snapshot->userMasks, &snapshot->maskRuns);
+    generatePointClouds(snapshot);
+
+    const QVector<QNiTEUserData> & users = snapshot->users;
+    const QVector<QNiTEUserData> & previous = m_previous->users;
+
+    snapshot->userChanges.resize(users.size());
+
+    for (int i = 0; i < users.size(); ++i)
+    {
+        const QNiTEUserData & user = users[i];
+
+        if (!user.isLost && user.skeletonTracked)
+            snapshot->skeletonCount++;
+
+        // a handful of users at most, not worth more than a scan
+        const QNiTEUserData * before = 0;
+        for (int j = 0; j < previous.size() && !before; ++j)
+        {
+            if (previous[j].id == user.id)
+                before = &previous[j];
+        }
+
+        snapshot->userChanges[i] = before ? QNiTEUser::changesBetween(*before, user) : int(QNiTEUser::AllChanges);
+    }
+
+    m_previous = QNiTETrackerSnapshotPointer(snapshot);
+    return m_previous;
+}
+
+void QNiTETrackerWorker::setJointFilter(const QNiTEJointFilterSettings & settings)
+{
+    QMutexLocker locker(&m_filterMutex);
+    m_filterSettings = settings;
+}
+
+int QNiTETrackerWorker::addPointCloud(const QNiTEPointCloudSettings & settings)
+{
+    QMutexLocker locker(&m_pointCloudMutex);
+
+    PointCloudRequest request;
+    request.id = m_nextPointCloudId++;
+    request.settings = settings;
+    m_pointCloudRequests.append(request);
+
+    return request.id;
+}
+
+void QNiTETrackerWorker::setPointCloud(int id, const QNiTEPointCloudSettings & settings)
+{
+    QMutexLocker locker(&m_pointCloudMutex);
+
+    for (int i = 0; i < m_pointCloudRequests.size(); ++i)
+    {
+        if (m_pointCloudRequests[i].id == id)
+            m_pointCloudRequests[i].settings = settings;
+    }
+}
+
+void QNiTETrackerWorker::removePointCloud(int id)
+{
+    QMutexLocker locker(&m_pointCloudMutex);
+
+    for (int i = 0; i < m_pointCloudRequests.size(); ++i)
+    {
+        if (m_pointCloudRequests[i].id == id)
+        {
+            m_pointCloudRequests.remove(i);
+            return;
+        }
+    }
+}
+
+void QNiTETrackerWorker::filterJoints(QNiTETrackerSnapshot * snapshot)
+{
+    m_filterMutex.lock();
+    const QNiTEJointFilterSettings settings = m_filterSettings;
+    m_filterMutex.unlock();
+
+    if (!settings.isActive())
+    {
+        m_filters.resize(0);
+        return;
+    }
+
+    // the frame's own users stay as the sensor saw them
+    QNiTEUserData * users = snapshot->users.data();
+
+    for (int i = 0; i < snapshot->users.size(); ++i)
+    {
+        QNiTEUserData & user = users[i];
+
+        int f = 0;
+        while (f < m_filters.size() && m_filters[f].userId != user.id)
+            ++f;
+
+        if (user.isLost)
+        {
+            if (f < m_filters.size())
+            {
+                m_filters[f] = m_filters.last();
+                m_filters.removeLast();
+            }
+            continue;
+        }
+
+        if (f == m_filters.size())
+        {
+            UserFilter filter;
+            filter.userId = user.id;
+            m_filters.append(filter);
+        }
+
+        m_filters[f].filter.apply(settings, snapshot->frame.timestamp, user.joints);
+    }
+}
+
+void QNiTETrackerWorker::projectJoints(QNiTETrackerSnapshot * snapshot)
+{
+    const QNiTETrackerFrame & frame = snapshot->frame;
+
+    snapshot->intrinsics = m_intrinsics;
+    if (frame.resolutionX > 0 && frame.resolutionY > 0)
+    {
+        snapshot->intrinsics.resolutionX = frame.resolutionX;
+        snapshot->intrinsics.resolutionY = frame.resolutionY;
+    }
+
+    const int count = snapshot->users.size() * QNITE_JOINT_COUNT;
+    if (count == 0)
+        return;
+
+    if (m_x.size() < count)
+    {
+        m_x.resize(count);
+        m_y.resize(count);
+        m_z.resize(count);
+        m_projectedX.resize(count);
+        m_projectedY.resize(count);
+    }
+
+    // detaches the users from the frame's, unless filtering already did
+    QNiTEUserData * users = snapshot->users.data();
+
+    for (int i = 0, n = 0; i < snapshot->users.size(); ++i)
+    {
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j, ++n)
+        {
+            const QVector3D & position = users[i].joints[j].position;
+            m_x[n] = position.x();
+            m_y[n] = position.y();
+            m_z[n] = position.z();
+        }
+    }
+
+    qniteProjectToDepth(snapshot->intrinsics, m_x.constData(), m_y.constData(), m_z.constData(),
+                        m_projectedX.data(), m_projectedY.data(), count);
+
+    for (int i = 0, n = 0; i < snapshot->users.size(); ++i)
+    {
+        for (int j = 0; j < QNITE_JOINT_COUNT; ++j, ++n)
+            users[i].joints[j].projected = QPointF(m_projectedX[n], m_projectedY[n]);
+    }
+}
+
+void QNiTETrackerWorker::generatePointClouds(QNiTETrackerSnapshot * snapshot)
+{
+    // shares the list rather than copying it; a change while the frame is built detaches it
+    m_pointCloudMutex.lock();
+    const QVector<PointCloudRequest> requests = m_pointCloudRequests;
+    m_pointCloudMutex.unlock();
+
+    if (requests.isEmpty() || !snapshot->intrinsics.isValid())
+        return;
+
+    for (int i = 0; i < requests.size(); ++i)
+    {
+        const QNiTEPointCloudSettings & settings = requests[i].settings;
+
+        QNiTETrackerSnapshot::PointCloud cloud;
+        cloud.id = requests[i].id;
+
+        // renderers with the same settings share one cloud
+        for (int j = 0; j < i && !cloud.buffer; ++j)
+        {
+            if (requests[j].settings == settings)
+                cloud.buffer = snapshot->pointClouds[j].buffer;
+        }
+
+        if (!cloud.buffer)
+        {
+            m_pointCloud.setStride(settings.stride);
+            m_pointCloud.setVoxelSize(settings.voxelSize);
+            m_pointCloud.setUserId(settings.userId);
+            m_pointCloud.setMaxDepth(settings.maxDepth);
+
+            // the points are swapped rather than copied, and the buffers' vectors only grow
+            QNiTEPointCloudBuffer * buffer = freePointBuffer();
+            buffer->count = m_pointCloud.generate(snapshot->frame, snapshot->intrinsics);
+            m_pointCloud.swapPoints(buffer->points);
+
+            cloud.buffer = QExplicitlySharedDataPointer<const QNiTEPointCloudBuffer>(buffer);
+        }
+
+        snapshot->pointClouds.append(cloud);
+    }
+}
+
+QNiTEPointCloudBuffer * QNiTETrackerWorker::freePointBuffer()
+{
+    // one only the pool still holds; snapshots never hand theirs on, so it stays free
+    for (int i = 0; i < m_pointBuffers.size(); ++i)
+    {
+        if (m_pointBuffers[i]->ref.loadAcquire() == 1)
+            return m_pointBuffers[i].data();
+    }
+
+    QNiTEPointCloudBuffer * buffer = new QNiTEPointCloudBuffer();
+    m_pointBuffers.append(QExplicitlySharedDataPointer<QNiTEPointCloudBuffer>(buffer));
+    return buffer;
+}
+
+void QNiTETrackerWorker::process()
+{
+    while (m_frames->acquire())
+    {
+        const QNiTETrackerFrame & frame = m_frames->front();
+
+        if (!frame.isValid())
+        {
+            qDebug("[QNiTETrackerWorker::process] Frame is not valid.");
+            continue;
+        }
+
+        m_snapshots->back() = buildSnapshot(frame);
+        m_snapshots->publish();
+
+        emit snapshotReady();
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef QNITETRACKERWORKER_H
+#define QNITETRACKERWORKER_H
+
+#include <QMutex>
+#include <QObject>
+
+#include "qniteframe.h"
+#include "qniteframequeue.h"
+#include "qnitejointfilter.h"
+#include "qnitepointcloud.h"
+#include "qniteusermask.h"
+
+/*
+ * Turns tracker frames into QNiTETrackerSnapshots, on a thread of its own.
+ *
+ * Joints are filtered per user as set with setJointFilter(), into the snapshot's
+ * users rather than its frame, which keeps the sensor's. Then every joint is
+ * projected onto the depth image, in one batch per frame from the source's depth
+ * intrinsics. The label image is split into per-user masks once, too, and the
+ * depth image turned into a point cloud for every addPointCloud() id. Snapshots
+ * carry the results.
+ *
+ * QNiTE moves it to its worker thread. The source's frames arrive through the
+ * frame queue, which applies the frame policy; snapshots leave through a queue
+ * that never drops, so every snapshot's userChanges hold relative to the one the
+ * GUI thread applied before it.
+ */
+class QNiTETrackerWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    QNiTETrackerWorker(QNiTEFrameQueue<QNiTETrackerFrame> * frames,
+                       QNiTEFrameQueue<QNiTETrackerSnapshotPointer> * snapshots);
+
+    // the frame source's; set before the first frame. A frame's own depth resolution
+    // takes precedence over the one given here
+    void setIntrinsics(const QNiTEDepthIntrinsics & intrinsics)
+    {
+        m_intrinsics = intrinsics;
+    }
+
+    // takes effect with the next frame; safe to call from any thread
+    void setJointFilter(const QNiTEJointFilterSettings & settings);
+
+    // from the next frame on, every snapshot carries a cloud generated with settings,
+    // until removePointCloud(); returns the id to find it with. Safe to call from any thread
+    int addPointCloud(const QNiTEPointCloudSettings & settings);
+    void setPointCloud(int id, const QNiTEPointCloudSettings & settings);
+    void removePointCloud(int id);
+
+    // also records frame as the previous snapshot, to compare the next one with
+    QNiTETrackerSnapshotPointer buildSnapshot(const QNiTETrackerFrame & frame);
+
+signals:
+
+    // a snapshot was published; emitted on the worker thread
+    void snapshotReady();
+
+public slots:
+
+    // takes every pending frame; blocks while the snapshot queue is full
+    void process();
+
+private:
+    void filterJoints(QNiTETrackerSnapshot * snapshot);
+    void projectJoints(QNiTETrackerSnapshot * snapshot);
+    void generatePointClouds(QNiTETrackerSnapshot * snapshot);
+    QNiTEPointCloudBuffer * freePointBuffer();
+
+    QNiTEFrameQueue<QNiTETrackerFrame> * m_frames;
+    QNiTEFrameQueue<QNiTETrackerSnapshotPointer> * m_snapshots;
+
+    QNiTETrackerSnapshotPointer m_previous;
+
+    QNiTEDepthIntrinsics m_intrinsics;
+
+    struct UserFilter
+    {
+        int userId;
+        QNiTEJointFilter filter;
+    };
+
+    QMutex m_filterMutex;
+    QNiTEJointFilterSettings m_filterSettings;
+    QVector<UserFilter> m_filters; // users seen since they were found, in no order
+
+    // joints of every user as separate coordinate arrays, grown as needed
+    QVector<float> m_x, m_y, m_z, m_projectedX, m_projectedY;
+
+    QNiTEUserMaskExtractor m_maskExtractor;
+
+    struct PointCloudRequest
+    {
+        int id;
+        QNiTEPointCloudSettings settings;
+    };
+
+    QMutex m_pointCloudMutex;
+    QVector<PointCloudRequest> m_pointCloudRequests; // shared with the frame being built
+    int m_nextPointCloudId;
+    QNiTEPointCloud m_pointCloud; // hands its points to a buffer after every cloud
+
+    // as many as snapshots hold at once, a handful; grows only
+    QVector<QExplicitlySharedDataPointer<QNiTEPointCloudBuffer> > m_pointBuffers;
+};
+
+#endif // QNITETRACKERWORKER_H
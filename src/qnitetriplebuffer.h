@@ -0,0 +1,80 @@
+#ifndef QNITETRIPLEBUFFER_H
+#define QNITETRIPLEBUFFER_H
+
+#include <QAtomicInt>
+
+/*
+ * Single-producer / single-consumer triple buffer.
+ *
+ * The producer fills back() and calls publish(), which swaps the back slot
+ * with the shared middle slot. The consumer calls acquire(), which swaps the
+ * middle slot into front() if something newer was published. Neither side
+ * ever blocks, and the consumer always sees the newest complete slot.
+ *
+ * front() stays untouched by the producer until the consumer acquires again.
+ */
+template <typename T>
+class QNiTETripleBuffer
+{
+public:
+    QNiTETripleBuffer() : m_front(0), m_middle(1), m_back(2)
+    {
+    }
+
+    // producer side
+
+    T & back()
+    {
+        return m_slots[m_back];
+    }
+
+    // returns true if the previously published slot was never acquired
+    bool publish()
+    {
+        int previous = m_middle.fetchAndStoreOrdered(m_back | FreshBit);
+        m_back = previous & IndexMask;
+        return (previous & FreshBit) != 0;
+    }
+
+    // consumer side
+
+    bool acquire()
+    {
+        if(!(m_middle.loadAcquire() & FreshBit))
+            return false;
+
+        int previous = m_middle.fetchAndStoreOrdered(m_front);
+        m_front = previous & IndexMask;
+        return true;
+    }
+
+    T & front()
+    {
+        return m_slots[m_front];
+    }
+
+    const T & front() const
+    {
+        return m_slots[m_front];
+    }
+
+    // drops every slot; only valid while the producer is stopped
+    void reset()
+    {
+        for(int i = 0; i < 3; ++i)
+            m_slots[i] = T();
+        m_middle.storeRelease(m_middle.loadAcquire() & IndexMask);
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTETripleBuffer)
+
+    enum { IndexMask = 0x3, FreshBit = 0x4 };
+
+    T m_slots[3];
+    int m_front;
+    QAtomicInt m_middle;
+    int m_back;
+};
+
+#endif // QNITETRIPLEBUFFER_H
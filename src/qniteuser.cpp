@@ -1,8 +1,15 @@
 #include "qniteuser.h"
 
-QNiTEUser::QNiTEUser(nite::UserId id, QObject *parent) : QObject(parent)
+QNiTEUser::QNiTEUser(int id, QObject *parent) : QObject(parent)
 {
     m_userId = id;
+    m_tracked = true;
+    m_hasSkeleton = false;
+
+    m_changes = 0;
+    m_updating = false;
+    m_batchedNotifications = false;
+    m_updatePending = false;
 }
 
 QNiTEUser::~QNiTEUser()
@@ -10,49 +17,161 @@ QNiTEUser::~QNiTEUser()
 
 }
 
-void QNiTEUser::update(const nite::UserData &data)
+void QNiTEUser::reset(int id)
+{
+    m_changes = 0;
+    m_updatePending = false;
+
+    setHasSkeleton(false);
+    setCenterOfMass(QVector3D());
+    setBoundingMin(QVector3D());
+    setBoundingMax(QVector3D());
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        m_joints[j] = QVector4D();
+        m_projectedJoints[j] = QPointF();
+    }
+
+    if (m_userId != id)
+    {
+        m_userId = id;
+        emit userIdChanged(id);
+    }
+
+    if (!m_tracked)
+    {
+        m_tracked = true;
+        emit trackedChanged(true);
+    }
+}
+
+void QNiTEUser::release()
 {
-    const nite::Skeleton  &skeleton = data.getSkeleton();
-    setHasSkeleton(skeleton.getState() == nite::SKELETON_TRACKED);
+    if (!m_tracked)
+        return;
 
-    const NitePoint3f c = data.getCenterOfMass();
-    setCenterOfMass(QVector3D(c.x, c.y, c.z));
+    m_tracked = false;
+    emit trackedChanged(false);
+}
+
+int QNiTEUser::changesBetween(const QNiTEUserData &from, const QNiTEUserData &to)
+{
+    int changes = 0;
+
+    if (from.skeletonTracked != to.skeletonTracked)
+        changes |= HasSkeletonChange;
+    if (from.centerOfMass != to.centerOfMass)
+        changes |= CenterOfMassChange;
+    if (from.boundingMin != to.boundingMin)
+        changes |= BoundingMinChange;
+    if (from.boundingMax != to.boundingMax)
+        changes |= BoundingMaxChange;
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        // projections move on their own when the depth mode or intrinsics change
+        if (from.joints[j].position != to.joints[j].position || from.joints[j].confidence != to.joints[j].confidence ||
+            from.joints[j].projected != to.joints[j].projected)
+        {
+            changes |= JointsChange;
+            break;
+        }
+    }
+
+    return changes;
+}
 
-    const NitePoint3f min = data.getBoundingBox().min;
-    const NitePoint3f max = data.getBoundingBox().max;
-    setBoundingMin( QVector3D(min.x, min.y, min.z) );
-    setBoundingMax( QVector3D(max.x, max.y, max.z) );
+void QNiTEUser::update(const QNiTEUserData &data)
+{
+    update(data, AllChanges);
+}
 
-    storeJoint(skeleton, J_HEAD);
-    storeJoint(skeleton, J_NECK);
+void QNiTEUser::update(const QNiTEUserData &data, int changes)
+{
+    const int previousChanges = m_changes;
+
+    m_changes = 0;
+    m_updating = true;
+
+    if (changes & HasSkeletonChange)
+        setHasSkeleton(data.skeletonTracked);
+
+    if (changes & CenterOfMassChange)
+        setCenterOfMass(data.centerOfMass);
+
+    if (changes & BoundingMinChange)
+        setBoundingMin(data.boundingMin);
+    if (changes & BoundingMaxChange)
+        setBoundingMax(data.boundingMax);
+
+    for (int j = 0; (changes & JointsChange) && j < QNITE_JOINT_COUNT; ++j)
+    {
+        const QNiTEJointData & joint = data.joints[j];
+        const QVector4D value(joint.position, joint.confidence);
+
+        if (m_joints[j] != value || m_projectedJoints[j] != joint.projected)
+        {
+            m_joints[j] = value;
+            m_projectedJoints[j] = joint.projected;
+            m_changes |= JointsChange;
+        }
+    }
+
+    m_updating = false;
+
+    // updated() also notifies changes, which stays 0 over frames without any
+    if (!m_batchedNotifications)
+        emit updated();
+    else
+        m_updatePending = m_changes || previousChanges;
+}
 
-    storeJoint(skeleton, J_LEFT_SHOULDER);
-    storeJoint(skeleton, J_RIGHT_SHOULDER);
-    storeJoint(skeleton, J_LEFT_ELBOW);
-    storeJoint(skeleton, J_RIGHT_ELBOW);
-    storeJoint(skeleton, J_LEFT_HAND);
-    storeJoint(skeleton, J_RIGHT_HAND);
+void QNiTEUser::emitDeferredChanges()
+{
+    if (!m_updatePending)
+        return;
 
-    storeJoint(skeleton, J_TORSO);
+    m_updatePending = false;
 
-    storeJoint(skeleton, J_LEFT_HIP);
-    storeJoint(skeleton, J_RIGHT_HIP);
-    storeJoint(skeleton, J_LEFT_KNEE);
-    storeJoint(skeleton, J_RIGHT_KNEE);
-    storeJoint(skeleton, J_LEFT_FOOT);
-    storeJoint(skeleton, J_RIGHT_FOOT);
+    if (m_changes & HasSkeletonChange)
+        emit hasSkeletonChanged(m_hasSkeleton);
+    if (m_changes & CenterOfMassChange)
+        emit centerOfMassChanged(m_centerOfMass);
+    if (m_changes & BoundingMinChange)
+        emit boundingMinChanged(m_boundingMin);
+    if (m_changes & BoundingMaxChange)
+        emit boundingMaxChanged(m_boundingMax);
 
     emit updated();
+}
 
+QVector<qreal> QNiTEUser::joints() const
+{
+    QVector<qreal> values(QNITE_JOINT_COUNT * 4);
+    qreal * out = values.data();
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j, out += 4)
+    {
+        out[0] = m_joints[j].x();
+        out[1] = m_joints[j].y();
+        out[2] = m_joints[j].z();
+        out[3] = m_joints[j].w();
+    }
+
+    return values;
 }
 
-void QNiTEUser::storeJoint(const nite::Skeleton &skeleton, QNiTEUser::Joint jointId)
+QVector<qreal> QNiTEUser::projectedJoints() const
 {
-    const nite::SkeletonJoint & joint = skeleton.getJoint( static_cast<nite::JointType>(jointId) );
-    nite::Point3f pos = joint.getPosition();
+    QVector<qreal> values(QNITE_JOINT_COUNT * 2);
+    qreal * out = values.data();
 
-    m_skeletonPositions[jointId] = QVector3D(pos.x, pos.y, pos.z);
-    m_skeletonConfidences[jointId] = joint.getPositionConfidence();
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j, out += 2)
+    {
+        out[0] = m_projectedJoints[j].x();
+        out[1] = m_projectedJoints[j].y();
+    }
 
+    return values;
 }
-
@@ -2,20 +2,27 @@
 #define QNITEUSER_H
 
 #include <QObject>
+#include <QVector>
 #include <QVector3D>
-#include <QMap>
+#include <QVector4D>
 #include <NiTE.h>
 
+#include "qniteframe.h"
+
 class QNiTEUser : public QObject
 {
     Q_OBJECT
-    Q_ENUMS(Joint)
+    Q_ENUMS(Joint Change)
 
     Q_PROPERTY(bool hasSkeleton READ hasSkeleton WRITE setHasSkeleton NOTIFY hasSkeletonChanged)
-    Q_PROPERTY(int userId READ userId CONSTANT)
+    Q_PROPERTY(int userId READ userId NOTIFY userIdChanged)
+    Q_PROPERTY(bool tracked READ tracked NOTIFY trackedChanged)
     Q_PROPERTY(QVector3D centerOfMass READ centerOfMass WRITE setCenterOfMass NOTIFY centerOfMassChanged)
     Q_PROPERTY(QVector3D boundingMin READ boundingMin WRITE setBoundingMin NOTIFY boundingMinChanged)
     Q_PROPERTY(QVector3D boundingMax READ boundingMax WRITE setBoundingMax NOTIFY boundingMaxChanged)
+    Q_PROPERTY(QVector<qreal> joints READ joints NOTIFY updated)
+    Q_PROPERTY(QVector<qreal> projectedJoints READ projectedJoints NOTIFY updated)
+    Q_PROPERTY(int changes READ changes NOTIFY updated)
 
 public:
     enum Joint {
@@ -39,7 +46,17 @@ public:
         J_RIGHT_FOOT = nite::JOINT_RIGHT_FOOT
     };
 
-    explicit QNiTEUser( nite::UserId id, QObject *parent = 0 );
+    // what the last update() changed, see changes()
+    enum Change {
+        HasSkeletonChange = 0x1,
+        CenterOfMassChange = 0x2,
+        BoundingMinChange = 0x4,
+        BoundingMaxChange = 0x8,
+        JointsChange = 0x10,
+        AllChanges = 0x1f
+    };
+
+    explicit QNiTEUser( int id, QObject *parent = 0 );
     ~QNiTEUser();
 
     bool hasSkeleton() const
@@ -67,8 +84,65 @@ public:
         return m_userId;
     }
 
+    // false once the user is lost. QNiTE reuses the object for a user found later,
+    // so drop references to it on userLost, or check userId along with this
+    bool tracked() const
+    {
+        return m_tracked;
+    }
+
+    // readies a pooled object for a newly found user
+    void reset(int id);
+
+    // marks the object lost, its data stays as it was last seen
+    void release();
+
+    // x, y, z (mm) and confidence of every joint, in Joint order; one call for the whole skeleton
+    QVector<qreal> joints() const;
+
+    // the same data without a copy, QNITE_JOINT_COUNT entries
+    const QVector4D * jointData() const
+    {
+        return m_joints;
+    }
+
+    // x, y of every joint on the depth image (pixels), in Joint order; what toScreenSpace() would give
+    QVector<qreal> projectedJoints() const;
+
+    const QPointF * projectedJointData() const
+    {
+        return m_projectedJoints;
+    }
+
+    // Change flags telling what differs between two observations of a user
+    static int changesBetween(const QNiTEUserData & from, const QNiTEUserData & to);
+
+    // Change flags set by the last update()
+    int changes() const
+    {
+        return m_changes;
+    }
+
+    // in batched mode update() holds its signals back until emitDeferredChanges()
+    bool batchedNotifications() const
+    {
+        return m_batchedNotifications;
+    }
+
+    void setBatchedNotifications(bool batched)
+    {
+        m_batchedNotifications = batched;
+    }
+
+    // the signals the last update() held back, each at most once; QNiTE calls it for
+    // every updated user right before frameCommitted()
+    void emitDeferredChanges();
+
 signals:
 
+    void userIdChanged(int arg);
+    void trackedChanged(bool arg);
+
     void hasSkeletonChanged(bool arg);
 
     void centerOfMassChanged(QVector3D arg);
@@ -81,16 +155,24 @@ signals:
 
 public slots:
 
-    void update(const nite::UserData &data);
+    void update(const QNiTEUserData &data);
+
+    // only looks at the parts of data that changes, a Change mask, names
+    void update(const QNiTEUserData &data, int changes);
 
     QVector3D jointPosition(Joint joint)
     {
-        return m_skeletonPositions.value(joint, QVector3D());
+        return isJoint(joint) ? m_joints[joint].toVector3D() : QVector3D();
     }
 
     qreal jointConfidence(Joint joint)
     {
-        return m_skeletonConfidences.value(joint, 0.0);
+        return isJoint(joint) ? m_joints[joint].w() : 0.0;
+    }
+
+    QPointF projectedJoint(Joint joint)
+    {
+        return isJoint(joint) ? m_projectedJoints[joint] : QPointF();
     }
 
     void setHasSkeleton(bool arg)
@@ -99,7 +181,8 @@ public slots:
             return;
 
         m_hasSkeleton = arg;
-        emit hasSkeletonChanged(arg);
+        if (!deferChange(HasSkeletonChange))
+            emit hasSkeletonChanged(arg);
     }
 
     void setCenterOfMass(QVector3D arg)
@@ -108,7 +191,8 @@ public slots:
             return;
 
         m_centerOfMass = arg;
-        emit centerOfMassChanged(arg);
+        if (!deferChange(CenterOfMassChange))
+            emit centerOfMassChanged(arg);
     }
 
     void setBoundingMin(QVector3D arg)
@@ -117,7 +201,8 @@ public slots:
             return;
 
         m_boundingMin = arg;
-        emit boundingMinChanged(arg);
+        if (!deferChange(BoundingMinChange))
+            emit boundingMinChanged(arg);
     }
 
     void setBoundingMax(QVector3D arg)
@@ -126,20 +211,40 @@ public slots:
             return;
 
         m_boundingMax = arg;
-        emit boundingMaxChanged(arg);
+        if (!deferChange(BoundingMaxChange))
+            emit boundingMaxChanged(arg);
     }
 
 private:
-    void storeJoint(const nite::Skeleton  &skeleton, Joint joint);
+    static bool isJoint(int joint)
+    {
+        return joint >= 0 && joint < QNITE_JOINT_COUNT;
+    }
+
+    // records a change made by update(); true if its signal is to be held back
+    bool deferChange(Change change)
+    {
+        if (!m_updating)
+            return false;
+
+        m_changes |= change;
+        return m_batchedNotifications;
+    }
 
     bool m_hasSkeleton;
     QVector3D m_centerOfMass;
     QVector3D m_boundingMin;
     QVector3D m_boundingMax;
     int m_userId;
+    bool m_tracked;
+
+    QVector4D m_joints[QNITE_JOINT_COUNT];
+    QPointF m_projectedJoints[QNITE_JOINT_COUNT];
 
-    QMap< Joint, QVector3D > m_skeletonPositions;
-    QMap< Joint, qreal > m_skeletonConfidences;
+    int m_changes;
+    bool m_updating;
+    bool m_batchedNotifications;
+    bool m_updatePending; // updated() is held back
 
 };
 
@@ -0,0 +1,128 @@
+#include "qniteusermask.h"
+
+#include <cstring>
+
+void QNiTEUserMaskExtractor::extract(const QNiTETrackerFrame & frame, QVector<QNiTEUserMask> * masks, QVector<QNiTEMaskRun> * runs)
+{
+    masks->resize(0);
+    runs->resize(0);
+    m_pending.resize(0);
+
+    if (!frame.isValid() || !frame.labels)
+        return;
+
+    QVector<QNiTEUserMask> & found = *masks;
+    m_maxX.resize(0);
+    m_maxY.resize(0);
+
+    int current = -1;
+
+    for (int y = 0; y < frame.height; ++y)
+    {
+        const qint16 * row = frame.labels + y * frame.width;
+        int x = 0;
+
+        while (x < frame.width)
+        {
+            // most of a frame is background, skip it four labels at a time
+            if (x + 4 <= frame.width)
+            {
+                quint64 word;
+                std::memcpy(&word, row + x, sizeof(word));
+
+                if (word == 0)
+                {
+                    x += 4;
+                    continue;
+                }
+            }
+
+            const qint16 label = row[x];
+            if (label == 0)
+            {
+                ++x;
+                continue;
+            }
+
+            const int start = x;
+            while (x < frame.width && row[x] == label)
+                ++x;
+
+            // a handful of users at most, and runs of one user tend to follow each other
+            if (current < 0 || found[current].userId != label)
+            {
+                current = 0;
+                while (current < found.size() && found[current].userId != label)
+                    ++current;
+
+                if (current == found.size())
+                {
+                    QNiTEUserMask mask;
+                    mask.userId = label;
+                    mask.bounds = QRect(start, y, 1, 1);
+                    found.append(mask);
+                    m_maxX.append(start);
+                    m_maxY.append(y);
+                }
+            }
+
+            QNiTEUserMask & mask = found[current];
+            mask.pixelCount += x - start;
+            mask.runCount++;
+
+            if (start < mask.bounds.left()) mask.bounds.setLeft(start);
+            if (x - 1 > m_maxX[current]) m_maxX[current] = x - 1;
+            m_maxY[current] = y;
+
+            PendingRun pending;
+            pending.mask = current;
+            pending.run.y = quint16(frame.cropOriginY + y);
+            pending.run.x = quint16(frame.cropOriginX + start);
+            pending.run.length = quint16(x - start);
+            m_pending.append(pending);
+        }
+    }
+
+    // group the runs by user; each user's stay in row order
+    m_cursor.resize(found.size());
+    for (int i = 0, first = 0; i < found.size(); ++i)
+    {
+        QNiTEUserMask & mask = found[i];
+        mask.firstRun = m_cursor[i] = first;
+        first += mask.runCount;
+
+        mask.bounds.setRight(m_maxX[i]);
+        mask.bounds.setBottom(m_maxY[i]);
+        mask.bounds.translate(frame.cropOriginX, frame.cropOriginY);
+    }
+
+    runs->resize(m_pending.size());
+    QNiTEMaskRun * out = runs->data();
+
+    for (int i = 0; i < m_pending.size(); ++i)
+        out[m_cursor[m_pending[i].mask]++] = m_pending[i].run;
+}
+
+void qniteFillUserMask(const QNiTEUserMask & mask, const QNiTEMaskRun * runs, uchar * out, int stride,
+                       int originX, int originY, uchar value)
+{
+    for (int i = 0; i < mask.runCount; ++i)
+    {
+        const QNiTEMaskRun & run = runs[i];
+        std::memset(out + (run.y - originY) * stride + (run.x - originX), value, run.length);
+    }
+}
+
+QImage qniteUserMaskImage(const QNiTETrackerSnapshot & snapshot, int userId)
+{
+    const QNiTEUserMask * mask = snapshot.userMask(userId);
+    if (!mask)
+        return QImage();
+
+    QImage image(mask->bounds.size(), QImage::Format_Alpha8);
+    image.fill(0);
+
+    qniteFillUserMask(*mask, snapshot.runsOf(*mask), image.bits(), image.bytesPerLine(),
+                      mask->bounds.left(), mask->bounds.top());
+    return image;
+}
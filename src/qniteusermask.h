@@ -0,0 +1,47 @@
+#ifndef QNITEUSERMASK_H
+#define QNITEUSERMASK_H
+
+#include <QImage>
+
+#include "qniteframe.h"
+
+/*
+ * Splits the user labels of tracker frames into per-user silhouettes, with one
+ * scan of the label image per frame.
+ *
+ * Each user gets its pixel count, tight bounding box and row run-length encoding
+ * (see QNiTEUserMask), so consumers reach a user's pixels without walking the
+ * label image again. QNiTE's tracker worker runs it for every snapshot.
+ *
+ * Keeps scratch buffers that only grow; use one per thread.
+ */
+class QNiTEUserMaskExtractor
+{
+public:
+    // replaces masks and runs; both come out empty for frames without labels
+    void extract(const QNiTETrackerFrame & frame, QVector<QNiTEUserMask> * masks, QVector<QNiTEMaskRun> * runs);
+
+private:
+    struct PendingRun
+    {
+        int mask;
+        QNiTEMaskRun run;
+    };
+
+    // runs in scan order, then where each user's next run goes once they are grouped
+    QVector<PendingRun> m_pending;
+    QVector<int> m_cursor;
+
+    // right and bottom edges of each mask's bounds while scanning
+    QVector<int> m_maxX, m_maxY;
+};
+
+// sets mask's pixels to value in an 8 bit image whose top-left pixel is at originX, originY;
+// runs are the mask's own, from QNiTETrackerSnapshot::runsOf()
+void qniteFillUserMask(const QNiTEUserMask & mask, const QNiTEMaskRun * runs, uchar * out, int stride,
+                       int originX, int originY, uchar value = 255);
+
+// userId's silhouette as an alpha image the size of its bounds, null if it has no pixels
+QImage qniteUserMaskImage(const QNiTETrackerSnapshot & snapshot, int userId);
+
+#endif // QNITEUSERMASK_H
@@ -0,0 +1,152 @@
+#include "qniteusermodel.h"
+
+#include "qniteuser.h"
+
+QNiTEUserModel::QNiTEUserModel(QObject *parent) : QAbstractListModel(parent)
+{
+    for (int changes = 0; changes < 32; ++changes)
+    {
+        QVector<int> & roles = m_changedRoles[changes];
+
+        if (changes & QNiTEUser::HasSkeletonChange)
+            roles.append(HasSkeletonRole);
+        if (changes & QNiTEUser::CenterOfMassChange)
+            roles.append(CenterOfMassRole);
+        if (changes & QNiTEUser::BoundingMinChange)
+            roles.append(BoundingMinRole);
+        if (changes & QNiTEUser::BoundingMaxChange)
+            roles.append(BoundingMaxRole);
+        if (changes & QNiTEUser::JointsChange)
+            roles << JointsRole << ProjectedJointsRole;
+    }
+}
+
+int QNiTEUserModel::rowCount(const QModelIndex & parent) const
+{
+    return parent.isValid() ? 0 : m_users.size();
+}
+
+QVariant QNiTEUserModel::data(const QModelIndex & index, int role) const
+{
+    QNiTEUser * user = userAt(index.row());
+    if (!user)
+        return QVariant();
+
+    switch (role)
+    {
+    case UserRole:
+        return QVariant::fromValue(user);
+    case UserIdRole:
+        return user->userId();
+    case HasSkeletonRole:
+        return user->hasSkeleton();
+    case CenterOfMassRole:
+        return user->centerOfMass();
+    case BoundingMinRole:
+        return user->boundingMin();
+    case BoundingMaxRole:
+        return user->boundingMax();
+    case JointsRole:
+        return QVariant::fromValue(user->joints());
+    case ProjectedJointsRole:
+        return QVariant::fromValue(user->projectedJoints());
+    }
+
+    return QVariant();
+}
+
+QHash<int, QByteArray> QNiTEUserModel::roleNames() const
+{
+    QHash<int, QByteArray> names;
+    names.insert(UserRole, "user");
+    names.insert(UserIdRole, "userId");
+    names.insert(HasSkeletonRole, "hasSkeleton");
+    names.insert(CenterOfMassRole, "centerOfMass");
+    names.insert(BoundingMinRole, "boundingMin");
+    names.insert(BoundingMaxRole, "boundingMax");
+    names.insert(JointsRole, "joints");
+    names.insert(ProjectedJointsRole, "projectedJoints");
+    return names;
+}
+
+int QNiTEUserModel::lowerBound(int id) const
+{
+    int first = 0, count = m_users.size();
+
+    while (count > 0)
+    {
+        const int step = count / 2;
+        if (m_users[first + step]->userId() < id)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+int QNiTEUserModel::rowOf(const QNiTEUser * user) const
+{
+    if (!user)
+        return -1;
+
+    const int row = lowerBound(user->userId());
+    return (row < m_users.size() && m_users[row] == user) ? row : -1;
+}
+
+QNiTEUser * QNiTEUserModel::userById(int id) const
+{
+    const int row = lowerBound(id);
+    return (row < m_users.size() && m_users[row]->userId() == id) ? m_users[row] : 0;
+}
+
+void QNiTEUserModel::insertUser(QNiTEUser * user)
+{
+    if (!user || userById(user->userId()))
+        return;
+
+    const int row = lowerBound(user->userId());
+
+    beginInsertRows(QModelIndex(), row, row);
+    m_users.insert(row, user);
+    endInsertRows();
+
+    emit countChanged();
+}
+
+void QNiTEUserModel::removeUser(QNiTEUser * user)
+{
+    const int row = rowOf(user);
+    if (row < 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_users.remove(row);
+    endRemoveRows();
+
+    emit countChanged();
+}
+
+void QNiTEUserModel::userUpdated(QNiTEUser * user)
+{
+    const int changes = user ? user->changes() : 0;
+    if (!changes)
+        return;
+
+    const int row = rowOf(user);
+    if (row < 0)
+        return;
+
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, m_changedRoles[changes & 31]);
+}
+
+QObject * QNiTEUserModel::get(int row) const
+{
+    return userAt(row);
+}
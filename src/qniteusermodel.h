@@ -0,0 +1,72 @@
+#ifndef QNITEUSERMODEL_H
+#define QNITEUSERMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+class QNiTEUser;
+
+/*
+ * The users QNiTE currently tracks, ordered by id. It is also QNiTE's registry of
+ * users, looked up by binary search; rows live in a vector that only reallocates
+ * when the crowd grows past its largest size so far.
+ *
+ * QNiTE inserts and removes single rows as users are found and lost, and after
+ * each frame emits dataChanged() for the users that changed, limited to the roles
+ * their QNiTEUser::changes() cover. Delegates are never rebuilt as a whole.
+ */
+class QNiTEUserModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    enum Role {
+        UserRole = Qt::UserRole + 1,
+        UserIdRole,
+        HasSkeletonRole,
+        CenterOfMassRole,
+        BoundingMinRole,
+        BoundingMaxRole,
+        JointsRole,
+        ProjectedJointsRole
+    };
+
+    explicit QNiTEUserModel(QObject *parent = 0);
+
+    virtual int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex & index, int role) const;
+    virtual QHash<int, QByteArray> roleNames() const;
+
+    QNiTEUser * userAt(int row) const
+    {
+        return m_users.value(row, 0);
+    }
+
+    int rowOf(const QNiTEUser * user) const;
+    QNiTEUser * userById(int id) const;
+
+    void insertUser(QNiTEUser * user);
+    void removeUser(QNiTEUser * user);
+
+    // after QNiTEUser::update(); emits dataChanged() for the roles its changes() touch
+    void userUpdated(QNiTEUser * user);
+
+signals:
+
+    void countChanged();
+
+public slots:
+
+    QObject * get(int row) const;
+
+private:
+    int lowerBound(int id) const;
+
+    QVector<QNiTEUser *> m_users;
+
+    // dataChanged() roles for every QNiTEUser::Change combination, built once
+    QVector<int> m_changedRoles[32];
+};
+
+#endif // QNITEUSERMODEL_H
@@ -0,0 +1,92 @@
+#include "qniteuserpool.h"
+
+#include <QQmlEngine>
+
+#include "qniteuser.h"
+
+QNiTEUserPool::QNiTEUserPool(QObject * owner, int size, int releaseDelay)
+{
+    m_owner = owner;
+    m_releaseDelay = qMax(0, releaseDelay);
+    m_allocated = 0;
+    m_tick = 0;
+
+    setMaxSize(QNITE_MAX_USERS);
+
+    for (int i = 0; i < qMin(size, m_maxSize); ++i)
+        m_free.append(create());
+}
+
+void QNiTEUserPool::setMaxSize(int size)
+{
+    m_maxSize = qMax(1, qMax(m_allocated, size));
+
+    // every user fits in either list, so neither ever reallocates
+    m_free.reserve(m_maxSize);
+    m_released.reserve(m_maxSize);
+}
+
+QNiTEUser * QNiTEUserPool::acquire(int id)
+{
+    QNiTEUser * user = 0;
+
+    if (!m_free.isEmpty())
+    {
+        user = m_free.last();
+        m_free.removeLast();
+    }
+    else if (m_allocated < m_maxSize)
+    {
+        user = create();
+        qDebug("[QNiTEUserPool::acquire] Pool exhausted, grown to %d users", m_allocated);
+    }
+    else if (!m_released.isEmpty())
+    {
+        // quietly, as people coming and going quickly do this every frame
+        user = m_released.first().user;
+        m_released.remove(0);
+    }
+    else
+    {
+        qDebug("[QNiTEUserPool::acquire] All %d users are tracked, ignoring user %d", m_maxSize, id);
+        return 0;
+    }
+
+    user->reset(id);
+    return user;
+}
+
+void QNiTEUserPool::release(QNiTEUser * user)
+{
+    if (!user)
+        return;
+
+    user->release();
+
+    Released released = { user, m_tick };
+    m_released.append(released);
+}
+
+void QNiTEUserPool::tick()
+{
+    ++m_tick;
+
+    int ready = 0;
+    while (ready < m_released.size() && m_tick - m_released[ready].tick >= quint64(m_releaseDelay))
+        m_free.append(m_released[ready++].user);
+
+    if (ready)
+        m_released.remove(0, ready);
+}
+
+QNiTEUser * QNiTEUserPool::create()
+{
+    QNiTEUser * user = new QNiTEUser(0, m_owner);
+    user->release();
+
+    // parented anyway, but QML must never collect a user it was handed
+    QQmlEngine::setObjectOwnership(user, QQmlEngine::CppOwnership);
+
+    ++m_allocated;
+    return user;
+}
@@ -0,0 +1,77 @@
+#ifndef QNITEUSERPOOL_H
+#define QNITEUSERPOOL_H
+
+#include <QVector>
+
+#include "qniteframe.h"
+
+class QObject;
+class QNiTEUser;
+
+#define QNITE_USER_POOL_SIZE 8
+
+/*
+ * Recycles QNiTEUser objects, so people coming and going do not allocate.
+ *
+ * Users are created up front and owned by the pool's owner until it is destroyed.
+ * A released user is kept aside, still valid but no longer tracked(), for
+ * releaseDelay ticks before it is handed out again. QML that still refers to a
+ * lost user therefore never sees a dangling object, but does see it turn into
+ * somebody else once it is reused, with a new userId and tracked() true again.
+ *
+ * If every object is busy the pool grows, up to maxSize, and keeps what it grew
+ * by. At maxSize the user released longest ago is reused before its delay is up,
+ * and with none released acquire() returns 0.
+ */
+class QNiTEUserPool
+{
+public:
+    explicit QNiTEUserPool(QObject * owner, int size = QNITE_USER_POOL_SIZE, int releaseDelay = 30);
+
+    // 0 when every user up to maxSize is taken
+    QNiTEUser * acquire(int id);
+    void release(QNiTEUser * user);
+
+    int maxSize() const
+    {
+        return m_maxSize;
+    }
+
+    // the source's maxUsers(); never below what is already allocated
+    void setMaxSize(int size);
+
+    // once per processed frame; makes users released long enough ago available again
+    void tick();
+
+    int allocated() const
+    {
+        return m_allocated;
+    }
+
+    int available() const
+    {
+        return m_free.size();
+    }
+
+private:
+    Q_DISABLE_COPY(QNiTEUserPool)
+
+    struct Released
+    {
+        QNiTEUser * user;
+        quint64 tick;
+    };
+
+    QNiTEUser * create();
+
+    QObject * m_owner;
+    int m_maxSize;
+    int m_releaseDelay;
+    int m_allocated;
+    quint64 m_tick;
+
+    QVector<QNiTEUser *> m_free;
+    QVector<Released> m_released; // oldest first
+};
+
+#endif // QNITEUSERPOOL_H
@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+SUBDIRS = \
+    colorconvert \
+    colorize \
+    imagescaler \
+    multisource \
+    pointcloud \
+    projection \
+    registration \
+    skeletonstream \
+    usermask \
+    userpool
@@ -0,0 +1,8 @@
+include(../../tests.pri)
+
+TARGET = tst_colorconvert
+
+SOURCES += \
+    tst_colorconvert.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qnitecolorconvert.cpp
@@ -0,0 +1,173 @@
+#include <QtTest>
+
+#include <random>
+#include <string.h>
+
+#include "qnitekerneltest.h"
+#include "qnitecolorconvert.h"
+
+class tst_ColorConvert : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernelsMatchScalar();
+    void wholeFrame();
+    void knownColors();
+};
+
+static const QNiTEColorFrame::PixelFormat s_formats[] = {
+    QNiTEColorFrame::RGB888,
+    QNiTEColorFrame::YUV422,
+    QNiTEColorFrame::YUYV,
+    QNiTEColorFrame::Gray8
+};
+
+static const int s_formatCount = int(sizeof(s_formats) / sizeof(s_formats[0]));
+
+// bytes in a row of count pixels; an odd last YUV pixel only has its Y and U
+static int rowBytes(QNiTEColorFrame::PixelFormat format, int count)
+{
+    switch (format)
+    {
+    case QNiTEColorFrame::RGB888: return 3 * count;
+    case QNiTEColorFrame::Gray8: return count;
+    default: return 2 * count;
+    }
+}
+
+static QString describe(QNiTEColorFrame::PixelFormat format, int count)
+{
+    return QString("%1, format %2, %3 pixels").arg(qniteColorConvertImplementation()).arg(int(format)).arg(count);
+}
+
+void tst_ColorConvert::kernelsMatchScalar()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(24);
+
+    const int maxCount = 70;
+    QVector<uchar> bytes(3 * maxCount);
+    for (int i = 0; i < bytes.size(); ++i)
+        bytes[i] = uchar(random());
+
+    QVector<quint32> expected(maxCount), colors(maxCount);
+
+    for (int f = 0; f < s_formatCount; ++f)
+    {
+        const QNiTEColorFrame::PixelFormat format = s_formats[f];
+
+        for (int count = 0; count <= maxCount; ++count)
+        {
+            // rows end where the buffer does, so reading past them is caught
+            // under a sanitizer, and start at every alignment
+            const uchar * in = bytes.constData() + bytes.size() - rowBytes(format, count);
+
+            qniteSetCpuFeatureMask(0);
+            qniteConvertColorRow(format, in, expected.data(), count);
+
+            for (int m = 0; m < s_kernelTestMaskCount - 1; ++m)
+            {
+                qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+                colors.fill(0x12345678);
+                qniteConvertColorRow(format, in, colors.data(), count);
+
+                // nothing may be written past count either
+                for (int i = 0; i < maxCount; ++i)
+                    QVERIFY2(colors[i] == (i < count ? expected[i] : 0x12345678u), qPrintable(describe(format, count)));
+            }
+        }
+    }
+}
+
+void tst_ColorConvert::wholeFrame()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(480);
+
+    // an odd width, and rows padded past it
+    const int width = 157, height = 11, stride = 3 * width + 5, outStride = width + 3;
+
+    QVector<uchar> bytes(stride * height);
+    for (int i = 0; i < bytes.size(); ++i)
+        bytes[i] = uchar(random());
+
+    QNiTEColorFrame frame;
+    frame.valid = true;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = stride;
+    frame.data = bytes.constData();
+
+    for (int f = 0; f < s_formatCount; ++f)
+    {
+        frame.pixelFormat = s_formats[f];
+
+        QVector<quint32> expected(outStride * height, 0);
+        qniteSetCpuFeatureMask(0);
+        qniteConvertColorFrame(frame, expected.data(), outStride * 4);
+
+        for (int m = 0; m < s_kernelTestMaskCount - 1; ++m)
+        {
+            qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+            QVector<quint32> colors(outStride * height, 0);
+            qniteConvertColorFrame(frame, colors.data(), outStride * 4);
+            QVERIFY2(colors == expected, qPrintable(describe(frame.pixelFormat, width)));
+        }
+    }
+}
+
+void tst_ColorConvert::knownColors()
+{
+    QNiTEKernelMaskGuard guard;
+
+    // 17 pixels each, to go through a vector and a tail
+    QVector<uchar> rgb, gray, yuyv, uyvy;
+    for (int i = 0; i < 17; ++i)
+    {
+        rgb << 0x10 << 0x80 << 0xf0;
+        gray << 0x7f;
+    }
+
+    // studio range white and black pairs, then a pure red one (Y 82, U 90, V 240)
+    for (int i = 0; i < 4; ++i)
+    {
+        yuyv << 235 << 128 << 16 << 128;
+        uyvy << 128 << 235 << 128 << 16;
+    }
+    yuyv << 82 << 90 << 82 << 240 << 235 << 128;
+    uyvy << 90 << 82 << 240 << 82 << 128 << 235;
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        QVector<quint32> colors(17);
+
+        qniteConvertColorRow(QNiTEColorFrame::RGB888, rgb.constData(), colors.data(), 17);
+        for (int i = 0; i < 17; ++i)
+            QCOMPARE(colors[i], quint32(0xff1080f0));
+
+        qniteConvertColorRow(QNiTEColorFrame::Gray8, gray.constData(), colors.data(), 17);
+        for (int i = 0; i < 17; ++i)
+            QCOMPARE(colors[i], quint32(0xff7f7f7f));
+
+        for (int yuv = 0; yuv < 2; ++yuv)
+        {
+            const QVector<uchar> & in = yuv ? uyvy : yuyv;
+            qniteConvertColorRow(yuv ? QNiTEColorFrame::YUV422 : QNiTEColorFrame::YUYV, in.constData(), colors.data(), 11);
+
+            for (int i = 0; i < 8; ++i)
+                QCOMPARE(colors[i], quint32(i % 2 ? 0xff000000 : 0xffffffff));
+
+            QVERIFY((colors[8] & 0xff0000) > 0xf00000 && (colors[8] & 0xffff) < 0x1010);
+            QCOMPARE(colors[10], quint32(0xffffffff));
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_ColorConvert)
+
+#include "tst_colorconvert.moc"
@@ -0,0 +1,8 @@
+include(../../tests.pri)
+
+TARGET = tst_colorize
+
+SOURCES += \
+    tst_colorize.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qnitecolorize.cpp
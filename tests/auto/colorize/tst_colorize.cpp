@@ -0,0 +1,135 @@
+#include <QtTest>
+
+#include <random>
+
+#include "qnitekerneltest.h"
+#include "qnitecolorize.h"
+
+class tst_Colorize : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernelsMatchFloatLoop();
+    void wholeFrame();
+};
+
+/*
+ * The loop QNiTETrackerRenderer used to fill its texture with: gray background,
+ * users through red, green and blue by id, black where there is no depth.
+ */
+static void colorizeFloat(const quint16 * depth, const qint16 * labels, const quint8 * lut, quint32 * out, int count)
+{
+    const float Colors[][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 1}};
+    const int colorCount = 3;
+
+    for (int i = 0; i < count; ++i)
+    {
+        quint8 r = 0, g = 0, b = 0;
+
+        if (depth[i] != 0)
+        {
+            const float * factor = labels[i] == 0 ? Colors[colorCount] : Colors[labels[i] % colorCount];
+
+            int nHistValue = lut[depth[i]];
+            r = nHistValue * factor[0];
+            g = nHistValue * factor[1];
+            b = nHistValue * factor[2];
+        }
+
+        out[i] = 0xff000000 | (r << 16) | (g << 8) | b;
+    }
+}
+
+static QVector<quint8> randomLut(std::mt19937 & random)
+{
+    QVector<quint8> lut(QNITE_DEPTH_LUT_SIZE);
+    for (int i = 0; i < lut.size(); ++i)
+        lut[i] = quint8(random());
+
+    lut[0] = 0;
+    return lut;
+}
+
+static QString describe(int count, int offset)
+{
+    return QString("%1, %2 pixels at +%3").arg(qniteColorizeImplementation()).arg(count).arg(offset);
+}
+
+void tst_Colorize::kernelsMatchFloatLoop()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(4);
+
+    const QVector<quint8> lut = randomLut(random);
+
+    // up to a few AVX2 vectors, so every tail length comes up, from unaligned starts
+    const int maxCount = 75, maxOffset = 3;
+    QVector<quint16> depth(maxCount + maxOffset);
+    QVector<qint16> labels(maxCount + maxOffset);
+
+    std::uniform_int_distribution<int> users(0, 15), holes(0, 5);
+    for (int i = 0; i < depth.size(); ++i)
+    {
+        // the whole 16 bit range, holes and the extremes
+        depth[i] = holes(random) ? quint16(random()) : 0;
+        labels[i] = i % 11 == 10 ? qint16(32767) : qint16(users(random));
+    }
+    depth[1] = 65535;
+
+    QVector<quint32> expected(maxCount), colors(maxCount);
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        for (int offset = 0; offset <= maxOffset; ++offset)
+        {
+            for (int count = 0; count <= maxCount; ++count)
+            {
+                colorizeFloat(depth.constData() + offset, labels.constData() + offset, lut.constData(), expected.data(), count);
+
+                // anything written past count shows up as a mismatch
+                colors.fill(0x12345678);
+                qniteColorizeDepth(depth.constData() + offset, labels.constData() + offset, lut.constData(), colors.data(), count);
+
+                for (int i = 0; i < maxCount; ++i)
+                    QVERIFY2(colors[i] == (i < count ? expected[i] : 0x12345678u), qPrintable(describe(count, offset)));
+            }
+        }
+    }
+}
+
+void tst_Colorize::wholeFrame()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(640);
+
+    const QVector<quint8> lut = randomLut(random);
+    const int count = 640 * 480;
+
+    // smooth depth with a few users standing in it, like a real frame
+    QVector<quint16> depth(count);
+    QVector<qint16> labels(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const int x = i % 640, y = i / 640;
+        depth[i] = (x + y) % 97 ? quint16(800 + 4 * x + y) : 0;
+        labels[i] = qint16(x > 100 && x < 540 && y > 50 ? 1 + x / 110 : 0);
+    }
+
+    QVector<quint32> expected(count), colors(count);
+    colorizeFloat(depth.constData(), labels.constData(), lut.constData(), expected.data(), count);
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        qniteColorizeDepth(depth.constData(), labels.constData(), lut.constData(), colors.data(), count);
+        QVERIFY2(colors == expected, qniteColorizeImplementation());
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_Colorize)
+
+#include "tst_colorize.moc"
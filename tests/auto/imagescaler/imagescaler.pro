@@ -0,0 +1,8 @@
+include(../../tests.pri)
+
+TARGET = tst_imagescaler
+
+SOURCES += \
+    tst_imagescaler.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qniteimagescaler.cpp
@@ -0,0 +1,121 @@
+#include <QtTest>
+
+#include <random>
+#include <string.h>
+
+#include "qnitekerneltest.h"
+#include "qniteimagescaler.h"
+
+class tst_ImageScaler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernelsMatchScalar();
+    void uniformStaysUniform();
+    void boxAverages();
+};
+
+// padded rows, so the strides differ from the widths
+static QVector<quint32> randomImage(std::mt19937 & random, int height, int stride)
+{
+    QVector<quint32> image(stride * height);
+    for (int i = 0; i < image.size(); ++i)
+        image[i] = quint32(random());
+    return image;
+}
+
+void tst_ImageScaler::kernelsMatchScalar()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(25);
+
+    // integer fractions, odd leftovers and plain bilinear, with every tail length
+    const QSize sizes[][2] = {
+        { QSize(640, 480), QSize(160, 120) },
+        { QSize(640, 480), QSize(200, 150) },
+        { QSize(37, 23), QSize(5, 3) },
+        { QSize(37, 23), QSize(19, 22) },
+        { QSize(13, 9), QSize(13, 9) },
+        { QSize(9, 5), QSize(1, 1) },
+        { QSize(3, 3), QSize(7, 5) },
+    };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        const QSize in = sizes[s][0], out = sizes[s][1];
+        const int inStride = in.width() + 3, outStride = out.width() + 1;
+        const QVector<quint32> image = randomImage(random, in.height(), inStride);
+
+        QNiTEImageScaler scaler;
+        QVector<quint32> expected(outStride * out.height(), 0);
+
+        qniteSetCpuFeatureMask(0);
+        scaler.scale(image.constData(), in.width(), in.height(), inStride * 4,
+                     expected.data(), out.width(), out.height(), outStride * 4);
+
+        for (int m = 0; m < s_kernelTestMaskCount - 1; ++m)
+        {
+            qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+            QVector<quint32> scaled(outStride * out.height(), 0);
+            scaler.scale(image.constData(), in.width(), in.height(), inStride * 4,
+                         scaled.data(), out.width(), out.height(), outStride * 4);
+
+            for (int y = 0; y < out.height(); ++y)
+            {
+                QVERIFY2(memcmp(scaled.constData() + y * outStride, expected.constData() + y * outStride, out.width() * 4) == 0,
+                         qPrintable(QString("%1, %2x%3 row %4").arg(qniteImageScaleImplementation())
+                                    .arg(out.width()).arg(out.height()).arg(y)));
+            }
+        }
+    }
+}
+
+void tst_ImageScaler::uniformStaysUniform()
+{
+    QNiTEKernelMaskGuard guard;
+
+    const QVector<quint32> image(37 * 23, 0xff3c7fc8);
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        QNiTEImageScaler scaler;
+        QVector<quint32> scaled(11 * 7, 0);
+        scaler.scale(image.constData(), 37, 23, 37 * 4, scaled.data(), 11, 7, 11 * 4);
+
+        for (int i = 0; i < scaled.size(); ++i)
+            QCOMPARE(scaled[i], quint32(0xff3c7fc8));
+    }
+}
+
+void tst_ImageScaler::boxAverages()
+{
+    QNiTEKernelMaskGuard guard;
+
+    // 2x2 blocks of 0x00, 0x10, 0x20 and 0x30 in every channel
+    QVector<quint32> image(4 * 2);
+    for (int x = 0; x < 4; ++x)
+    {
+        image[x] = (x % 2 ? 0x10101010 : 0);
+        image[4 + x] = (x % 2 ? 0x30303030 : 0x20202020);
+    }
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        QNiTEImageScaler scaler;
+        QVector<quint32> scaled(2, 0);
+        scaler.scale(image.constData(), 4, 2, 4 * 4, scaled.data(), 2, 1, 2 * 4);
+
+        QCOMPARE(scaled[0], quint32(0x18181818));
+        QCOMPARE(scaled[1], quint32(0x18181818));
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_ImageScaler)
+
+#include "tst_imagescaler.moc"
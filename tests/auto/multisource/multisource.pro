@@ -0,0 +1,6 @@
+include(../../tests.pri)
+include(../../qnite.pri)
+
+TARGET = tst_multisource
+
+SOURCES += tst_multisource.cpp
@@ -0,0 +1,242 @@
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "qnitemultisource.h"
+#include "qnitescriptedsource.h"
+#include "qniteskeletoncapture.h"
+
+/*
+ * QNiTEMultiSource replaying one skeleton capture per sensor. Two sensors face
+ * each other across the room: both see person A, only the second sees person B.
+ * The primary loses A halfway through, and later the second sensor loses B.
+ */
+class tst_MultiSource : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void mergesUsersSeenTwice();
+    void keepsMergedIdsWhileTracked();
+    void reportsLostUsersOnce();
+
+private:
+    QVector<QNiTETrackerFrame> replay();
+
+    QTemporaryDir m_dir;
+    QStringList m_recordings;
+    QMatrix4x4 m_extrinsics[2];
+};
+
+static const int s_frames = 10;
+static const int s_primaryLosesA = 5;
+static const int s_secondLosesB = 8;
+
+static const QVector3D s_personA(0, 0, 2000);
+static const QVector3D s_personB(600, 0, 2500);
+
+// a user at a position in the sensor's own space
+static QNiTEUserData userAt(int id, const QVector3D & position)
+{
+    QNiTEUserData user;
+    user.id = id;
+    user.isVisible = true;
+    user.skeletonTracked = true;
+    user.centerOfMass = position;
+    user.boundingMin = position - QVector3D(250, 900, 150);
+    user.boundingMax = position + QVector3D(250, 900, 150);
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        user.joints[j].position = position;
+        user.joints[j].confidence = 1.0f;
+    }
+
+    return user;
+}
+
+void tst_MultiSource::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    // the second sensor stands 4 m in front of the primary, facing it
+    m_extrinsics[1].translate(0, 0, 4000);
+    m_extrinsics[1].rotate(180, 0, 1, 0);
+
+    for (int s = 0; s < 2; ++s)
+    {
+        const QMatrix4x4 toSensor = m_extrinsics[s].inverted();
+        const QString fileName = m_dir.filePath(QString("sensor%1.qsk").arg(s));
+
+        QNiTESkeletonWriter writer;
+        QVERIFY2(writer.open(fileName), qPrintable(writer.errorString()));
+
+        for (int i = 0; i < s_frames; ++i)
+        {
+            QNiTETrackerFrame frame;
+            frame.valid = true;
+            frame.frameIndex = i;
+
+            if (s == 1 || i <= s_primaryLosesA)
+            {
+                QNiTEUserData a = userAt(1, toSensor.map(s_personA + QVector3D(i * 10, 0, 0)));
+                a.isNew = i == 0;
+                a.isLost = s == 0 && i == s_primaryLosesA;
+                frame.users.append(a);
+            }
+
+            if (s == 1 && i <= s_secondLosesB)
+            {
+                QNiTEUserData b = userAt(2, toSensor.map(s_personB));
+                b.isNew = i == 0;
+                b.isLost = i == s_secondLosesB;
+                frame.users.append(b);
+            }
+
+            QVERIFY(writer.append(frame));
+        }
+
+        writer.close();
+        m_recordings.append(fileName);
+    }
+}
+
+// plays the recordings back frame by frame, the primary last, and returns what
+// the merged source reports for each frame
+QVector<QNiTETrackerFrame> tst_MultiSource::replay()
+{
+    QVector<QNiTETrackerFrame> merged;
+
+    QNiTESkeletonReader readers[2];
+    QNiTEScriptedSource * sensors[2];
+    QNiTEMultiSource source;
+
+    for (int s = 0; s < 2; ++s)
+    {
+        if (!readers[s].open(m_recordings[s]) || readers[s].frameCount() != s_frames)
+            return merged;
+
+        sensors[s] = new QNiTEScriptedSource();
+        source.addSensor(sensors[s], m_extrinsics[s]);
+    }
+
+    if (!source.open())
+        return merged;
+
+    for (int i = 0; i < s_frames; ++i)
+    {
+        for (int s = 1; s >= 0; --s)
+        {
+            QNiTETrackerFrame frame;
+            frame.valid = readers[s].readUsers(i, &frame.users);
+            frame.frameIndex = i;
+            sensors[s]->pushTrackerFrame(frame);
+        }
+
+        QNiTETrackerFrame frame;
+        source.readTrackerFrame(&frame);
+        merged.append(frame);
+    }
+
+    source.close();
+    return merged;
+}
+
+static int findUser(const QNiTETrackerFrame & frame, const QVector3D & position)
+{
+    for (int u = 0; u < frame.users.size(); ++u)
+    {
+        if (!frame.users[u].isLost && (frame.users[u].centerOfMass - position).length() < 100.0f)
+            return u;
+    }
+    return -1;
+}
+
+void tst_MultiSource::mergesUsersSeenTwice()
+{
+    const QVector<QNiTETrackerFrame> merged = replay();
+    QCOMPARE(merged.size(), s_frames);
+
+    for (int i = 0; i < s_frames; ++i)
+    {
+        const QNiTETrackerFrame & frame = merged[i];
+        QVERIFY(frame.valid);
+
+        // A and B once each, whoever sees them
+        QSet<int> ids;
+        int present = 0;
+
+        for (int u = 0; u < frame.users.size(); ++u)
+        {
+            QVERIFY2(!ids.contains(frame.users[u].id), qPrintable(QString("duplicate id %1 in frame %2").arg(frame.users[u].id).arg(i)));
+            ids.insert(frame.users[u].id);
+
+            if (!frame.users[u].isLost)
+                ++present;
+        }
+
+        QCOMPARE(present, i < s_secondLosesB ? 2 : 1);
+        QVERIFY(findUser(frame, s_personA + QVector3D(i * 10, 0, 0)) >= 0);
+
+        // B is only seen by the second sensor, so keeps its id there
+        const int b = findUser(frame, s_personB);
+        if (i < s_secondLosesB)
+        {
+            QVERIFY(b >= 0);
+            QCOMPARE(frame.users[b].id, 1 * QNITE_MULTI_SOURCE_ID_STRIDE + 2);
+            QCOMPARE(frame.users[b].isNew, i == 0);
+        }
+    }
+}
+
+void tst_MultiSource::keepsMergedIdsWhileTracked()
+{
+    const QVector<QNiTETrackerFrame> merged = replay();
+    QCOMPARE(merged.size(), s_frames);
+
+    // A takes the primary's id, and keeps it after the primary loses them
+    for (int i = 0; i < s_frames; ++i)
+    {
+        const int a = findUser(merged[i], s_personA + QVector3D(i * 10, 0, 0));
+        QVERIFY(a >= 0);
+        QCOMPARE(merged[i].users[a].id, 1);
+        QCOMPARE(merged[i].users[a].isNew, i == 0);
+    }
+}
+
+void tst_MultiSource::reportsLostUsersOnce()
+{
+    const QVector<QNiTETrackerFrame> merged = replay();
+    QCOMPARE(merged.size(), s_frames);
+
+    const int idB = 1 * QNITE_MULTI_SOURCE_ID_STRIDE + 2;
+
+    for (int i = 0; i < s_frames; ++i)
+    {
+        int lostB = 0;
+
+        for (int u = 0; u < merged[i].users.size(); ++u)
+        {
+            const QNiTEUserData & user = merged[i].users[u];
+
+            // the primary losing A is not A leaving; the second sensor still sees them
+            if (user.id == 1)
+                QVERIFY(!user.isLost);
+
+            if (user.id == idB && user.isLost)
+                ++lostB;
+        }
+
+        // B is reported lost on the frame the only sensor seeing them does, then gone
+        QCOMPARE(lostB, i == s_secondLosesB ? 1 : 0);
+    }
+
+    const QNiTETrackerFrame & last = merged[s_frames - 1];
+    for (int u = 0; u < last.users.size(); ++u)
+        QVERIFY(last.users[u].id != idB);
+}
+
+QTEST_APPLESS_MAIN(tst_MultiSource)
+
+#include "tst_multisource.moc"
@@ -0,0 +1,8 @@
+include(../../tests.pri)
+
+TARGET = tst_pointcloud
+
+SOURCES += \
+    tst_pointcloud.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qnitepointcloud.cpp
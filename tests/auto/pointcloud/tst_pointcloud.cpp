@@ -0,0 +1,122 @@
+#include <QtTest>
+
+#include <random>
+#include <string.h>
+
+#include "qnitekerneltest.h"
+#include "qnitepointcloud.h"
+
+class tst_PointCloud : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernelsMatchScalar();
+    void imageCenter();
+};
+
+static QNiTEDepthIntrinsics kinectIntrinsics(int width, int height)
+{
+    QNiTEDepthIntrinsics intrinsics;
+    intrinsics.horizontalFov = 1.0144f;
+    intrinsics.verticalFov = 0.7898f;
+    intrinsics.resolutionX = width;
+    intrinsics.resolutionY = height;
+    return intrinsics;
+}
+
+// random depth with holes, and a few users
+static QNiTETrackerFrame randomFrame(std::mt19937 & random, int width, int height,
+                                     QVector<quint16> & depth, QVector<qint16> & labels)
+{
+    std::uniform_int_distribution<int> depths(1, 8000), holes(0, 4), users(0, 3);
+
+    depth.resize(width * height);
+    labels.resize(width * height);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        depth[i] = holes(random) ? quint16(depths(random)) : 0;
+        labels[i] = qint16(users(random));
+    }
+
+    QNiTETrackerFrame frame;
+    frame.valid = true;
+    frame.resolutionX = frame.width = width;
+    frame.resolutionY = frame.height = height;
+    frame.depthStride = width * sizeof(quint16);
+    frame.depth = depth.constData();
+    frame.labels = labels.constData();
+    return frame;
+}
+
+void tst_PointCloud::kernelsMatchScalar()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(18);
+
+    // odd widths leave every SIMD tail length once holes are compacted away
+    const int widths[] = { 1, 3, 4, 7, 37, 640 };
+    const int selections[] = { QNiTEPointCloud::AllPixels, QNiTEPointCloud::AnyUser, 2 };
+
+    QVector<quint16> depth;
+    QVector<qint16> labels;
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+    {
+        const QNiTETrackerFrame frame = randomFrame(random, widths[w], 9, depth, labels);
+        const QNiTEDepthIntrinsics intrinsics = kinectIntrinsics(frame.width, frame.height);
+
+        for (size_t s = 0; s < sizeof(selections) / sizeof(selections[0]); ++s)
+        {
+            for (int voxel = 0; voxel <= 50; voxel += 50)
+            {
+                QNiTEPointCloud cloud;
+                cloud.setUserId(selections[s]);
+                cloud.setVoxelSize(voxel);
+
+                qniteSetCpuFeatureMask(0);
+                cloud.generate(frame, intrinsics);
+                QVector<QNiTEPoint> expected(cloud.count());
+                memcpy(expected.data(), cloud.points(), expected.size() * sizeof(QNiTEPoint));
+
+                for (int m = 0; m < s_kernelTestMaskCount - 1; ++m)
+                {
+                    qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+                    cloud.generate(frame, intrinsics);
+
+                    QCOMPARE(cloud.count(), expected.size());
+                    QVERIFY2(memcmp(cloud.points(), expected.constData(), expected.size() * sizeof(QNiTEPoint)) == 0,
+                             qPrintable(QString("%1, width %2").arg(qnitePointCloudImplementation()).arg(frame.width)));
+                }
+            }
+        }
+    }
+}
+
+void tst_PointCloud::imageCenter()
+{
+    QVector<quint16> depth(4 * 4, 0);
+    depth[2 * 4 + 2] = 1000;
+
+    QNiTETrackerFrame frame;
+    frame.valid = true;
+    frame.resolutionX = frame.width = 4;
+    frame.resolutionY = frame.height = 4;
+    frame.depthStride = 4 * sizeof(quint16);
+    frame.depth = depth.constData();
+
+    QNiTEPointCloud cloud;
+    QCOMPARE(cloud.generate(frame, kinectIntrinsics(4, 4)), 1);
+
+    // the center pixel lies straight ahead of the camera
+    const QNiTEPoint & point = cloud.points()[0];
+    QCOMPARE(point.x, 0.0f);
+    QCOMPARE(point.y, 0.0f);
+    QCOMPARE(point.z, 1000.0f);
+    QCOMPARE(point.userId, 0);
+}
+
+QTEST_APPLESS_MAIN(tst_PointCloud)
+
+#include "tst_pointcloud.moc"
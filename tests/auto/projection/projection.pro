@@ -0,0 +1,8 @@
+include(../../tests.pri)
+
+TARGET = tst_projection
+
+SOURCES += \
+    tst_projection.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qniteprojection.cpp
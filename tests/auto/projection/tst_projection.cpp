@@ -0,0 +1,86 @@
+#include <QtTest>
+
+#include <random>
+#include <string.h>
+
+#include "qnitekerneltest.h"
+#include "qniteprojection.h"
+
+class tst_Projection : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void batchMatchesSinglePoints();
+    void behindTheCamera();
+};
+
+static QNiTEDepthIntrinsics kinectIntrinsics()
+{
+    QNiTEDepthIntrinsics intrinsics;
+    intrinsics.horizontalFov = 1.0144f;
+    intrinsics.verticalFov = 0.7898f;
+    intrinsics.resolutionX = 640;
+    intrinsics.resolutionY = 480;
+    return intrinsics;
+}
+
+static quint32 bitsOf(float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+void tst_Projection::batchMatchesSinglePoints()
+{
+    QNiTEKernelMaskGuard guard;
+    const QNiTEDepthIntrinsics intrinsics = kinectIntrinsics();
+
+    std::mt19937 random(16);
+    std::uniform_real_distribution<float> lateral(-2000, 2000), depth(-100, 6000);
+
+    // up to 37 points covers whole SSE2 blocks and every tail length after them
+    const int maxCount = 37;
+    float x[maxCount], y[maxCount], z[maxCount], outX[maxCount], outY[maxCount];
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        for (int count = 0; count <= maxCount; ++count)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                x[i] = lateral(random);
+                y[i] = lateral(random);
+                z[i] = i % 5 == 0 ? 0.0f : depth(random);
+            }
+
+            qniteProjectToDepth(intrinsics, x, y, z, outX, outY, count);
+
+            for (int i = 0; i < count; ++i)
+            {
+                const QPointF expected = qniteProjectToDepth(intrinsics, QVector3D(x[i], y[i], z[i]));
+
+                QVERIFY2(bitsOf(outX[i]) == bitsOf(float(expected.x())) && bitsOf(outY[i]) == bitsOf(float(expected.y())),
+                         qPrintable(QString("%1, point %2 of %3").arg(qniteProjectionImplementation()).arg(i).arg(count)));
+            }
+        }
+    }
+}
+
+void tst_Projection::behindTheCamera()
+{
+    const QNiTEDepthIntrinsics intrinsics = kinectIntrinsics();
+
+    QCOMPARE(qniteProjectToDepth(intrinsics, QVector3D(100, 100, 0)), QPointF(0, 0));
+    QCOMPARE(qniteProjectToDepth(intrinsics, QVector3D(100, 100, -50)), QPointF(0, 0));
+
+    // straight ahead is the image center
+    QCOMPARE(qniteProjectToDepth(intrinsics, QVector3D(0, 0, 1000)), QPointF(320, 240));
+}
+
+QTEST_APPLESS_MAIN(tst_Projection)
+
+#include "tst_projection.moc"
@@ -0,0 +1,8 @@
+include(../../tests.pri)
+
+TARGET = tst_registration
+
+SOURCES += \
+    tst_registration.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qniteregistration.cpp
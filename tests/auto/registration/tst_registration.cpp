@@ -0,0 +1,140 @@
+#include <QtTest>
+
+#include <random>
+#include <string.h>
+
+#include "qnitekerneltest.h"
+#include "qniteframesource.h"
+#include "qniteregistration.h"
+
+/*
+ * Color camera 25 mm to the side of the depth one, at twice its resolution: close
+ * pixels move further than far ones, and some fall off the image.
+ */
+class ParallaxSource : public QNiTEFrameSource
+{
+public:
+    bool open() { return true; }
+    void close() {}
+    void setColorEnabled(bool) {}
+    bool readTrackerFrame(QNiTETrackerFrame *) { return false; }
+    bool readColorFrame(QNiTEColorFrame *) { return false; }
+    QPointF toDepthSpace(const QVector3D &) const { return QPointF(); }
+
+    bool depthToColor(int x, int y, quint16 depth, QPointF * color) const
+    {
+        *color = QPointF(2 * x + 25000.0 / depth, 2 * y + 1000.0 / depth);
+        return true;
+    }
+};
+
+class tst_Registration : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernelsMatchScalar();
+    void plainScalingKeepsFrame();
+};
+
+static QNiTETrackerFrame randomFrame(std::mt19937 & random, int resolutionX, int resolutionY, int width, int height,
+                                     QVector<quint16> & depth, QVector<qint16> & labels)
+{
+    std::uniform_int_distribution<int> depths(1, 8000), holes(0, 4), users(0, 3);
+    std::uniform_int_distribution<int> originX(0, resolutionX - width), originY(0, resolutionY - height);
+
+    depth.resize(width * height);
+    labels.resize(width * height);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        // very close pixels land past the right edge
+        depth[i] = holes(random) ? quint16(depths(random)) : 0;
+        labels[i] = qint16(users(random));
+    }
+
+    QNiTETrackerFrame frame;
+    frame.valid = true;
+    frame.resolutionX = resolutionX;
+    frame.resolutionY = resolutionY;
+    frame.width = width;
+    frame.height = height;
+    frame.cropOriginX = originX(random);
+    frame.cropOriginY = originY(random);
+    frame.depthStride = width * sizeof(quint16);
+    frame.depth = depth.constData();
+    frame.labels = labels.constData();
+    return frame;
+}
+
+void tst_Registration::kernelsMatchScalar()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(23);
+    ParallaxSource source;
+
+    QVector<quint16> depth;
+    QVector<qint16> labels;
+
+    // every row length up to a few vectors, whole and cropped
+    for (int width = 1; width <= 37; ++width)
+    {
+        const QSharedPointer<const QNiTERegistrationTable> table =
+            QNiTERegistrationTable::build(source, width + 3, 7, 2 * (width + 3), 14);
+        QVERIFY(table->shiftX() > 0);
+
+        const QNiTETrackerFrame frame = randomFrame(random, width + 3, 7, width, 5, depth, labels);
+
+        QNiTEDepthRegistration scalar;
+        qniteSetCpuFeatureMask(0);
+        QVERIFY(scalar.apply(*table, frame));
+
+        for (int m = 0; m < s_kernelTestMaskCount - 1; ++m)
+        {
+            qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+            QNiTEDepthRegistration registration;
+            QVERIFY(registration.apply(*table, frame));
+
+            const int size = registration.width() * registration.height();
+            QVERIFY2(memcmp(registration.depth(), scalar.depth(), size * sizeof(quint16)) == 0,
+                     qPrintable(QString("%1, width %2").arg(qniteRegistrationImplementation()).arg(width)));
+            QVERIFY2(memcmp(registration.labels(), scalar.labels(), size * sizeof(qint16)) == 0,
+                     qPrintable(QString("%1, width %2").arg(qniteRegistrationImplementation()).arg(width)));
+        }
+    }
+}
+
+void tst_Registration::plainScalingKeepsFrame()
+{
+    QNiTEKernelMaskGuard guard;
+    std::mt19937 random(5);
+
+    QVector<quint16> depth;
+    QVector<qint16> labels;
+    QNiTETrackerFrame frame = randomFrame(random, 13, 4, 13, 4, depth, labels);
+
+    const QNiTERegistrationTable table(13, 4, 26, 8);
+
+    for (int m = 0; m < s_kernelTestMaskCount; ++m)
+    {
+        qniteSetCpuFeatureMask(s_kernelTestMasks[m]);
+
+        QNiTEDepthRegistration registration;
+        QVERIFY(registration.apply(table, frame));
+        QCOMPARE(memcmp(registration.depth(), depth.constData(), depth.size() * sizeof(quint16)), 0);
+
+        // labels only come along with depth
+        for (int i = 0; i < labels.size(); ++i)
+            QCOMPARE(registration.labels()[i], depth[i] ? labels[i] : qint16(0));
+    }
+
+    // other depth video modes are left alone
+    frame.resolutionX = 12;
+    QNiTEDepthRegistration registration;
+    QVERIFY(!registration.apply(table, frame));
+}
+
+QTEST_APPLESS_MAIN(tst_Registration)
+
+#include "tst_registration.moc"
@@ -0,0 +1,7 @@
+include(../../tests.pri)
+
+TARGET = tst_skeletonstream
+
+SOURCES += \
+    tst_skeletonstream.cpp \
+    $$QNITE_SRC/qniteskeletonstream.cpp
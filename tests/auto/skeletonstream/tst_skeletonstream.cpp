@@ -0,0 +1,443 @@
+#include <QtTest>
+#include <QtEndian>
+
+#include <random>
+
+#include "qniteskeletonstream.h"
+
+/*
+ * QNiTESkeletonEncoder and QNiTESkeletonDecoder over a scripted sequence: user 1
+ * is there throughout, user 2 appears, is lost and goes away, and user 3 joins
+ * halfway. Everyone moves a little every frame, and the floor is refined now and then.
+ */
+class tst_SkeletonStream : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void roundTrip_data();
+    void roundTrip();
+    void removesLostUsers();
+    void joinMidStream();
+    void truncatedMessage();
+    void malformedMessage();
+    void oversizedLength();
+
+private:
+    QVector<QNiTETrackerFrame> m_frames;
+};
+
+static const int s_frames = 40;
+static const int s_secondAppears = 5;
+static const int s_secondLost = 20;
+static const int s_thirdAppears = 12;
+
+static QNiTEUserData randomUser(std::mt19937 & random, int id)
+{
+    std::uniform_real_distribution<float> position(-2000.0f, 2000.0f), confidence(0.0f, 1.0f);
+
+    QNiTEUserData user;
+    user.id = id;
+    user.isVisible = true;
+    user.centerOfMass = QVector3D(position(random), position(random), position(random));
+    user.boundingMin = user.centerOfMass - QVector3D(250, 900, 150);
+    user.boundingMax = user.centerOfMass + QVector3D(250, 900, 150);
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        user.joints[j].position = QVector3D(position(random), position(random), position(random));
+        user.joints[j].confidence = confidence(random);
+    }
+
+    return user;
+}
+
+// moves some of the joints by up to a few centimeters, leaving the rest where they were
+static void move(std::mt19937 & random, QNiTEUserData & user)
+{
+    std::uniform_real_distribution<float> step(-30.0f, 30.0f), confidence(0.0f, 1.0f);
+    std::uniform_int_distribution<int> moves(0, 2);
+
+    user.centerOfMass += QVector3D(step(random), step(random), step(random));
+    user.boundingMin = user.centerOfMass - QVector3D(250, 900, 150);
+    user.boundingMax = user.centerOfMass + QVector3D(250, 900, 150);
+
+    for (int j = 0; j < QNITE_JOINT_COUNT; ++j)
+    {
+        if (moves(random) == 0)
+            continue;
+
+        user.joints[j].position += QVector3D(step(random), step(random), step(random));
+        user.joints[j].confidence = confidence(random);
+    }
+}
+
+void tst_SkeletonStream::initTestCase()
+{
+    std::mt19937 random(21);
+    std::uniform_real_distribution<float> jitter(-5.0f, 5.0f);
+
+    QNiTEUserData users[3];
+    for (int u = 0; u < 3; ++u)
+        users[u] = randomUser(random, u + 1);
+
+    for (int i = 0; i < s_frames; ++i)
+    {
+        QNiTETrackerFrame frame;
+        frame.valid = true;
+        frame.frameIndex = 100 + i;
+        frame.timestamp = 5000000 + quint64(i) * 33333;
+
+        frame.floorPoint = QVector3D(12.3f, -1100.0f, 2500.0f);
+        frame.floorNormal = QVector3D(0.01f, 0.9998f, -0.015f);
+        frame.floorConfidence = 0.5f;
+        if (i % 10 == 3)
+        {
+            frame.floorPoint += QVector3D(jitter(random), jitter(random), jitter(random));
+            frame.floorConfidence = 0.9f;
+        }
+
+        for (int u = 0; u < 3; ++u)
+            move(random, users[u]);
+
+        frame.users.append(users[0]);
+
+        if (i >= s_secondAppears && i <= s_secondLost)
+        {
+            QNiTEUserData second = users[1];
+            second.isNew = i == s_secondAppears;
+            second.isLost = i == s_secondLost;
+            second.isVisible = !second.isLost;
+            frame.users.append(second);
+        }
+
+        if (i >= s_thirdAppears)
+        {
+            QNiTEUserData third = users[2];
+            third.isNew = i == s_thirdAppears;
+            third.skeletonTracked = i > s_thirdAppears + 2;
+            frame.users.append(third);
+        }
+
+        m_frames.append(frame);
+    }
+}
+
+static inline QVector3D quantized(const QVector3D & v)
+{
+    return QVector3D(qRound(v.x()), qRound(v.y()), qRound(v.z()));
+}
+
+static inline float quantized(float confidence)
+{
+    return qRound(confidence * 255) / 255.0f;
+}
+
+// what the decoder should hold after frame, up to quantization
+static bool matches(const QNiTESkeletonDecoder & decoder, const QNiTETrackerFrame & frame, QString * error)
+{
+    if (decoder.frameIndex() != frame.frameIndex || decoder.timestamp() != frame.timestamp)
+    {
+        *error = QString("frame %1 decoded as %2").arg(frame.frameIndex).arg(decoder.frameIndex());
+        return false;
+    }
+
+    if (decoder.floorPoint() != quantized(frame.floorPoint) || decoder.floorConfidence() != quantized(frame.floorConfidence) ||
+        (decoder.floorNormal() - frame.floorNormal).length() > 1e-4f)
+    {
+        *error = QString("frame %1: floor differs").arg(frame.frameIndex);
+        return false;
+    }
+
+    const QVector<QNiTEUserData> & users = decoder.users();
+    if (users.size() != frame.users.size())
+    {
+        *error = QString("frame %1: %2 users decoded, %3 sent").arg(frame.frameIndex).arg(users.size()).arg(frame.users.size());
+        return false;
+    }
+
+    // the decoder lists users in the order it first saw them
+    for (int u = 0; u < frame.users.size(); ++u)
+    {
+        const QNiTEUserData & sent = frame.users[u];
+
+        int d = 0;
+        while (d < users.size() && users[d].id != sent.id)
+            ++d;
+
+        if (d == users.size())
+        {
+            *error = QString("frame %1: user %2 missing").arg(frame.frameIndex).arg(sent.id);
+            return false;
+        }
+
+        const QNiTEUserData & user = users[d];
+        bool same = user.isNew == sent.isNew && user.isLost == sent.isLost &&
+                    user.isVisible == sent.isVisible && user.skeletonTracked == sent.skeletonTracked &&
+                    user.centerOfMass == quantized(sent.centerOfMass) &&
+                    user.boundingMin == quantized(sent.boundingMin) &&
+                    user.boundingMax == quantized(sent.boundingMax);
+
+        for (int j = 0; j < QNITE_JOINT_COUNT && same; ++j)
+        {
+            same = user.joints[j].position == quantized(sent.joints[j].position) &&
+                   user.joints[j].confidence == quantized(sent.joints[j].confidence);
+        }
+
+        if (!same)
+        {
+            *error = QString("frame %1: user %2 differs").arg(frame.frameIndex).arg(sent.id);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static QByteArray withLength(quint32 size)
+{
+    QByteArray prefix(4, '\0');
+    qToLittleEndian<quint32>(size, reinterpret_cast<uchar *>(prefix.data()));
+    return prefix;
+}
+
+void tst_SkeletonStream::roundTrip_data()
+{
+    QTest::addColumn<int>("keyframeInterval");
+
+    QTest::newRow("keyframes only on request") << 0;
+    QTest::newRow("every frame a keyframe") << 1;
+    QTest::newRow("every 7 frames") << 7;
+    QTest::newRow("default") << QNITE_STREAM_DEFAULT_KEYFRAME_INTERVAL;
+}
+
+void tst_SkeletonStream::roundTrip()
+{
+    QFETCH(int, keyframeInterval);
+
+    QNiTESkeletonEncoder encoder;
+    encoder.setKeyframeInterval(keyframeInterval);
+    QNiTESkeletonDecoder decoder;
+    QByteArray message;
+
+    for (int i = 0; i < m_frames.size(); ++i)
+    {
+        const bool keyframe = encoder.encode(m_frames[i], &message);
+        QCOMPARE(keyframe, i == 0 || (keyframeInterval > 0 && i % keyframeInterval == 0));
+
+        decoder.append(message);
+        QVERIFY(decoder.decodeNext());
+        QVERIFY(!decoder.decodeNext());
+
+        QString error;
+        QVERIFY2(matches(decoder, m_frames[i], &error), qPrintable(error));
+    }
+
+    QCOMPARE(decoder.skipped(), quint64(0));
+    QVERIFY(!decoder.isBroken());
+}
+
+void tst_SkeletonStream::removesLostUsers()
+{
+    QNiTESkeletonEncoder encoder;
+    encoder.setKeyframeInterval(0);
+    QNiTESkeletonDecoder decoder;
+    QByteArray message;
+
+    for (int i = 0; i <= s_secondLost + 1; ++i)
+    {
+        encoder.encode(m_frames[i], &message);
+        decoder.append(message);
+        QVERIFY(decoder.decodeNext());
+
+        bool second = false;
+        for (int u = 0; u < decoder.users().size(); ++u)
+        {
+            if (decoder.users()[u].id == 2)
+            {
+                second = true;
+                QCOMPARE(decoder.users()[u].isLost, i == s_secondLost);
+            }
+        }
+
+        // reported once as lost, then gone
+        QCOMPARE(second, i >= s_secondAppears && i <= s_secondLost);
+    }
+
+    // a still frame sends nothing but the frame header
+    QNiTETrackerFrame still = m_frames[s_secondLost + 1];
+    still.frameIndex++;
+    encoder.encode(still, &message);
+    QVERIFY(message.size() < 16);
+
+    decoder.append(message);
+    QVERIFY(decoder.decodeNext());
+
+    QString error;
+    QVERIFY2(matches(decoder, still, &error), qPrintable(error));
+}
+
+void tst_SkeletonStream::joinMidStream()
+{
+    static const int joins = 10;
+    static const int keyframeAt = 13;
+
+    QNiTESkeletonEncoder encoder;
+    encoder.setKeyframeInterval(0);
+    QNiTESkeletonDecoder decoder;
+    QByteArray message;
+
+    for (int i = 0; i < m_frames.size(); ++i)
+    {
+        QVERIFY(!encoder.encode(m_frames[i], &message) || i == 0);
+
+        if (i < joins)
+            continue;
+
+        // the server sends a joining client the current frame as a keyframe
+        if (i == keyframeAt)
+            encoder.encodeKeyframe(&message);
+
+        decoder.append(message);
+
+        if (i < keyframeAt)
+        {
+            QVERIFY(!decoder.decodeNext());
+            QCOMPARE(decoder.skipped(), quint64(i - joins + 1));
+            continue;
+        }
+
+        QVERIFY(decoder.decodeNext());
+
+        QString error;
+        QVERIFY2(matches(decoder, m_frames[i], &error), qPrintable(error));
+    }
+
+    QCOMPARE(decoder.skipped(), quint64(keyframeAt - joins));
+}
+
+void tst_SkeletonStream::truncatedMessage()
+{
+    QNiTESkeletonEncoder encoder;
+    QNiTESkeletonDecoder decoder;
+    QByteArray message;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        encoder.encode(m_frames[i], &message);
+
+        // a message arriving a few bytes at a time, split inside the length prefix too
+        for (int offset = 0; offset < message.size(); offset += 3)
+        {
+            QVERIFY(!decoder.decodeNext());
+            decoder.append(message.mid(offset, 3));
+        }
+
+        QVERIFY(decoder.decodeNext());
+
+        QString error;
+        QVERIFY2(matches(decoder, m_frames[i], &error), qPrintable(error));
+    }
+
+    QCOMPARE(decoder.skipped(), quint64(0));
+}
+
+void tst_SkeletonStream::malformedMessage()
+{
+    static const int broken = 4;
+    static const int keyframeAt = 8;
+
+    QNiTESkeletonEncoder encoder;
+    encoder.setKeyframeInterval(keyframeAt);
+    QNiTESkeletonDecoder decoder;
+    QByteArray message;
+
+    for (int i = 0; i < 2 * keyframeAt; ++i)
+    {
+        encoder.encode(m_frames[i], &message);
+
+        // a delta cut short, its length prefix claiming only what is left
+        if (i == broken)
+        {
+            message.chop(5);
+            message.replace(0, 4, withLength(message.size() - 4));
+        }
+
+        decoder.append(message);
+
+        // skipped, and so is every delta after it until the next keyframe
+        if (i >= broken && i < keyframeAt)
+        {
+            QVERIFY(!decoder.decodeNext());
+            QCOMPARE(decoder.skipped(), quint64(i - broken + 1));
+            continue;
+        }
+
+        QVERIFY(decoder.decodeNext());
+
+        QString error;
+        QVERIFY2(matches(decoder, m_frames[i], &error), qPrintable(error));
+    }
+
+    QVERIFY(!decoder.isBroken());
+    QCOMPARE(decoder.skipped(), quint64(keyframeAt - broken));
+
+    // a keyframe with a stray byte after it is no keyframe either
+    encoder.encodeKeyframe(&message);
+    const QByteArray keyframe = message;
+    message.append(char(0));
+    message.replace(0, 4, withLength(message.size() - 4));
+
+    decoder.append(message);
+    QVERIFY(!decoder.decodeNext());
+    QCOMPARE(decoder.skipped(), quint64(keyframeAt - broken + 1));
+
+    decoder.append(keyframe);
+    QVERIFY(decoder.decodeNext());
+
+    QString error;
+    QVERIFY2(matches(decoder, m_frames[2 * keyframeAt - 1], &error), qPrintable(error));
+}
+
+void tst_SkeletonStream::oversizedLength()
+{
+    QNiTESkeletonEncoder encoder;
+    QNiTESkeletonDecoder decoder;
+    QByteArray message;
+
+    encoder.encode(m_frames[0], &message);
+
+    // the longest message accepted is waited for
+    decoder.append(withLength(QNITE_STREAM_MAX_MESSAGE_SIZE));
+    QVERIFY(!decoder.decodeNext());
+    QVERIFY(!decoder.isBroken());
+    decoder.reset();
+
+    // one byte more, and the stream cannot be trusted
+    decoder.append(withLength(QNITE_STREAM_MAX_MESSAGE_SIZE + 1));
+    decoder.append(message);
+    QVERIFY(!decoder.decodeNext());
+    QVERIFY(decoder.isBroken());
+    QCOMPARE(decoder.skipped(), quint64(1));
+
+    // until reset, even a keyframe is dropped
+    encoder.encodeKeyframe(&message);
+    decoder.append(message);
+    QVERIFY(!decoder.decodeNext());
+    QVERIFY(decoder.isBroken());
+
+    decoder.reset();
+    QVERIFY(!decoder.isBroken());
+
+    decoder.append(message);
+    QVERIFY(decoder.decodeNext());
+
+    QString error;
+    QVERIFY2(matches(decoder, m_frames[0], &error), qPrintable(error));
+}
+
+QTEST_APPLESS_MAIN(tst_SkeletonStream)
+
+#include "tst_skeletonstream.moc"
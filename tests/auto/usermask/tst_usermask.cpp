@@ -0,0 +1,210 @@
+#include <QtTest>
+
+#include <random>
+
+#include "qniteusermask.h"
+
+class tst_UserMask : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesBruteForce_data();
+    void matchesBruteForce();
+    void maskImage();
+    void noLabels();
+};
+
+// rows of runs of random length, so the background skip sees both whole and partial words
+static QNiTETrackerFrame randomFrame(std::mt19937 & random, int width, int height, QVector<qint16> & labels)
+{
+    std::uniform_int_distribution<int> lengths(1, 9), users(0, 4), background(0, 1);
+
+    labels.resize(width * height);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; )
+        {
+            const qint16 label = background(random) ? 0 : qint16(users(random));
+            for (int n = lengths(random); n > 0 && x < width; --n, ++x)
+                labels[y * width + x] = label;
+        }
+    }
+
+    QNiTETrackerFrame frame;
+    frame.valid = true;
+    frame.resolutionX = frame.width = width;
+    frame.resolutionY = frame.height = height;
+    frame.labels = labels.constData();
+    return frame;
+}
+
+void tst_UserMask::matchesBruteForce_data()
+{
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("height");
+    QTest::addColumn<int>("cropX");
+    QTest::addColumn<int>("cropY");
+
+    QTest::newRow("640x480") << 640 << 480 << 0 << 0;
+    QTest::newRow("odd") << 37 << 11 << 0 << 0;
+    QTest::newRow("cropped") << 203 << 97 << 40 << 25;
+}
+
+void tst_UserMask::matchesBruteForce()
+{
+    QFETCH(int, width);
+    QFETCH(int, height);
+    QFETCH(int, cropX);
+    QFETCH(int, cropY);
+
+    std::mt19937 random(19);
+    QVector<qint16> labels;
+
+    QNiTETrackerFrame frame = randomFrame(random, width, height, labels);
+    frame.cropOriginX = cropX;
+    frame.cropOriginY = cropY;
+    frame.resolutionX = cropX + width + 5;
+    frame.resolutionY = cropY + height + 5;
+
+    QNiTEUserMaskExtractor extractor;
+    QVector<QNiTEUserMask> masks;
+    QVector<QNiTEMaskRun> runs;
+
+    // twice, so the second pass runs on the scratch buffers the first one left
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        extractor.extract(frame, &masks, &runs);
+
+        int totalRuns = 0;
+        QSet<int> seen;
+
+        for (int m = 0; m < masks.size(); ++m)
+        {
+            const QNiTEUserMask & mask = masks[m];
+            QVERIFY(mask.userId > 0);
+            QVERIFY(!seen.contains(mask.userId));
+            seen.insert(mask.userId);
+
+            // the same user, scanned pixel by pixel in frame coordinates
+            QVector<QNiTEMaskRun> expected;
+            int pixels = 0;
+            int left = INT_MAX, top = INT_MAX, right = -1, bottom = -1;
+
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    if (labels[y * width + x] != mask.userId)
+                        continue;
+
+                    ++pixels;
+                    left = qMin(left, x);
+                    right = qMax(right, x);
+                    top = qMin(top, y);
+                    bottom = qMax(bottom, y);
+
+                    if (x > 0 && labels[y * width + x - 1] == mask.userId)
+                    {
+                        expected.last().length++;
+                    }
+                    else
+                    {
+                        QNiTEMaskRun run;
+                        run.y = quint16(cropY + y);
+                        run.x = quint16(cropX + x);
+                        run.length = 1;
+                        expected.append(run);
+                    }
+                }
+            }
+
+            QCOMPARE(mask.pixelCount, pixels);
+            QCOMPARE(mask.bounds, QRect(QPoint(cropX + left, cropY + top), QPoint(cropX + right, cropY + bottom)));
+            QCOMPARE(mask.runCount, expected.size());
+            QVERIFY(mask.firstRun >= 0 && mask.firstRun + mask.runCount <= runs.size());
+
+            // grouped per user, in row then column order
+            const QNiTEMaskRun * actual = runs.constData() + mask.firstRun;
+            for (int r = 0; r < expected.size(); ++r)
+            {
+                QCOMPARE(actual[r].y, expected[r].y);
+                QCOMPARE(actual[r].x, expected[r].x);
+                QCOMPARE(actual[r].length, expected[r].length);
+            }
+
+            totalRuns += mask.runCount;
+        }
+
+        QCOMPARE(totalRuns, runs.size());
+
+        // every labelled user has a mask
+        for (int i = 0; i < labels.size(); ++i)
+            QVERIFY(labels[i] == 0 || seen.contains(labels[i]));
+    }
+}
+
+void tst_UserMask::maskImage()
+{
+    std::mt19937 random(20);
+    QVector<qint16> labels;
+
+    const int width = 61, height = 23, cropX = 8, cropY = 3;
+
+    QNiTETrackerSnapshot snapshot;
+    snapshot.frame = randomFrame(random, width, height, labels);
+    snapshot.frame.cropOriginX = cropX;
+    snapshot.frame.cropOriginY = cropY;
+
+    QNiTEUserMaskExtractor extractor;
+    extractor.extract(snapshot.frame, &snapshot.userMasks, &snapshot.maskRuns);
+    QVERIFY(!snapshot.userMasks.isEmpty());
+
+    for (int m = 0; m < snapshot.userMasks.size(); ++m)
+    {
+        const QNiTEUserMask & mask = snapshot.userMasks[m];
+        const QImage image = qniteUserMaskImage(snapshot, mask.userId);
+
+        QCOMPARE(image.format(), QImage::Format_Alpha8);
+        QCOMPARE(image.size(), mask.bounds.size());
+
+        for (int y = 0; y < image.height(); ++y)
+        {
+            const uchar * line = image.constScanLine(y);
+            const int frameY = mask.bounds.top() - cropY + y;
+
+            for (int x = 0; x < image.width(); ++x)
+            {
+                const int frameX = mask.bounds.left() - cropX + x;
+                QCOMPARE(int(line[x]), labels[frameY * width + frameX] == mask.userId ? 255 : 0);
+            }
+        }
+    }
+
+    QVERIFY(qniteUserMaskImage(snapshot, 99).isNull());
+}
+
+void tst_UserMask::noLabels()
+{
+    std::mt19937 random(21);
+    QVector<qint16> labels;
+    QNiTETrackerFrame frame = randomFrame(random, 16, 4, labels);
+
+    QNiTEUserMaskExtractor extractor;
+    QVector<QNiTEUserMask> masks;
+    QVector<QNiTEMaskRun> runs;
+
+    extractor.extract(frame, &masks, &runs);
+    QVERIFY(!masks.isEmpty());
+
+    // a frame without labels leaves nothing of the one before
+    frame.labels = 0;
+    extractor.extract(frame, &masks, &runs);
+    QVERIFY(masks.isEmpty());
+    QVERIFY(runs.isEmpty());
+}
+
+QTEST_APPLESS_MAIN(tst_UserMask)
+
+#include "tst_usermask.moc"
@@ -0,0 +1,7 @@
+include(../../tests.pri)
+
+TARGET = tst_usermask
+
+SOURCES += \
+    tst_usermask.cpp \
+    $$QNITE_SRC/qniteusermask.cpp
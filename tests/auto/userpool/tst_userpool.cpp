@@ -0,0 +1,170 @@
+#include <QtTest>
+
+#include <new>
+#include <stdlib.h>
+
+#include "qniteuser.h"
+#include "qniteuserpool.h"
+
+// every operator new, counted while s_countAllocations is set
+static bool s_countAllocations = false;
+static int s_allocations = 0;
+
+void * operator new(std::size_t size)
+{
+    if (s_countAllocations)
+        ++s_allocations;
+
+    if (void * memory = malloc(size ? size : 1))
+        return memory;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void * memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void * memory, std::size_t) noexcept
+{
+    free(memory);
+}
+
+class tst_UserPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void releasedUsersWait();
+    void growsUpToMaxSize();
+    void reusesEarlyAtMaxSize();
+    void steadyChurnDoesNotAllocate();
+};
+
+void tst_UserPool::releasedUsersWait()
+{
+    QObject owner;
+    QNiTEUserPool pool(&owner, 2, 3);
+
+    QNiTEUser * first = pool.acquire(1);
+    pool.release(first);
+    QVERIFY(!first->tracked());
+    QCOMPARE(first->userId(), 1);
+
+    // the other free one first, then growth, while the released one waits
+    QNiTEUser * second = pool.acquire(2);
+    QVERIFY(second != first);
+    QNiTEUser * third = pool.acquire(3);
+    QVERIFY(third != first);
+    QCOMPARE(pool.allocated(), 3);
+
+    pool.tick();
+    pool.tick();
+    QCOMPARE(pool.available(), 0);
+
+    pool.tick();
+    QCOMPARE(pool.available(), 1);
+
+    QNiTEUser * fourth = pool.acquire(4);
+    QCOMPARE(fourth, first);
+    QVERIFY(fourth->tracked());
+    QCOMPARE(fourth->userId(), 4);
+}
+
+void tst_UserPool::growsUpToMaxSize()
+{
+    QObject owner;
+    QNiTEUserPool pool(&owner, 2);
+    pool.setMaxSize(4);
+
+    for (int id = 1; id <= 4; ++id)
+        QVERIFY(pool.acquire(id));
+
+    QCOMPARE(pool.allocated(), 4);
+    QVERIFY(!pool.acquire(5));
+    QCOMPARE(pool.allocated(), 4);
+
+    // never below what is already there
+    pool.setMaxSize(2);
+    QCOMPARE(pool.maxSize(), 4);
+}
+
+void tst_UserPool::reusesEarlyAtMaxSize()
+{
+    QObject owner;
+    QNiTEUserPool pool(&owner, 3, 30);
+    pool.setMaxSize(3);
+
+    QNiTEUser * users[3];
+    for (int i = 0; i < 3; ++i)
+        users[i] = pool.acquire(i + 1);
+
+    pool.release(users[1]);
+    pool.tick();
+    pool.release(users[0]);
+
+    // long before the delay is up, and the one lost longest ago
+    QNiTEUser * user = pool.acquire(4);
+    QCOMPARE(user, users[1]);
+    QCOMPARE(user->userId(), 4);
+
+    QCOMPARE(pool.acquire(5), users[0]);
+    QVERIFY(!pool.acquire(6));
+    QCOMPARE(pool.allocated(), 3);
+}
+
+void tst_UserPool::steadyChurnDoesNotAllocate()
+{
+    // four users on stage; every few frames the oldest leaves and a new one
+    // arrives, the way QNiTE::processNewFrame() drives the pool
+    const int present = 4;
+    const int interval = 8;
+
+    QObject owner;
+    QNiTEUserPool pool(&owner);
+    QVector<QNiTEUser *> users;
+    users.reserve(present + 1);
+
+    QNiTEUserData data;
+    data.isVisible = true;
+
+    int nextId = 1;
+    for (int i = 0; i < present; ++i)
+        users.append(pool.acquire(nextId++));
+
+    // long enough for released users to start coming back
+    for (int frame = 0; frame < 1000; ++frame)
+    {
+        if (frame == 200)
+        {
+            s_allocations = 0;
+            s_countAllocations = true;
+        }
+
+        pool.tick();
+
+        if (frame % interval == 0)
+        {
+            pool.release(users.first());
+            users.remove(0);
+            users.append(pool.acquire(nextId++));
+        }
+
+        for (int i = 0; i < users.size(); ++i)
+        {
+            data.id = users[i]->userId();
+            data.centerOfMass = QVector3D(frame, i, 2000);
+            users[i]->update(data);
+        }
+    }
+
+    s_countAllocations = false;
+
+    QCOMPARE(s_allocations, 0);
+    QVERIFY(pool.allocated() <= QNITE_MAX_USERS);
+}
+
+QTEST_APPLESS_MAIN(tst_UserPool)
+
+#include "tst_userpool.moc"
@@ -0,0 +1,15 @@
+include(../../tests.pri)
+
+QT += qml
+
+TARGET = tst_userpool
+
+# QNiTEUser's joint enum comes from NiTE's headers
+INCLUDEPATH += $$(NITE2_INCLUDE)
+
+HEADERS += $$QNITE_SRC/qniteuser.h
+
+SOURCES += \
+    tst_userpool.cpp \
+    $$QNITE_SRC/qniteuser.cpp \
+    $$QNITE_SRC/qniteuserpool.cpp
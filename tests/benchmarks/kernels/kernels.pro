@@ -0,0 +1,20 @@
+include(../../tests.pri)
+
+TARGET = tst_bench_kernels
+
+SOURCES += \
+    tst_bench_kernels.cpp \
+    $$QNITE_SRC/qnitecolorconvert.cpp \
+    $$QNITE_SRC/qnitecolorimagecache.cpp \
+    $$QNITE_SRC/qnitecolorize.cpp \
+    $$QNITE_SRC/qnitecpu.cpp \
+    $$QNITE_SRC/qnitedepthhistogram.cpp \
+    $$QNITE_SRC/qniteimagescaler.cpp \
+    $$QNITE_SRC/qnitejointfilter.cpp \
+    $$QNITE_SRC/qnitepointcloud.cpp \
+    $$QNITE_SRC/qniteprojection.cpp \
+    $$QNITE_SRC/qniteregistration.cpp \
+    $$QNITE_SRC/qniteskeletoncapture.cpp \
+    $$QNITE_SRC/qniteskeletonstream.cpp \
+    $$QNITE_SRC/qnitesyntheticsource.cpp \
+    $$QNITE_SRC/qniteusermask.cpp
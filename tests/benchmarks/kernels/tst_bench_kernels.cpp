@@ -0,0 +1,353 @@
+#include <QtTest>
+
+#include "qnitecolorconvert.h"
+#include "qnitecolorimagecache.h"
+#include "qnitecolorize.h"
+#include "qnitedepthhistogram.h"
+#include "qniteimagescaler.h"
+#include "qnitejointfilter.h"
+#include "qnitepointcloud.h"
+#include "qniteprojection.h"
+#include "qniteregistration.h"
+#include "qniteskeletonstream.h"
+#include "qnitesyntheticsource.h"
+#include "qniteusermask.h"
+
+/*
+ * The per-frame work QNiTE's worker thread and renderers do, on synthetic frames,
+ * one call per QBENCHMARK iteration. Run with -median N for stable figures; the
+ * SIMD variants in use are printed first.
+ */
+class tst_BenchKernels : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void depthHistogram_data();
+    void depthHistogram();
+    void colorize();
+    void pointCloud_data();
+    void pointCloud();
+    void registrationTable();
+    void registration();
+    void userMasks();
+    void jointFilter_data();
+    void jointFilter();
+    void skeletonStreamEncode();
+    void skeletonStreamDecode();
+    void colorConvert_data();
+    void colorConvert();
+    void colorScale_data();
+    void colorScale();
+    void colorImageCache();
+};
+
+// a frame well into the synthetic cycle, where the first users have tracked skeletons
+static const int s_sampleFrame = 200;
+
+void tst_BenchKernels::initTestCase()
+{
+    qDebug("colorize %s, projection %s, point cloud %s, registration %s, color conversion %s, scaling %s",
+           qniteColorizeImplementation(), qniteProjectionImplementation(), qnitePointCloudImplementation(),
+           qniteRegistrationImplementation(), qniteColorConvertImplementation(), qniteImageScaleImplementation());
+}
+
+void tst_BenchKernels::depthHistogram_data()
+{
+    QTest::addColumn<int>("subsample");
+
+    QTest::newRow("subsample=1") << 1;
+    QTest::newRow("subsample=2") << 2;
+}
+
+void tst_BenchKernels::depthHistogram()
+{
+    QFETCH(int, subsample);
+
+    QNiTESyntheticSource source(2, 0);
+    QNiTETrackerFrame frame;
+    source.generateTrackerFrame(s_sampleFrame, &frame);
+
+    QNiTEDepthHistogram histogram;
+    histogram.setSubsample(subsample);
+    histogram.setRefreshInterval(1);
+
+    QBENCHMARK {
+        histogram.update(frame.depth, frame.width, frame.height, frame.depthStride);
+    }
+}
+
+void tst_BenchKernels::colorize()
+{
+    QNiTESyntheticSource source(2, 0);
+    QNiTETrackerFrame frame;
+    source.generateTrackerFrame(s_sampleFrame, &frame);
+
+    QNiTEDepthHistogram histogram;
+    histogram.update(frame.depth, frame.width, frame.height, frame.depthStride);
+
+    QVector<quint32> texture(frame.width * frame.height);
+
+    QBENCHMARK {
+        for (int y = 0; y < frame.height; ++y)
+        {
+            const int row = y * frame.width;
+            qniteColorizeDepth(frame.depth + row, frame.labels + row, histogram.lut(), texture.data() + row, frame.width);
+        }
+    }
+}
+
+void tst_BenchKernels::pointCloud_data()
+{
+    QTest::addColumn<int>("stride");
+    QTest::addColumn<int>("voxelSize");
+    QTest::addColumn<int>("userId");
+
+    QTest::newRow("stride=1") << 1 << 0 << int(QNiTEPointCloud::AllPixels);
+    QTest::newRow("stride=2,voxel=50") << 2 << 50 << int(QNiTEPointCloud::AllPixels);
+    QTest::newRow("usersOnly") << 1 << 0 << int(QNiTEPointCloud::AnyUser);
+}
+
+void tst_BenchKernels::pointCloud()
+{
+    QFETCH(int, stride);
+    QFETCH(int, voxelSize);
+    QFETCH(int, userId);
+
+    QNiTESyntheticSource source(3, 0);
+    QNiTETrackerFrame frame;
+    source.generateTrackerFrame(s_sampleFrame, &frame);
+
+    QNiTEPointCloud cloud;
+    cloud.setStride(stride);
+    cloud.setVoxelSize(voxelSize);
+    cloud.setUserId(userId);
+
+    QBENCHMARK {
+        cloud.generate(frame, source.depthIntrinsics());
+    }
+}
+
+// once per video mode, so this is what switching modes costs
+void tst_BenchKernels::registrationTable()
+{
+    QNiTESyntheticSource source(0, 0);
+
+    QBENCHMARK {
+        QNiTERegistrationTable::build(source, QNiTESyntheticSource::Width, QNiTESyntheticSource::Height,
+                                      QNiTESyntheticSource::Width, QNiTESyntheticSource::Height);
+    }
+}
+
+void tst_BenchKernels::registration()
+{
+    QNiTESyntheticSource source(3, 0);
+    QNiTETrackerFrame frame;
+    source.generateTrackerFrame(s_sampleFrame, &frame);
+
+    const QSharedPointer<const QNiTERegistrationTable> table =
+        QNiTERegistrationTable::build(source, frame.resolutionX, frame.resolutionY,
+                                      QNiTESyntheticSource::Width, QNiTESyntheticSource::Height);
+
+    QNiTEDepthRegistration registration;
+
+    QBENCHMARK {
+        registration.apply(*table, frame);
+    }
+}
+
+void tst_BenchKernels::userMasks()
+{
+    QNiTESyntheticSource source(3, 0);
+    QNiTETrackerFrame frame;
+    source.generateTrackerFrame(s_sampleFrame, &frame);
+
+    QNiTEUserMaskExtractor extractor;
+    QVector<QNiTEUserMask> masks;
+    QVector<QNiTEMaskRun> runs;
+
+    QBENCHMARK {
+        extractor.extract(frame, &masks, &runs);
+    }
+}
+
+void tst_BenchKernels::jointFilter_data()
+{
+    QTest::addColumn<int>("type");
+
+    QTest::newRow("oneEuro") << int(QNiTEJointFilterSettings::OneEuro);
+    QTest::newRow("kalman") << int(QNiTEJointFilterSettings::Kalman);
+}
+
+void tst_BenchKernels::jointFilter()
+{
+    QFETCH(int, type);
+
+    QNiTESyntheticSource source(1, 0);
+    QVector<QNiTETrackerFrame> frames(8);
+    for (int i = 0; i < frames.size(); ++i)
+        source.generateTrackerFrame(s_sampleFrame + i, &frames[i]);
+
+    QNiTEJointFilterSettings settings;
+    settings.type = QNiTEJointFilterSettings::Type(type);
+    settings.predictionMs = 50;
+
+    QNiTEJointFilter filter;
+    QNiTEUserData user;
+    quint64 timestamp = 0;
+    int i = 0;
+
+    // one user's skeleton per iteration, with timestamps moving forward; the copy
+    // stands in for the worker's own
+    QBENCHMARK {
+        user = frames[i++ % frames.size()].users[0];
+        timestamp += 33333;
+        filter.apply(settings, timestamp, user.joints);
+    }
+}
+
+// keyframes included, at their default interval
+void tst_BenchKernels::skeletonStreamEncode()
+{
+    QNiTESyntheticSource source(3, 0);
+    QVector<QNiTETrackerFrame> frames(8);
+    for (int i = 0; i < frames.size(); ++i)
+        source.generateTrackerFrame(s_sampleFrame + i, &frames[i]);
+
+    QNiTESkeletonEncoder encoder;
+    QByteArray message;
+    int i = 0;
+
+    QBENCHMARK {
+        encoder.encode(frames[i++ % frames.size()], &message);
+    }
+}
+
+void tst_BenchKernels::skeletonStreamDecode()
+{
+    QNiTESyntheticSource source(3, 0);
+    QVector<QNiTETrackerFrame> frames(8);
+    for (int i = 0; i < frames.size(); ++i)
+        source.generateTrackerFrame(s_sampleFrame + i, &frames[i]);
+
+    // a whole number of keyframe intervals, so the stream starts over cleanly
+    QNiTESkeletonEncoder encoder;
+    QVector<QByteArray> messages(8 * QNITE_STREAM_DEFAULT_KEYFRAME_INTERVAL);
+    for (int i = 0; i < messages.size(); ++i)
+        encoder.encode(frames[i % frames.size()], &messages[i]);
+
+    QNiTESkeletonDecoder decoder;
+    int i = 0;
+
+    QBENCHMARK {
+        decoder.append(messages[i++ % messages.size()]);
+        decoder.decodeNext();
+    }
+
+    QCOMPARE(decoder.skipped(), quint64(0));
+}
+
+void tst_BenchKernels::colorConvert_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<bool>("qt");
+
+    // Qt's own conversion, for comparison
+    QTest::newRow("qt,rgb888") << int(QNiTEColorFrame::RGB888) << true;
+    QTest::newRow("rgb888") << int(QNiTEColorFrame::RGB888) << false;
+    QTest::newRow("yuv422") << int(QNiTEColorFrame::YUV422) << false;
+    QTest::newRow("yuyv") << int(QNiTEColorFrame::YUYV) << false;
+    QTest::newRow("gray8") << int(QNiTEColorFrame::Gray8) << false;
+}
+
+void tst_BenchKernels::colorConvert()
+{
+    QFETCH(int, format);
+    QFETCH(bool, qt);
+
+    QNiTESyntheticSource source(0, 0);
+    QNiTEVideoMode mode;
+    mode.pixelFormat = QNiTEColorFrame::PixelFormat(format);
+    source.setColorVideoMode(mode);
+
+    QNiTEColorFrame frame;
+    source.generateColorFrame(s_sampleFrame, &frame);
+
+    if (qt)
+    {
+        QBENCHMARK {
+            QImage image(frame.data, frame.width, frame.height, frame.stride, QImage::Format_RGB888);
+            image.convertToFormat(QImage::Format_RGB32);
+        }
+        return;
+    }
+
+    QVector<quint32> pixels(frame.width * frame.height);
+
+    QBENCHMARK {
+        qniteConvertColorFrame(frame, pixels.data(), frame.width * sizeof(quint32));
+    }
+}
+
+void tst_BenchKernels::colorScale_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<bool>("qt");
+
+    // Qt's smooth scaling, for comparison; an integer fraction is a box filter
+    // alone, anything else adds a bilinear pass
+    QTest::newRow("qt,160x120") << QSize(160, 120) << true;
+    QTest::newRow("160x120") << QSize(160, 120) << false;
+    QTest::newRow("200x150") << QSize(200, 150) << false;
+}
+
+void tst_BenchKernels::colorScale()
+{
+    QFETCH(QSize, size);
+    QFETCH(bool, qt);
+
+    QNiTESyntheticSource source(0, 0);
+    QNiTEColorFrame frame;
+    source.generateColorFrame(s_sampleFrame, &frame);
+
+    QImage image(frame.width, frame.height, QImage::Format_RGB32);
+    qniteConvertColorFrame(frame, reinterpret_cast<quint32 *>(image.bits()), image.bytesPerLine());
+
+    if (qt)
+    {
+        QBENCHMARK {
+            image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+        return;
+    }
+
+    QNiTEImageScaler scaler;
+    QVector<quint32> pixels(size.width() * size.height());
+
+    QBENCHMARK {
+        scaler.scale(reinterpret_cast<const quint32 *>(image.constBits()), image.width(), image.height(), image.bytesPerLine(),
+                     pixels.data(), size.width(), size.height(), size.width() * sizeof(quint32));
+    }
+}
+
+// six thumbnails of one QNiTE, converted and scaled once per frame between them
+void tst_BenchKernels::colorImageCache()
+{
+    QNiTESyntheticSource source(0, 0);
+    QNiTEColorFrame frame;
+    source.generateColorFrame(s_sampleFrame, &frame);
+
+    QNiTEColorImageCache cache;
+
+    QBENCHMARK {
+        cache.setFrame(frame);
+        for (int thumbnail = 0; thumbnail < 6; ++thumbnail)
+            cache.image(QSize(160, 120));
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_BenchKernels)
+
+#include "tst_bench_kernels.moc"
@@ -0,0 +1,6 @@
+include(../../tests.pri)
+include(../../qnite.pri)
+
+TARGET = tst_bench_pipeline
+
+SOURCES += tst_bench_pipeline.cpp
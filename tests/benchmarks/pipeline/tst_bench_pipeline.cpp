@@ -0,0 +1,305 @@
+#include <QtTest>
+#include <QQuickWindow>
+
+#include <algorithm>
+
+#include "qnite.h"
+#include "qnitecolorrenderer.h"
+#include "qnitemultisource.h"
+#include "qnitescriptedsource.h"
+#include "qnitesyntheticsource.h"
+#include "qnitetrackerworker.h"
+#include "qniteuser.h"
+
+/*
+ * QNiTE itself, driven through its public API the way an application drives it:
+ * frames go in through a frame source and come out as signals, across the worker
+ * thread. Where the figure of interest is a single pipeline stage rather than the
+ * whole round trip, it is read from trackerTiming() and reported as the median of
+ * s_samples frames.
+ */
+class tst_BenchPipeline : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void userUpdate();
+    void trackerSnapshot_data();
+    void trackerSnapshot();
+    void processNewFrame_data();
+    void processNewFrame();
+    void userChurn();
+    void multiSourceMerge();
+    void frameToSignal();
+    void colorRenderer();
+};
+
+static const int s_sampleFrame = 200;
+
+static const int s_warmupFrames = 10;
+static const int s_samples = 200;
+
+static void reportMedian(QVector<qint64> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    QTest::setBenchmarkResult(samples[samples.size() / 2], QTest::WalltimeNanoseconds);
+}
+
+// a QNiTE fed by a scripted source, without color
+class ScriptedQNiTE
+{
+public:
+    ScriptedQNiTE() : source(new QNiTEScriptedSource()), spy(&qnite, &QNiTE::newTrackerFrame)
+    {
+        qnite.setRgbStreamEnabled(false);
+        qnite.setFrameSource(source);
+        qnite.initialize();
+    }
+
+    // pushes frame and waits for QNiTE to apply it; false on a timeout
+    bool apply(const QNiTETrackerFrame & frame)
+    {
+        spy.clear();
+        source->pushTrackerFrame(frame);
+        return spy.wait(1000);
+    }
+
+    qint64 processTime() const
+    {
+        return qnite.trackerTiming().processEnd - qnite.trackerTiming().processStart;
+    }
+
+    QNiTE qnite;
+    QNiTEScriptedSource * source; // owned by qnite
+    QSignalSpy spy;
+};
+
+void tst_BenchPipeline::initTestCase()
+{
+    // renderers run without a GPU; must be set before the first window exists
+    QQuickWindow::setSceneGraphBackend(QSGRendererInterface::Software);
+}
+
+void tst_BenchPipeline::userUpdate()
+{
+    QNiTESyntheticSource source(1, 0);
+    QNiTETrackerFrame frames[2];
+    source.generateTrackerFrame(s_sampleFrame, &frames[0]);
+    source.generateTrackerFrame(s_sampleFrame + 1, &frames[1]);
+
+    QNiTEUser user(1);
+    int i = 0;
+
+    // alternate between two frames, so every property actually changes
+    QBENCHMARK {
+        user.update(frames[i++ & 1].users[0]);
+    }
+}
+
+void tst_BenchPipeline::trackerSnapshot_data()
+{
+    QTest::addColumn<int>("users");
+
+    for (int users = 1; users <= 8; ++users)
+        QTest::newRow(qPrintable(QString("users=%1").arg(users))) << users;
+}
+
+// the worker thread's share of a frame, joint projection included
+void tst_BenchPipeline::trackerSnapshot()
+{
+    QFETCH(int, users);
+
+    QNiTESyntheticSource source(users, 0);
+    QVector<QNiTETrackerFrame> frames(8);
+    for (int i = 0; i < frames.size(); ++i)
+        source.generateTrackerFrame(s_sampleFrame + i, &frames[i]);
+
+    QNiTEFrameQueue<QNiTETrackerFrame> trackerFrames;
+    QNiTEFrameQueue<QNiTETrackerSnapshotPointer> snapshots;
+    QNiTETrackerWorker worker(&trackerFrames, &snapshots);
+    worker.setIntrinsics(source.depthIntrinsics());
+    int i = 0;
+
+    QBENCHMARK {
+        worker.buildSnapshot(frames[i++ % frames.size()]);
+    }
+}
+
+void tst_BenchPipeline::processNewFrame_data()
+{
+    trackerSnapshot_data();
+}
+
+// the GUI thread's share, from picking the snapshot up to emitting newTrackerFrame
+void tst_BenchPipeline::processNewFrame()
+{
+    QFETCH(int, users);
+
+    QNiTESyntheticSource synthetic(users, 0);
+    QVector<QNiTETrackerFrame> frames(8);
+    for (int i = 0; i < frames.size(); ++i)
+        synthetic.generateTrackerFrame(s_sampleFrame + i, &frames[i]);
+
+    ScriptedQNiTE scripted;
+    QVERIFY(scripted.qnite.initialized());
+
+    QVector<qint64> samples;
+    for (int i = -s_warmupFrames; i < s_samples; ++i)
+    {
+        QVERIFY(scripted.apply(frames[(i + s_warmupFrames) % frames.size()]));
+
+        if (i >= 0)
+            samples.append(scripted.processTime());
+    }
+
+    reportMedian(samples);
+}
+
+void tst_BenchPipeline::userChurn()
+{
+    // four users on stage; every frame the oldest leaves and a new one arrives
+    const int present = 4;
+
+    QNiTETrackerFrame frame;
+    frame.valid = true;
+    frame.users.resize(present + 1);
+
+    ScriptedQNiTE scripted;
+    QVERIFY(scripted.qnite.initialized());
+
+    QVector<qint64> samples;
+
+    // run long enough for released users to start coming back from the pool
+    for (int i = -100; i < s_samples; ++i)
+    {
+        frame.frameIndex = i + 100;
+
+        for (int u = 0; u <= present; ++u)
+        {
+            QNiTEUserData & user = frame.users[u];
+            user.id = frame.frameIndex + u + 1;
+            user.isLost = u == 0;
+            user.isNew = u == present;
+            user.isVisible = !user.isLost;
+            user.centerOfMass = QVector3D(frame.frameIndex, u, 2000);
+        }
+
+        QVERIFY(scripted.apply(frame));
+
+        if (i >= 0)
+            samples.append(scripted.processTime());
+    }
+
+    reportMedian(samples);
+}
+
+// what the primary's callback does, with the others' users fresh
+void tst_BenchPipeline::multiSourceMerge()
+{
+    // three sensors around the room, three people in front of each
+    QMatrix4x4 extrinsics[3];
+    extrinsics[1].translate(0, 0, 4000);
+    extrinsics[1].rotate(180, 0, 1, 0);
+    extrinsics[2].rotate(90, 0, 1, 0);
+
+    QNiTESyntheticSource synthetic(3, 0);
+    QNiTETrackerFrame frame;
+    synthetic.generateTrackerFrame(s_sampleFrame, &frame);
+
+    QNiTEMultiSource source;
+    QNiTEScriptedSource * sensors[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        sensors[i] = new QNiTEScriptedSource();
+        source.addSensor(sensors[i], extrinsics[i]);
+    }
+
+    QVERIFY(source.open());
+
+    QBENCHMARK {
+        sensors[1]->pushTrackerFrame(frame);
+        sensors[2]->pushTrackerFrame(frame);
+        sensors[0]->pushTrackerFrame(frame);
+    }
+
+    source.close();
+}
+
+// source callback to newTrackerFrame returning, at 60 fps
+void tst_BenchPipeline::frameToSignal()
+{
+    QNiTE qnite;
+    qnite.setRgbStreamEnabled(false);
+    qnite.setFrameSource(new QNiTESyntheticSource(2, 60));
+
+    QSignalSpy spy(&qnite, &QNiTE::newTrackerFrame);
+
+    qnite.initialize();
+    QVERIFY(qnite.initialized());
+
+    QVector<qint64> samples;
+    for (int i = -s_warmupFrames; i < s_samples; ++i)
+    {
+        spy.clear();
+        QVERIFY(spy.wait(1000));
+
+        if (i >= 0)
+            samples.append(qnite.trackerTiming().delivered - qnite.trackerTiming().callbackEntry);
+    }
+
+    reportMedian(samples);
+}
+
+// a new color frame through QNiTEColorRenderer into a window; what reaches the
+// window is the image QNiTE scaled for it
+void tst_BenchPipeline::colorRenderer()
+{
+    QNiTESyntheticSource synthetic(0, 0);
+    QNiTEColorFrame frame;
+    synthetic.generateColorFrame(s_sampleFrame, &frame);
+
+    QNiTEScriptedSource * source = new QNiTEScriptedSource();
+
+    QNiTE qnite;
+    qnite.setFrameSource(source);
+    qnite.initialize();
+    QVERIFY(qnite.initialized());
+
+    QQuickWindow window;
+    window.resize(320, 240);
+
+    QNiTEColorRenderer renderer(window.contentItem());
+    renderer.setSize(QSizeF(320, 240));
+    renderer.setKinect(&qnite);
+    renderer.initialize();
+    QVERIFY(renderer.initialized());
+
+    window.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&window));
+
+    QSignalSpy spy(&qnite, &QNiTE::newRGBFrame);
+    QImage grabbed;
+
+    QBENCHMARK {
+        spy.clear();
+        source->pushColorFrame(frame);
+        QVERIFY(spy.wait(1000));
+
+        grabbed = window.grabWindow();
+    }
+
+    const QImage expected = qnite.colorImage(grabbed.size());
+    QCOMPARE(grabbed.size(), expected.size());
+
+    const QPoint points[] = { QPoint(0, 0), QPoint(expected.width() / 2, expected.height() / 2),
+                              QPoint(expected.width() - 1, expected.height() - 1) };
+
+    for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); ++i)
+        QCOMPARE(grabbed.pixel(points[i]) & 0xffffff, expected.pixel(points[i]) & 0xffffff);
+}
+
+QTEST_MAIN(tst_BenchPipeline)
+
+#include "tst_bench_pipeline.moc"
@@ -0,0 +1,10 @@
+# The whole of QNiTE, for tests that drive QNiTE itself rather than one kernel.
+# OpenNI2 and NiTE2 are found through the variables their installers set.
+
+QT += qml quick network
+
+SOURCES += $$files($$QNITE_SRC/*.cpp)
+HEADERS += $$files($$QNITE_SRC/*.h)
+
+INCLUDEPATH += $$(OPENNI2_INCLUDE) $$(NITE2_INCLUDE)
+LIBS += -L$$(OPENNI2_REDIST) -L$$(NITE2_REDIST64) -lOpenNI2 -lNiTE2
@@ -0,0 +1,35 @@
+#ifndef QNITEKERNELTEST_H
+#define QNITEKERNELTEST_H
+
+#include "qnitecpu.h"
+
+/*
+ * Runs a SIMD kernel once per variant this CPU has, by hiding CPU features from
+ * qniteSelectKernel(). The masks go from everything down to nothing, so the last
+ * pass always runs the scalar variants, which the others are compared with.
+ */
+static const int s_kernelTestMasks[] = {
+    QNiTECpuAllFeatures,
+    QNiTECpuSSE2 | QNiTECpuSSSE3,
+    QNiTECpuSSE2,
+    0
+};
+
+static const int s_kernelTestMaskCount = int(sizeof(s_kernelTestMasks) / sizeof(s_kernelTestMasks[0]));
+
+// puts the mask back when a test function returns, failed or not
+class QNiTEKernelMaskGuard
+{
+public:
+    QNiTEKernelMaskGuard() : m_mask(qniteCpuFeatureMask()) {}
+
+    ~QNiTEKernelMaskGuard()
+    {
+        qniteSetCpuFeatureMask(m_mask);
+    }
+
+private:
+    int m_mask;
+};
+
+#endif // QNITEKERNELTEST_H
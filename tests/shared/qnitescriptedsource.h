@@ -0,0 +1,75 @@
+#ifndef QNITESCRIPTEDSOURCE_H
+#define QNITESCRIPTEDSOURCE_H
+
+#include "qniteframesource.h"
+
+/*
+ * Frame source a test drives by hand. pushTrackerFrame() and pushColorFrame()
+ * hand a frame to the listener on the calling thread, the way a device does from
+ * its own, so QNiTE and QNiTEMultiSource can be fed exactly the frames a test
+ * needs. Frames are copied; their depth and labels must outlive the push.
+ */
+class QNiTEScriptedSource : public QNiTEFrameSource
+{
+public:
+    QNiTEScriptedSource()
+    {
+        // a Kinect's depth camera
+        m_intrinsics.horizontalFov = 1.0144f;
+        m_intrinsics.verticalFov = 0.7898f;
+        m_intrinsics.resolutionX = 640;
+        m_intrinsics.resolutionY = 480;
+    }
+
+    virtual bool open()
+    {
+        m_depthIntrinsics = m_intrinsics;
+        return true;
+    }
+
+    virtual void close()
+    {
+    }
+
+    virtual void setColorEnabled(bool)
+    {
+    }
+
+    virtual bool readTrackerFrame(QNiTETrackerFrame * frame)
+    {
+        *frame = m_trackerFrame;
+        return m_trackerFrame.valid;
+    }
+
+    virtual bool readColorFrame(QNiTEColorFrame * frame)
+    {
+        *frame = m_colorFrame;
+        return m_colorFrame.valid;
+    }
+
+    virtual QPointF toDepthSpace(const QVector3D &) const
+    {
+        return QPointF();
+    }
+
+    void pushTrackerFrame(const QNiTETrackerFrame & frame)
+    {
+        m_trackerFrame = frame;
+        if (m_listener)
+            m_listener->onNewTrackerFrame(*this);
+    }
+
+    void pushColorFrame(const QNiTEColorFrame & frame)
+    {
+        m_colorFrame = frame;
+        if (m_listener)
+            m_listener->onNewColorFrame(*this);
+    }
+
+private:
+    QNiTEDepthIntrinsics m_intrinsics;
+    QNiTETrackerFrame m_trackerFrame;
+    QNiTEColorFrame m_colorFrame;
+};
+
+#endif // QNITESCRIPTEDSOURCE_H
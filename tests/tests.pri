@@ -0,0 +1,16 @@
+# Shared by every test: the QNiTE sources a test needs are compiled into it
+# directly, listed in its own .pro under $$QNITE_SRC. `make check` runs them.
+
+QT += testlib gui
+QT -= widgets
+CONFIG += testcase c++11 console
+CONFIG -= app_bundle
+
+QNITE_SRC = $$PWD/../src
+
+INCLUDEPATH += $$QNITE_SRC $$PWD/shared
+DEPENDPATH += $$QNITE_SRC
+
+HEADERS += \
+    $$PWD/shared/qnitekerneltest.h \
+    $$PWD/shared/qnitescriptedsource.h